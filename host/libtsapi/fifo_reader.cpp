@@ -0,0 +1,178 @@
+#include "fifo_reader.h"
+#include <chrono>
+
+namespace tsapi {
+
+using std::chrono::steady_clock;
+
+// The buffers are aligned for the vector decoders
+static constexpr size_t buff_align = 64;
+
+static uint64_t now_us()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+fifo_reader::fifo_reader(std::unique_ptr<transport> t, reader_config const& cfg)
+	: m_cfg(cfg)
+	, m_free(cfg.buffers)
+	, m_full(cfg.buffers)
+	, m_transport(std::move(t))
+{
+	if (!m_cfg.transfers || m_cfg.buffers < m_cfg.transfers || !m_cfg.transfer_size)
+		throw error("invalid reader configuration");
+	size_t const stride = (m_cfg.transfer_size + buff_align - 1) & ~(buff_align - 1);
+	m_mem.resize(stride * m_cfg.buffers + buff_align);
+	uint8_t* const base = m_mem.data() + (-reinterpret_cast<uintptr_t>(m_mem.data()) & (buff_align - 1));
+	m_xfers.resize(m_cfg.buffers);
+	m_seq.resize(m_cfg.buffers);
+	m_rx_us.resize(m_cfg.buffers);
+	for (unsigned i = 0; i < m_cfg.buffers; ++i)
+		m_xfers[i] = transfer{base + i * stride, m_cfg.transfer_size, 0, xfer_ok, i, nullptr};
+}
+
+fifo_reader::~fifo_reader()
+{
+	stop();
+}
+
+void fifo_reader::start()
+{
+	if (m_thread.joinable())
+		throw error("reader is already started");
+	unsigned idx;
+	// Take back the buffers not yet released, the consumer must not hold any at this point
+	while (m_full.pop(idx))
+		;
+	while (m_free.pop(idx))
+		;
+	m_spare.clear();
+	for (unsigned i = 0; i < m_cfg.buffers; ++i)
+		m_spare.push_back(i);
+	m_error.clear();
+	m_stop = false;
+	m_running = true;
+	m_thread = std::thread(&fifo_reader::run, this);
+}
+
+void fifo_reader::stop()
+{
+	if (!m_thread.joinable())
+		return;
+	m_stop = true;
+	m_thread.join();
+}
+
+reader_stat fifo_reader::stat() const
+{
+	return reader_stat{m_buffers, m_bytes, m_timeouts, m_errors, m_starved};
+}
+
+// Pass the completed transfer to the consumer or keep its buffer for reuse
+void fifo_reader::reclaim(transfer* t)
+{
+	switch (t->status) {
+	case xfer_ok:
+		if (t->actual) {
+			m_seq[t->index] = m_buffers;
+			m_rx_us[t->index] = now_us();
+			m_bytes += t->actual;
+			++m_buffers;
+			// There is always room for all buffers
+			m_full.push(t->index);
+			return;
+		}
+		// fall through
+	case xfer_timeout:
+		++m_timeouts;
+		break;
+	case xfer_cancelled:
+		break;
+	case xfer_gone:
+		if (m_error.empty())
+			m_error = "device disconnected";
+		m_stop = true;
+		break;
+	case xfer_error:
+		++m_errors;
+		break;
+	}
+	m_spare.push_back(t->index);
+}
+
+void fifo_reader::run()
+{
+	std::vector<transfer*> done;
+	unsigned in_flight = 0, idx;
+
+	try {
+		while (!m_stop) {
+			while (m_free.pop(idx))
+				m_spare.push_back(idx);
+			for (; in_flight < m_cfg.transfers && !m_spare.empty(); ++in_flight) {
+				m_transport->submit(&m_xfers[m_spare.back()]);
+				m_spare.pop_back();
+			}
+			if (!in_flight) {
+				++m_starved;
+				std::this_thread::sleep_for(std::chrono::microseconds(100));
+				continue;
+			}
+			m_transport->wait(done, 100);
+			in_flight -= done.size();
+			for (transfer* t : done)
+				reclaim(t);
+			done.clear();
+		}
+	} catch (std::exception const& e) {
+		m_error = e.what();
+	}
+
+	// The cancelled transfers are completed anyway, wait for all of them so none writes to
+	// the buffer reused by the next start() or freed
+	m_transport->cancel();
+	while (in_flight) {
+		try {
+			m_transport->wait(done, 100);
+		} catch (std::exception const&) {
+			break;
+		}
+		in_flight -= done.size();
+		for (transfer* t : done)
+			reclaim(t);
+		done.clear();
+	}
+	m_running.store(false, std::memory_order_release);
+}
+
+bool fifo_reader::next(buffer_view& v, int timeout_ms)
+{
+	steady_clock::time_point const deadline = steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+	unsigned idx;
+	for (unsigned spins = 0;; ++spins) {
+		if (m_full.pop(idx))
+			break;
+		if (!running()) {
+			// The last buffers may be queued just before the thread exits
+			if (m_full.pop(idx))
+				break;
+			return false;
+		}
+		if (spins < 64)
+			std::this_thread::yield();
+		else if (steady_clock::now() < deadline)
+			std::this_thread::sleep_for(std::chrono::microseconds(50));
+		else
+			return false;
+	}
+	transfer const& t = m_xfers[idx];
+	v = buffer_view{t.data, t.actual, m_seq[idx], m_rx_us[idx], idx};
+	return true;
+}
+
+void fifo_reader::release(buffer_view const& v)
+{
+	m_free.push(v.index);
+}
+
+}
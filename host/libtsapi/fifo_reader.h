@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2023 TeraSense
+ * You may use, distribute and modify this code under the terms of the MIT license
+ *
+ * FX2 FIFO stream reader
+ *
+ * The reader thread keeps the configured number of transfers in flight on the transport
+ * so the bus is never idle while the host keeps up. The completed buffers are passed to
+ * the consumer through the lock free ring without copying, the consumer returns them by
+ * release() through the other ring. The next() and release() should be called by the
+ * single consumer thread.
+ */
+
+#pragma once
+
+#include "transport.h"
+#include "spsc_ring.h"
+#include <atomic>
+#include <thread>
+
+namespace tsapi {
+
+struct reader_config {
+	unsigned transfers     = 32;        // in flight
+	size_t   transfer_size = 64 * 1024; // multiple of the 512 bytes packet size
+	unsigned buffers       = 128;       // the rest may be held by the consumer
+};
+
+// The buffer filled by the completed transfer
+struct buffer_view {
+	uint8_t const* data;
+	size_t         size;
+	uint64_t       seq;    // the number of buffers received before this one
+	uint64_t       rx_us;  // the completion time by the monotonic clock
+	unsigned       index;
+};
+
+struct reader_stat {
+	uint64_t buffers;
+	uint64_t bytes;
+	uint64_t timeouts; // the transfers completed without data
+	uint64_t errors;
+	uint64_t starved;  // the times no transfers were in flight since the consumer held all buffers
+};
+
+class fifo_reader {
+public:
+	explicit fifo_reader(std::unique_ptr<transport> t, reader_config const& cfg = reader_config());
+	~fifo_reader();
+
+	fifo_reader(fifo_reader const&) = delete;
+	fifo_reader& operator=(fifo_reader const&) = delete;
+
+	void start();
+
+	// Cancel the transfers and wait for the reader thread. The buffers received may still be taken by next().
+	void stop();
+
+	// Get the next buffer received. Returns false on timeout or if the reader is stopped and there are no more.
+	bool next(buffer_view& v, int timeout_ms);
+
+	// Return the buffer taken by next() for reuse
+	void release(buffer_view const& v);
+
+	bool running() const { return m_running.load(std::memory_order_acquire); }
+
+	// The error stopped the reader, empty if none. Valid once it is not running.
+	std::string const& last_error() const { return m_error; }
+
+	reader_stat stat() const;
+
+	transport& get_transport() { return *m_transport; }
+
+private:
+	void run();
+	void reclaim(transfer* t);
+
+	reader_config              m_cfg;
+	std::vector<uint8_t>       m_mem;
+	std::vector<transfer>      m_xfers;
+	std::vector<uint64_t>      m_seq;    // per buffer
+	std::vector<uint64_t>      m_rx_us;
+	spsc_ring<unsigned>        m_free;   // consumer -> reader thread
+	spsc_ring<unsigned>        m_full;   // reader thread -> consumer
+	std::vector<unsigned>      m_spare;  // the free buffers owned by the reader thread
+	// Declared after the buffers so it is destroyed first, the transfers left in flight
+	// complete into them while the transport is closed
+	std::unique_ptr<transport> m_transport;
+	std::thread                m_thread;
+	std::atomic<bool>          m_stop{false};
+	std::atomic<bool>          m_running{false};
+	std::string                m_error;
+
+	std::atomic<uint64_t>      m_buffers{0};
+	std::atomic<uint64_t>      m_bytes{0};
+	std::atomic<uint64_t>      m_timeouts{0};
+	std::atomic<uint64_t>      m_errors{0};
+	std::atomic<uint64_t>      m_starved{0};
+};
+
+}
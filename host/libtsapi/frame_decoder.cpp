@@ -0,0 +1,151 @@
+#include "frame_decoder.h"
+#include <cstring>
+
+namespace tsapi {
+
+static constexpr size_t no_magic = ~(size_t)0;
+// The zero bytes following the data so the words may be read at any position
+static constexpr size_t padding = 4;
+// The parsed bits are dropped from the buffer once exceed this size
+static constexpr size_t compact_bytes = 1 << 16;
+
+frame_decoder::frame_decoder(frame_handler on_frame, resync_handler on_resync, unpack_fn fn)
+	: m_on_frame(std::move(on_frame))
+	, m_on_resync(std::move(on_resync))
+	, m_unpacker(fn)
+	, m_bits(padding)
+	, m_words(ACQ_HDR_LEN + frame_payload_max)
+{
+}
+
+uint16_t frame_decoder::word_at(size_t bit) const
+{
+	uint8_t const* const p = m_bits.data() + bit / 8;
+	uint32_t const w = p[0] << 16 | p[1] << 8 | p[2];
+	return w >> (8 - bit % 8);
+}
+
+// Returns the bit position of the magic or no_magic
+size_t frame_decoder::find_magic() const
+{
+	size_t const end = m_len * 8 - 16;
+	for (size_t byte = m_pos / 8;; ++byte) {
+		uint8_t const* const p = m_bits.data() + byte;
+		uint32_t const w = p[0] << 16 | p[1] << 8 | p[2];
+		for (unsigned s = 0; s < 8; ++s) {
+			size_t const bit = byte * 8 + s;
+			if (bit < m_pos)
+				continue;
+			if (bit > end)
+				return no_magic;
+			if (static_cast<uint16_t>(w >> (8 - s)) == ACQ_MAGIC)
+				return bit;
+		}
+	}
+}
+
+void frame_decoder::skip(size_t bits)
+{
+	if (!bits)
+		return;
+	if (m_synced) {
+		++m_stat.resyncs;
+		m_synced = false;
+	}
+	if (!m_lost_bits)
+		m_lost_pos = m_base + m_pos;
+	m_lost_bits += bits;
+	m_stat.skipped += bits;
+	m_pos += bits;
+}
+
+// Parse the frame at the current position. Returns false if more data is needed.
+bool frame_decoder::parse()
+{
+	if (avail() < 16)
+		return false;
+	if (word_at(m_pos) != ACQ_MAGIC) {
+		size_t const bit = find_magic();
+		if (bit == no_magic) {
+			skip(avail() - 15);
+			return false;
+		}
+		skip(bit - m_pos);
+	}
+	if (avail() < ACQ_HDR_LEN * 16)
+		return false;
+
+	uint16_t* const w = m_words.data();
+	for (unsigned i = 0; i < ACQ_HDR_LEN; ++i)
+		w[i] = word_at(m_pos + i * 16);
+	size_t const len = w[acq_hdr_len];
+	if (w[acq_hdr_ver_flags] >> 8 != ACQ_VERSION || len > frame_payload_max) {
+		skip(1);
+		return true;
+	}
+	if (avail() < (ACQ_HDR_LEN + len) * 16)
+		return false;
+
+	size_t const start = m_pos + ACQ_HDR_LEN * 16;
+	if (start % 8) {
+		for (size_t i = 0; i < len; ++i)
+			w[ACQ_HDR_LEN + i] = word_at(start + i * 16);
+	} else {
+		uint8_t const* p = m_bits.data() + start / 8;
+		for (size_t i = 0; i < len; ++i, p += 2)
+			w[ACQ_HDR_LEN + i] = p[0] << 8 | p[1];
+	}
+	if (acq_crc16(acq_crc16(0xffff, w, acq_hdr_crc), w + ACQ_HDR_LEN, len) != w[acq_hdr_crc]) {
+		++m_stat.crc_err;
+		skip(1);
+		return true;
+	}
+
+	frame const f = {
+		w[acq_hdr_seq_lo] | (uint32_t)w[acq_hdr_seq_hi] << 16,
+		w[acq_hdr_ts_lo] | (uint32_t)w[acq_hdr_ts_hi] << 16,
+		static_cast<uint8_t>(w[acq_hdr_ver_flags]),
+		w[acq_hdr_cfg],
+		w[acq_hdr_roi],
+		w[acq_hdr_avg],
+		w + ACQ_HDR_LEN,
+		len,
+		m_base + m_pos
+	};
+	m_pos += (ACQ_HDR_LEN + len) * 16;
+	if (!m_synced) {
+		m_synced = true;
+		if (m_lost_bits && m_on_resync)
+			m_on_resync(m_lost_pos, m_lost_bits);
+		m_lost_bits = 0;
+	}
+	++m_stat.frames;
+	if (f.flags & ACQ_FL_LOST)
+		++m_stat.overflow;
+	if (m_seq_valid && !(f.flags & ACQ_FL_START))
+		m_stat.dropped += f.seq - m_next_seq;
+	m_next_seq = f.seq + 1;
+	m_seq_valid = true;
+	m_on_frame(f);
+	return true;
+}
+
+void frame_decoder::feed(uint8_t const* data, size_t len)
+{
+	m_bits.resize(m_len + bit_unpacker::out_max(len) + padding);
+	m_len += m_unpacker.feed(data, len, m_bits.data() + m_len);
+	memset(m_bits.data() + m_len, 0, padding);
+
+	while (parse())
+		;
+
+	if (m_pos / 8 >= compact_bytes) {
+		size_t const drop = m_pos / 8;
+		memmove(m_bits.data(), m_bits.data() + drop, m_len - drop + padding);
+		m_len -= drop;
+		m_pos -= drop * 8;
+		m_base += drop * 8;
+	}
+}
+
+}
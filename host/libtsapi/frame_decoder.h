@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2023 TeraSense
+ * You may use, distribute and modify this code under the terms of the MIT license
+ *
+ * FX2 FIFO stream frame decoder
+ *
+ * The native counterpart of ts_stream.stream_decoder. The FIFO bytes are unpacked to
+ * the bit stream, the frame header (see Inc/acq_core.h) is looked for at any bit
+ * position. Once the frame is found valid the next one is expected right after it
+ * so the search is done only after losing the sync.
+ */
+
+#pragma once
+
+#include "unpack.h"
+#include <functional>
+#include <vector>
+
+extern "C" {
+#include "acq_core.h"
+}
+
+namespace tsapi {
+
+static constexpr unsigned frame_payload_max = 4096;
+
+struct frame {
+	uint32_t        seq;
+	uint32_t        ts;
+	uint8_t         flags;  // ACQ_FL_xxx
+	uint16_t        cfg;
+	uint16_t        roi;
+	uint16_t        avg;
+	uint16_t const* payload; // valid till the handler returns
+	size_t          len;
+	uint64_t        pos;     // the stream bit position of the header
+};
+
+struct decoder_stat {
+	uint64_t frames;
+	uint64_t dropped;  // frames missing according to the frame counter
+	uint64_t overflow; // frames flagged by the controller as following the dropped ones
+	uint64_t crc_err;
+	uint64_t resyncs;  // the times the stream was out of sync
+	uint64_t skipped;  // bits skipped while looking for the header
+};
+
+class frame_decoder {
+public:
+	typedef std::function<void(frame const&)> frame_handler;
+	// Called on the first frame after the sync was lost, skipped bits starting at pos
+	typedef std::function<void(uint64_t pos, uint64_t skipped)> resync_handler;
+
+	explicit frame_decoder(frame_handler on_frame, resync_handler on_resync = nullptr, unpack_fn fn = unpack_select());
+
+	// Decode the FIFO bytes calling the handlers
+	void feed(uint8_t const* data, size_t len);
+
+	decoder_stat const& stat() const { return m_stat; }
+
+private:
+	size_t   avail() const { return m_len * 8 - m_pos; }
+	uint16_t word_at(size_t bit) const;
+	size_t   find_magic() const;
+	void     skip(size_t bits);
+	bool     parse();
+
+	frame_handler         m_on_frame;
+	resync_handler        m_on_resync;
+	bit_unpacker          m_unpacker;
+	std::vector<uint8_t>  m_bits;  // the stream bits, m_len bytes followed by the zero padding
+	size_t                m_len = 0;
+	size_t                m_pos = 0;  // the bit position of the data not parsed yet
+	uint64_t              m_base = 0; // the stream bit position of m_bits
+	std::vector<uint16_t> m_words;
+	bool                  m_synced = false;
+	uint64_t              m_lost_pos = 0;
+	uint64_t              m_lost_bits = 0;
+	bool                  m_seq_valid = false;
+	uint32_t              m_next_seq = 0;
+	decoder_stat          m_stat = {};
+};
+
+}
@@ -0,0 +1,74 @@
+#include "sim_stream.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+extern "C" {
+#include "acq_core.h"
+}
+
+namespace tsapi {
+
+// The junk in the even byte above the data bit and in the odd byte
+static constexpr uint8_t junk_even = 0xa4;
+static constexpr uint8_t junk_odd  = 0x5b;
+
+// The FIFO bytes of every byte value, MSB first
+struct spread_table {
+	uint8_t b[256][16];
+	spread_table()
+	{
+		for (unsigned v = 0; v < 256; ++v)
+			for (unsigned i = 0; i < 8; ++i) {
+				b[v][2 * i]     = junk_even | ((v >> (7 - i)) & 1);
+				b[v][2 * i + 1] = junk_odd;
+			}
+	}
+};
+
+static const spread_table spread_tab;
+
+void sim_stream::spread(uint16_t const* words, size_t cnt, uint8_t* out)
+{
+	for (; cnt; --cnt, ++words, out += 32) {
+		memcpy(out, spread_tab.b[*words >> 8], 16);
+		memcpy(out + 16, spread_tab.b[*words & 0xff], 16);
+	}
+}
+
+sim_stream::sim_stream(unsigned payload)
+	: m_payload(payload)
+	, m_frame(ACQ_HDR_LEN + payload)
+	, m_bytes(m_frame.size() * 32)
+	, m_pos(m_bytes.size())
+{
+}
+
+void sim_stream::next_frame()
+{
+	using namespace std::chrono;
+	uint32_t const ts = duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+	uint16_t* const payload = m_frame.data() + ACQ_HDR_LEN;
+	uint16_t const sn = m_seq * m_payload;
+	for (unsigned i = 0; i < m_payload; ++i)
+		payload[i] = sn + i;
+	acq_hdr_build(m_frame.data(), m_seq, ts, ACQ_FL_TEST | (m_seq ? 0 : ACQ_FL_START), nullptr, m_payload);
+	++m_seq;
+	spread(m_frame.data(), m_frame.size(), m_bytes.data());
+	m_pos = 0;
+}
+
+void sim_stream::fill(uint8_t* out, size_t len)
+{
+	while (len) {
+		if (m_pos == m_bytes.size())
+			next_frame();
+		size_t const n = std::min(len, m_bytes.size() - m_pos);
+		memcpy(out, m_bytes.data() + m_pos, n);
+		m_pos += n;
+		out += n;
+		len -= n;
+	}
+}
+
+}
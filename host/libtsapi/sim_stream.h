@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2023 TeraSense
+ * You may use, distribute and modify this code under the terms of the MIT license
+ *
+ * The simulated FX2 FIFO byte stream
+ *
+ * Generates the test pattern frames the controller sends by :TEST:FIFO (see Src/test.c):
+ * the header built by the controller code (Src/acq_core.c) followed by the payload of
+ * the incrementing words continuing from the previous frame. The words are sent MSB first
+ * one bit per 16 bit FIFO word, the bit is the LSB of the even byte. The rest of the bits
+ * are filled by the junk so the decoders have to mask them.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tsapi {
+
+class sim_stream {
+public:
+	explicit sim_stream(unsigned payload = 256);
+
+	// Fill the buffer by the next len bytes of the stream
+	void fill(uint8_t* out, size_t len);
+
+	// The number of frames generated
+	uint32_t frames() const { return m_seq; }
+
+	// The FIFO bytes carrying the words
+	static void spread(uint16_t const* words, size_t cnt, uint8_t* out);
+
+private:
+	void next_frame();
+
+	unsigned              m_payload;
+	uint32_t              m_seq = 0;
+	std::vector<uint16_t> m_frame;
+	std::vector<uint8_t>  m_bytes; // the current frame FIFO bytes
+	size_t                m_pos = 0;
+};
+
+}
@@ -0,0 +1,140 @@
+#include "transport.h"
+#include "sim_stream.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <thread>
+
+namespace tsapi {
+
+using sim_clock = std::chrono::steady_clock;
+
+// The device thread fills the transfers submitted in order like FX2 does
+class sim_transport : public transport {
+public:
+	explicit sim_transport(sim_config const& cfg)
+		: m_cfg(cfg)
+		, m_stream(cfg.payload)
+		, m_thread(&sim_transport::run, this)
+	{
+	}
+
+	~sim_transport() override
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			m_stop = true;
+		}
+		m_cv.notify_all();
+		m_thread.join();
+	}
+
+	void submit(transfer* t) override
+	{
+		t->actual = 0;
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			m_pending.push_back(t);
+		}
+		m_cv.notify_all();
+	}
+
+	void wait(std::vector<transfer*>& done, int timeout_ms) override
+	{
+		std::unique_lock<std::mutex> lock(m_lock);
+		m_cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this] { return !m_done.empty(); });
+		done.insert(done.end(), m_done.begin(), m_done.end());
+		m_done.clear();
+	}
+
+	void cancel() override
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			for (transfer* t : m_pending) {
+				t->status = xfer_cancelled;
+				m_done.push_back(t);
+			}
+			m_pending.clear();
+		}
+		m_cv.notify_all();
+	}
+
+	std::string name() const override
+	{
+		return "simulated FX2 FIFO";
+	}
+
+private:
+	// The transfer size is even so the even byte offset within it is the even one in the stream
+	void inject_faults(transfer* t)
+	{
+		std::uniform_real_distribution<double> uniform;
+		if (uniform(m_rnd) >= m_cfg.faults * t->size / 1e6)
+			return;
+		size_t const word = m_rnd() % (t->size / 2);
+		size_t lost;
+		switch (m_rnd() % 3) {
+		case 0:
+			t->data[2 * word] ^= 1;
+			return;
+		case 1:
+			lost = 1;
+			break;
+		default:
+			lost = 1 + m_rnd() % 4096;
+		}
+		lost = std::min(lost, t->size / 2 - word);
+		memmove(t->data + 2 * word, t->data + 2 * (word + lost), t->actual - 2 * (word + lost));
+		t->actual -= 2 * lost;
+	}
+
+	void run()
+	{
+		sim_clock::time_point const start = sim_clock::now();
+		uint64_t bytes = 0;
+		std::unique_lock<std::mutex> lock(m_lock);
+		for (;;) {
+			m_cv.wait(lock, [this] { return m_stop || !m_pending.empty(); });
+			if (m_stop)
+				return;
+			transfer* const t = m_pending.front();
+			m_pending.pop_front();
+			// The transfer is owned by the device till completed
+			lock.unlock();
+			m_stream.fill(t->data, t->size);
+			t->actual = t->size;
+			t->status = xfer_ok;
+			if (m_cfg.faults > 0)
+				inject_faults(t);
+			bytes += t->size;
+			if (m_cfg.rate_mbps > 0)
+				std::this_thread::sleep_until(start + std::chrono::duration_cast<sim_clock::duration>(
+					std::chrono::duration<double, std::micro>(bytes / m_cfg.rate_mbps)));
+			lock.lock();
+			m_done.push_back(t);
+			m_cv.notify_all();
+		}
+	}
+
+	sim_config              m_cfg;
+	sim_stream              m_stream;
+	std::mutex              m_lock;
+	std::condition_variable m_cv;
+	std::deque<transfer*>   m_pending;
+	std::vector<transfer*>  m_done;
+	bool                    m_stop = false;
+	std::mt19937            m_rnd;
+	std::thread             m_thread; // started last
+};
+
+std::unique_ptr<transport> sim_transport_open(sim_config const& cfg)
+{
+	return std::unique_ptr<transport>(new sim_transport(cfg));
+}
+
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2023 TeraSense
+ * You may use, distribute and modify this code under the terms of the MIT license
+ *
+ * Lock free single producer single consumer ring
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+
+namespace tsapi {
+
+template <typename T>
+class spsc_ring {
+public:
+	// The size is rounded up to the power of 2
+	explicit spsc_ring(size_t size)
+	{
+		for (m_size = 1; m_size < size; m_size <<= 1)
+			;
+		m_buff.reset(new T[m_size]);
+	}
+
+	spsc_ring(spsc_ring const&) = delete;
+	spsc_ring& operator=(spsc_ring const&) = delete;
+
+	size_t capacity() const { return m_size; }
+
+	// Producer side. Returns false if the ring is full.
+	bool push(T const& v)
+	{
+		size_t const head = m_head.load(std::memory_order_relaxed);
+		if (head - m_tail_cache == m_size) {
+			m_tail_cache = m_tail.load(std::memory_order_acquire);
+			if (head - m_tail_cache == m_size)
+				return false;
+		}
+		m_buff[head & (m_size - 1)] = v;
+		m_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer side. Returns false if the ring is empty.
+	bool pop(T& v)
+	{
+		size_t const tail = m_tail.load(std::memory_order_relaxed);
+		if (tail == m_head_cache) {
+			m_head_cache = m_head.load(std::memory_order_acquire);
+			if (tail == m_head_cache)
+				return false;
+		}
+		v = m_buff[tail & (m_size - 1)];
+		m_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Approximate when called concurrently
+	size_t size() const
+	{
+		return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire);
+	}
+
+private:
+	static constexpr size_t cache_line = 64;
+
+	std::unique_ptr<T[]> m_buff;
+	size_t               m_size;
+	// The positions are free running. Each side keeps the cached copy of the other
+	// side position on its own cache line to avoid reading the shared one every time.
+	alignas(cache_line) std::atomic<size_t> m_head{0};
+	size_t                                  m_tail_cache{0};
+	alignas(cache_line) std::atomic<size_t> m_tail{0};
+	size_t                                  m_head_cache{0};
+};
+
+}
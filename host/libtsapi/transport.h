@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2023 TeraSense
+ * You may use, distribute and modify this code under the terms of the MIT license
+ *
+ * FX2 FIFO transport interface
+ *
+ * The transport keeps the read transfers submitted by the caller in flight and
+ * returns them once completed. The USB one reads the FX2 FIFO endpoint by the
+ * asynchronous libusb bulk transfers, the simulated one generates the stream the
+ * controller sends in the test mode in process so the whole pipeline may be run
+ * without the device.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace tsapi {
+
+class error : public std::runtime_error {
+public:
+	using std::runtime_error::runtime_error;
+};
+
+enum transfer_status {
+	xfer_ok,
+	xfer_timeout,   // no data
+	xfer_cancelled,
+	xfer_error,
+	xfer_gone,      // the device is disconnected
+};
+
+struct transfer {
+	uint8_t*        data;
+	size_t          size;
+	size_t          actual;   // the number of bytes read
+	transfer_status status;
+	unsigned        index;    // the caller's buffer index
+	void*           priv;     // the transport data, NULL initially
+};
+
+class transport {
+public:
+	virtual ~transport() = default;
+
+	// Queue the transfer. Throws tsapi::error on failure.
+	virtual void submit(transfer* t) = 0;
+
+	// Wait up to timeout for the transfers completed and append them to done.
+	// Should be called by the single thread, the same one submitting transfers.
+	virtual void wait(std::vector<transfer*>& done, int timeout_ms) = 0;
+
+	// Cancel the transfers in flight, they are returned by wait() as cancelled
+	virtual void cancel() = 0;
+
+	virtual std::string name() const = 0;
+};
+
+// The FX2 FIFO device
+static constexpr uint16_t fx2_vid = 0x04b4;
+static constexpr uint16_t fx2_pid = 0x4717;
+static constexpr uint8_t  fx2_ep  = 0x86;
+
+// Open the FX2 FIFO device. Throws tsapi::error if it is not found or the library
+// is built without libusb.
+std::unique_ptr<transport> usb_transport_open(uint16_t vid = fx2_vid, uint16_t pid = fx2_pid, uint8_t ep = fx2_ep);
+
+struct sim_config {
+	double   rate_mbps = 0;   // the byte rate limit in MB/s as seen by the host, 0 for unlimited
+	unsigned payload   = 256; // the test frame payload in words
+	// The link faults injected per MB on average: the data bit flipped, the bit lost
+	// (one FIFO word) or the run of the FIFO words lost
+	double   faults    = 0;
+};
+
+// Open the simulated device sending the test pattern frames
+std::unique_ptr<transport> sim_transport_open(sim_config const& cfg = sim_config());
+
+}
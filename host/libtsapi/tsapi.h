@@ -0,0 +1,21 @@
+/*
+ * Copyright (C) 2023 TeraSense
+ * You may use, distribute and modify this code under the terms of the MIT license
+ *
+ * TeraSense SmartVision host streaming library
+ *
+ * Usage:
+ *   tsapi::fifo_reader rd(tsapi::usb_transport_open());
+ *   rd.start();
+ *   tsapi::buffer_view v;
+ *   while (rd.next(v, 1000)) {
+ *     ... v.data, v.size ...
+ *     rd.release(v);
+ *   }
+ */
+
+#pragma once
+
+#include "transport.h"
+#include "fifo_reader.h"
+#include "sim_stream.h"
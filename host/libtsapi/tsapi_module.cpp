@@ -0,0 +1,552 @@
+/*
+ * Copyright (C) 2023 TeraSense
+ * You may use, distribute and modify this code under the terms of the MIT license
+ *
+ * The _tsapi Python extension module
+ *
+ * Exposes the native FIFO stream decoder and reader to the Python tools (see ts_native.py).
+ * Built against the stable ABI so the single binary serves Python 3.11 and later.
+ *
+ *   decoder().feed(data, rx_ts=0)  - decodes the FIFO bytes, returns the list of frames
+ *   reader(sim=False, ...).read()  - reads the FIFO, returns (bytes read, list of frames)
+ *
+ * The frame object exports its payload by the buffer protocol as the array of 16 bit
+ * words so memoryview(f) or numpy.frombuffer(f, numpy.uint16) does not copy it. Its
+ * payload attribute is such memoryview. The GIL is released while reading and decoding.
+ * The object is busy meanwhile, the calls made by other threads till then raise the error
+ * rather than using or deleting its native state.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#define Py_LIMITED_API 0x030b0000
+#include <Python.h>
+
+#include "tsapi.h"
+#include "frame_decoder.h"
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace tsapi;
+
+static PyObject* tsapi_error;
+static PyTypeObject* frame_type;
+
+// The frame decoded while the GIL is released, the payload is passed to the frame object
+struct native_frame {
+	frame     f;
+	uint16_t* payload;
+	uint64_t  rx_ts;
+};
+
+// Collects the frames decoded without the GIL
+struct frame_sink {
+	std::vector<native_frame> frames;
+	uint64_t                  rx_ts = 0;
+	bool                      nomem = false;
+
+	~frame_sink() { clear(); }
+
+	void operator()(frame const& f)
+	{
+		uint16_t* const p = nomem ? nullptr : static_cast<uint16_t*>(malloc(f.len ? f.len * sizeof(uint16_t) : 1));
+		if (!p) {
+			nomem = true;
+			return;
+		}
+		memcpy(p, f.payload, f.len * sizeof(uint16_t));
+		try {
+			frames.push_back(native_frame{f, p, rx_ts});
+		} catch (std::bad_alloc const&) {
+			free(p);
+			nomem = true;
+			return;
+		}
+		frames.back().f.payload = nullptr;
+	}
+
+	void clear()
+	{
+		for (native_frame& nf : frames)
+			free(nf.payload);
+		frames.clear();
+		nomem = false;
+	}
+};
+
+/*
+ * frame
+ */
+
+struct frame_object {
+	PyObject_HEAD
+	frame      f;
+	uint16_t*  payload;
+	uint64_t   rx_ts;
+	Py_ssize_t shape;
+	Py_ssize_t stride;
+};
+
+static void frame_dealloc(PyObject* self)
+{
+	PyTypeObject* const tp = Py_TYPE(self);
+	free(reinterpret_cast<frame_object*>(self)->payload);
+	reinterpret_cast<freefunc>(PyType_GetSlot(tp, Py_tp_free))(self);
+	Py_DECREF(tp);
+}
+
+static int frame_getbuffer(PyObject* self, Py_buffer* view, int flags)
+{
+	frame_object* const fo = reinterpret_cast<frame_object*>(self);
+	if (flags & PyBUF_WRITABLE) {
+		PyErr_SetString(PyExc_BufferError, "frame payload is read only");
+		view->obj = nullptr;
+		return -1;
+	}
+	view->buf = fo->payload;
+	view->obj = self;
+	Py_INCREF(self);
+	view->len = fo->shape * sizeof(uint16_t);
+	view->readonly = 1;
+	view->itemsize = sizeof(uint16_t);
+	view->format = (flags & PyBUF_FORMAT) ? const_cast<char*>("H") : nullptr;
+	view->ndim = 1;
+	view->shape = (flags & PyBUF_ND) ? &fo->shape : nullptr;
+	view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? &fo->stride : nullptr;
+	view->suboffsets = nullptr;
+	view->internal = nullptr;
+	return 0;
+}
+
+static void frame_releasebuffer(PyObject*, Py_buffer*)
+{
+}
+
+static PyObject* frame_new(native_frame& nf)
+{
+	allocfunc const alloc = reinterpret_cast<allocfunc>(PyType_GetSlot(frame_type, Py_tp_alloc));
+	frame_object* const fo = reinterpret_cast<frame_object*>(alloc(frame_type, 0));
+	if (!fo)
+		return nullptr;
+	fo->f = nf.f;
+	fo->payload = nf.payload;
+	nf.payload = nullptr;
+	fo->rx_ts = nf.rx_ts;
+	fo->shape = nf.f.len;
+	fo->stride = sizeof(uint16_t);
+	return reinterpret_cast<PyObject*>(fo);
+}
+
+// Returns the list of frame objects taking the payloads collected
+static PyObject* frames_list(frame_sink& sink)
+{
+	PyObject* list = nullptr;
+	if (sink.nomem)
+		PyErr_NoMemory();
+	else if ((list = PyList_New(sink.frames.size()))) {
+		for (size_t i = 0; i < sink.frames.size(); ++i) {
+			PyObject* const fo = frame_new(sink.frames[i]);
+			if (!fo) {
+				Py_CLEAR(list);
+				break;
+			}
+			PyList_SetItem(list, i, fo);
+		}
+	}
+	sink.clear();
+	return list;
+}
+
+#define FRAME_GETTER(name, expr) \
+	static PyObject* frame_get_##name(PyObject* self, void*) \
+	{ \
+		frame_object const* const fo = reinterpret_cast<frame_object*>(self); \
+		return PyLong_FromUnsignedLongLong(expr); \
+	}
+
+FRAME_GETTER(seq, fo->f.seq)
+FRAME_GETTER(ts, fo->f.ts)
+FRAME_GETTER(flags, fo->f.flags)
+FRAME_GETTER(cfg, fo->f.cfg)
+FRAME_GETTER(roi, fo->f.roi)
+FRAME_GETTER(avg, fo->f.avg)
+FRAME_GETTER(pos, fo->f.pos)
+FRAME_GETTER(rx_ts, fo->rx_ts)
+
+static PyObject* frame_get_payload(PyObject* self, void*)
+{
+	return PyMemoryView_FromObject(self);
+}
+
+static PyGetSetDef frame_getset[] = {
+	{"seq", frame_get_seq, nullptr, "frame counter", nullptr},
+	{"ts", frame_get_ts, nullptr, "controller timestamp, usec", nullptr},
+	{"flags", frame_get_flags, nullptr, "header flags", nullptr},
+	{"cfg", frame_get_cfg, nullptr, "configuration straps", nullptr},
+	{"roi", frame_get_roi, nullptr, "ROI mask", nullptr},
+	{"avg", frame_get_avg, nullptr, "averaging count", nullptr},
+	{"pos", frame_get_pos, nullptr, "stream bit position", nullptr},
+	{"rx_ts", frame_get_rx_ts, nullptr, "host receive time by the monotonic clock, usec", nullptr},
+	{"payload", frame_get_payload, nullptr, "payload words memoryview", nullptr},
+	{nullptr, nullptr, nullptr, nullptr, nullptr}
+};
+
+static PyType_Slot frame_slots[] = {
+	{Py_tp_doc, const_cast<char*>("The decoded frame, exports the payload words by the buffer protocol")},
+	{Py_tp_dealloc, reinterpret_cast<void*>(frame_dealloc)},
+	{Py_tp_getset, frame_getset},
+	{Py_bf_getbuffer, reinterpret_cast<void*>(frame_getbuffer)},
+	{Py_bf_releasebuffer, reinterpret_cast<void*>(frame_releasebuffer)},
+	{0, nullptr}
+};
+
+static PyType_Spec frame_spec = {
+	"_tsapi.frame", sizeof(frame_object), 0, Py_TPFLAGS_DEFAULT, frame_slots
+};
+
+/*
+ * Statistics
+ */
+
+static bool dict_set(PyObject* d, const char* key, uint64_t v)
+{
+	PyObject* const o = PyLong_FromUnsignedLongLong(v);
+	if (!o)
+		return false;
+	int const rc = PyDict_SetItemString(d, key, o);
+	Py_DECREF(o);
+	return !rc;
+}
+
+static PyObject* decoder_stat_dict(decoder_stat const& s, reader_stat const* r = nullptr)
+{
+	PyObject* d = PyDict_New();
+	if (!d)
+		return nullptr;
+	bool ok = dict_set(d, "frames", s.frames) && dict_set(d, "dropped", s.dropped) &&
+		dict_set(d, "overflow", s.overflow) && dict_set(d, "crc_err", s.crc_err) &&
+		dict_set(d, "resyncs", s.resyncs) && dict_set(d, "skipped", s.skipped);
+	if (ok && r)
+		ok = dict_set(d, "buffers", r->buffers) && dict_set(d, "bytes", r->bytes) &&
+			dict_set(d, "timeouts", r->timeouts) && dict_set(d, "errors", r->errors) &&
+			dict_set(d, "starved", r->starved);
+	if (!ok)
+		Py_CLEAR(d);
+	return d;
+}
+
+// Raise the error if the object native state is used by another thread with the GIL released
+static bool check_busy(bool busy)
+{
+	if (busy)
+		PyErr_SetString(tsapi_error, "the object is in use by another thread");
+	return !busy;
+}
+
+/*
+ * decoder
+ */
+
+struct decoder_object {
+	PyObject_HEAD
+	frame_decoder* dec;
+	frame_sink*    sink;
+	bool           busy; // dec and sink are used with the GIL released
+};
+
+static int decoder_init(PyObject* obj, PyObject* args, PyObject* kw)
+{
+	static const char* kwlist[] = {nullptr};
+	decoder_object* const self = reinterpret_cast<decoder_object*>(obj);
+	if (!PyArg_ParseTupleAndKeywords(args, kw, ":decoder", const_cast<char**>(kwlist)) || !check_busy(self->busy))
+		return -1;
+	delete self->dec;
+	self->dec = nullptr;
+	try {
+		if (!self->sink)
+			self->sink = new frame_sink;
+		frame_sink* const sink = self->sink;
+		self->dec = new frame_decoder([sink](frame const& f) { (*sink)(f); });
+	} catch (std::exception const& e) {
+		PyErr_SetString(tsapi_error, e.what());
+		return -1;
+	}
+	return 0;
+}
+
+static void decoder_dealloc(PyObject* obj)
+{
+	decoder_object* const self = reinterpret_cast<decoder_object*>(obj);
+	PyTypeObject* const tp = Py_TYPE(obj);
+	delete self->dec;
+	delete self->sink;
+	reinterpret_cast<freefunc>(PyType_GetSlot(tp, Py_tp_free))(obj);
+	Py_DECREF(tp);
+}
+
+static PyObject* decoder_feed(PyObject* obj, PyObject* args, PyObject* kw)
+{
+	static const char* kwlist[] = {"data", "rx_ts", nullptr};
+	decoder_object* const self = reinterpret_cast<decoder_object*>(obj);
+	PyObject* data;
+	double rx_ts = 0;
+	Py_buffer buf;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kw, "O|d:feed", const_cast<char**>(kwlist), &data, &rx_ts))
+		return nullptr;
+	if (!check_busy(self->busy))
+		return nullptr;
+	if (!self->dec) {
+		PyErr_SetString(tsapi_error, "decoder is not initialized");
+		return nullptr;
+	}
+	if (PyObject_GetBuffer(data, &buf, PyBUF_SIMPLE))
+		return nullptr;
+	self->sink->rx_ts = rx_ts;
+	self->busy = true;
+	Py_BEGIN_ALLOW_THREADS
+	self->dec->feed(static_cast<uint8_t const*>(buf.buf), buf.len);
+	Py_END_ALLOW_THREADS
+	self->busy = false;
+	PyBuffer_Release(&buf);
+	return frames_list(*self->sink);
+}
+
+static PyObject* decoder_stat_get(PyObject* obj, PyObject*)
+{
+	decoder_object* const self = reinterpret_cast<decoder_object*>(obj);
+	if (!check_busy(self->busy))
+		return nullptr;
+	if (!self->dec) {
+		PyErr_SetString(tsapi_error, "decoder is not initialized");
+		return nullptr;
+	}
+	return decoder_stat_dict(self->dec->stat());
+}
+
+static PyMethodDef decoder_methods[] = {
+	{"feed", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)(void)>(decoder_feed)), METH_VARARGS | METH_KEYWORDS,
+		"feed(data, rx_ts=0) decodes the FIFO bytes, returns the list of frames"},
+	{"stat", decoder_stat_get, METH_NOARGS, "returns the decoder statistics dictionary"},
+	{nullptr, nullptr, 0, nullptr}
+};
+
+static PyType_Slot decoder_slots[] = {
+	{Py_tp_doc, const_cast<char*>("decoder() decodes the FIFO bytes onto frames")},
+	{Py_tp_new, reinterpret_cast<void*>(PyType_GenericNew)},
+	{Py_tp_init, reinterpret_cast<void*>(decoder_init)},
+	{Py_tp_dealloc, reinterpret_cast<void*>(decoder_dealloc)},
+	{Py_tp_methods, decoder_methods},
+	{0, nullptr}
+};
+
+static PyType_Spec decoder_spec = {
+	"_tsapi.decoder", sizeof(decoder_object), 0, Py_TPFLAGS_DEFAULT, decoder_slots
+};
+
+/*
+ * reader
+ */
+
+struct reader_object {
+	PyObject_HEAD
+	fifo_reader*   rd;
+	frame_decoder* dec;  // NULL if not decoding
+	frame_sink*    sink;
+	bool           busy; // rd, dec and sink are used with the GIL released
+};
+
+// The caller checks the reader is not busy
+static void reader_close_native(reader_object* self)
+{
+	if (self->rd) {
+		self->busy = true;
+		Py_BEGIN_ALLOW_THREADS
+		self->rd->stop();
+		Py_END_ALLOW_THREADS
+		self->busy = false;
+	}
+	delete self->rd;
+	delete self->dec;
+	self->rd = nullptr;
+	self->dec = nullptr;
+}
+
+static int reader_init(PyObject* obj, PyObject* args, PyObject* kw)
+{
+	static const char* kwlist[] = {"sim", "decode", "transfers", "transfer_size", "buffers", "sim_rate", "sim_faults", nullptr};
+	reader_object* const self = reinterpret_cast<reader_object*>(obj);
+	int sim = 0, decode = 1;
+	reader_config cfg;
+	sim_config sc;
+	Py_ssize_t size = cfg.transfer_size;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kw, "|ppInIdd:reader", const_cast<char**>(kwlist),
+			&sim, &decode, &cfg.transfers, &size, &cfg.buffers, &sc.rate_mbps, &sc.faults) || !check_busy(self->busy))
+		return -1;
+	cfg.transfer_size = size;
+	reader_close_native(self);
+	try {
+		if (!self->sink)
+			self->sink = new frame_sink;
+		frame_sink* const sink = self->sink;
+		if (decode)
+			self->dec = new frame_decoder([sink](frame const& f) { (*sink)(f); });
+		self->rd = new fifo_reader(sim ? sim_transport_open(sc) : usb_transport_open(), cfg);
+		self->rd->start();
+	} catch (std::exception const& e) {
+		reader_close_native(self);
+		PyErr_SetString(tsapi_error, e.what());
+		return -1;
+	}
+	return 0;
+}
+
+static void reader_dealloc(PyObject* obj)
+{
+	reader_object* const self = reinterpret_cast<reader_object*>(obj);
+	PyTypeObject* const tp = Py_TYPE(obj);
+	reader_close_native(self);
+	delete self->sink;
+	reinterpret_cast<freefunc>(PyType_GetSlot(tp, Py_tp_free))(obj);
+	Py_DECREF(tp);
+}
+
+static PyObject* reader_read(PyObject* obj, PyObject* args, PyObject* kw)
+{
+	static const char* kwlist[] = {"timeout", nullptr};
+	reader_object* const self = reinterpret_cast<reader_object*>(obj);
+	double timeout = 1;
+	bool got = false;
+	size_t nbytes = 0;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kw, "|d:read", const_cast<char**>(kwlist), &timeout) || !check_busy(self->busy))
+		return nullptr;
+	if (!self->rd) {
+		PyErr_SetString(tsapi_error, "reader is closed");
+		return nullptr;
+	}
+	self->busy = true;
+	Py_BEGIN_ALLOW_THREADS
+	buffer_view v;
+	if ((got = self->rd->next(v, static_cast<int>(timeout * 1000)))) {
+		nbytes = v.size;
+		self->sink->rx_ts = v.rx_us;
+		if (self->dec)
+			self->dec->feed(v.data, v.size);
+		self->rd->release(v);
+	}
+	Py_END_ALLOW_THREADS
+	self->busy = false;
+	if (!got && !self->rd->running()) {
+		PyErr_SetString(tsapi_error, self->rd->last_error().empty() ? "reader stopped" : self->rd->last_error().c_str());
+		return nullptr;
+	}
+	PyObject* const frames = frames_list(*self->sink);
+	if (!frames)
+		return nullptr;
+	return Py_BuildValue("nN", static_cast<Py_ssize_t>(nbytes), frames);
+}
+
+static PyObject* reader_stat_get(PyObject* obj, PyObject*)
+{
+	reader_object* const self = reinterpret_cast<reader_object*>(obj);
+	if (!check_busy(self->busy))
+		return nullptr;
+	if (!self->rd) {
+		PyErr_SetString(tsapi_error, "reader is closed");
+		return nullptr;
+	}
+	reader_stat const r = self->rd->stat();
+	return decoder_stat_dict(self->dec ? self->dec->stat() : decoder_stat{}, &r);
+}
+
+static PyObject* reader_close(PyObject* obj, PyObject*)
+{
+	reader_object* const self = reinterpret_cast<reader_object*>(obj);
+	if (!check_busy(self->busy))
+		return nullptr;
+	reader_close_native(self);
+	Py_RETURN_NONE;
+}
+
+static PyMethodDef reader_methods[] = {
+	{"read", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)(void)>(reader_read)), METH_VARARGS | METH_KEYWORDS,
+		"read(timeout=1.) returns the tuple of the number of bytes read (0 on timeout) and the list of frames decoded"},
+	{"stat", reader_stat_get, METH_NOARGS, "returns the reader and decoder statistics dictionary"},
+	{"close", reader_close, METH_NOARGS, "stops reading"},
+	{nullptr, nullptr, 0, nullptr}
+};
+
+static PyType_Slot reader_slots[] = {
+	{Py_tp_doc, const_cast<char*>(
+		"reader(sim=False, decode=True, transfers=32, transfer_size=65536, buffers=128, sim_rate=0., sim_faults=0.)\n"
+		"reads the FX2 FIFO or the simulated device by many transfers in flight")},
+	{Py_tp_new, reinterpret_cast<void*>(PyType_GenericNew)},
+	{Py_tp_init, reinterpret_cast<void*>(reader_init)},
+	{Py_tp_dealloc, reinterpret_cast<void*>(reader_dealloc)},
+	{Py_tp_methods, reader_methods},
+	{0, nullptr}
+};
+
+static PyType_Spec reader_spec = {
+	"_tsapi.reader", sizeof(reader_object), 0, Py_TPFLAGS_DEFAULT, reader_slots
+};
+
+/*
+ * module
+ */
+
+static PyObject* usb_supported(PyObject*, PyObject*)
+{
+#ifdef TSAPI_USB
+	Py_RETURN_TRUE;
+#else
+	Py_RETURN_FALSE;
+#endif
+}
+
+static PyMethodDef module_methods[] = {
+	{"usb_supported", usb_supported, METH_NOARGS, "returns True if the reader may open the FX2 FIFO device"},
+	{nullptr, nullptr, 0, nullptr}
+};
+
+static int module_add_type(PyObject* m, PyType_Spec* spec, PyTypeObject** tp)
+{
+	PyObject* const t = PyType_FromSpec(spec);
+	if (!t)
+		return -1;
+	if (tp) {
+		Py_INCREF(t);
+		*tp = reinterpret_cast<PyTypeObject*>(t);
+	}
+	char const* const name = strchr(spec->name, '.') + 1;
+	if (PyModule_AddObject(m, name, t)) {
+		Py_DECREF(t);
+		return -1;
+	}
+	return 0;
+}
+
+static PyModuleDef module_def = {
+	PyModuleDef_HEAD_INIT, "_tsapi", "TeraSense native FIFO stream reader and decoder", -1, module_methods,
+	nullptr, nullptr, nullptr, nullptr
+};
+
+PyMODINIT_FUNC PyInit__tsapi(void)
+{
+	PyObject* const m = PyModule_Create(&module_def);
+	if (!m)
+		return nullptr;
+	tsapi_error = PyErr_NewException("_tsapi.error", PyExc_RuntimeError, nullptr);
+	if (!tsapi_error || PyModule_AddObject(m, "error", tsapi_error) ||
+		module_add_type(m, &frame_spec, &frame_type) ||
+		module_add_type(m, &decoder_spec, nullptr) ||
+		module_add_type(m, &reader_spec, nullptr)
+	) {
+		Py_DECREF(m);
+		return nullptr;
+	}
+	Py_INCREF(tsapi_error);
+	return m;
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2023 TeraSense
+ * You may use, distribute and modify this code under the terms of the MIT license
+ *
+ * FX2 FIFO streaming benchmark
+ *
+ * Reads the FIFO stream through the library pipeline for the given time and reports
+ * the throughput and the reader statistics. Runs against the simulated device unless
+ * -u is given. The device should be streaming already (see tsvictl.py fifo-test).
+ * The data received may be recorded to the file by -o for the decoder benchmarks.
+ */
+
+#include "tsapi.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+using namespace tsapi;
+
+static volatile uint64_t sink;
+
+static void usage(const char* name)
+{
+	fprintf(stderr,
+		"Usage: %s [-u] [-t transfers] [-s transfer_size] [-b buffers] [-r sim_rate_mbps] [-d seconds] [-o file]\n"
+		"  -u  read the FX2 FIFO device rather than the simulated one\n"
+		"  -o  record the data received to the file\n", name);
+}
+
+int main(int argc, char* argv[])
+{
+	reader_config cfg;
+	sim_config sim;
+	bool usb = false;
+	double duration = 5;
+	FILE* rec = nullptr;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "ut:s:b:r:d:o:h")) != -1) {
+		switch (opt) {
+		case 'u':
+			usb = true;
+			break;
+		case 't':
+			cfg.transfers = atoi(optarg);
+			break;
+		case 's':
+			cfg.transfer_size = atoi(optarg);
+			break;
+		case 'b':
+			cfg.buffers = atoi(optarg);
+			break;
+		case 'r':
+			sim.rate_mbps = atof(optarg);
+			break;
+		case 'd':
+			duration = atof(optarg);
+			break;
+		case 'o':
+			if (!(rec = fopen(optarg, "wb"))) {
+				perror(optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	try {
+		fifo_reader rd(usb ? usb_transport_open() : sim_transport_open(sim), cfg);
+		auto const start = std::chrono::steady_clock::now();
+		std::chrono::duration<double> elapsed;
+		uint64_t bytes = 0, sum = 0, next_seq = 0;
+		buffer_view v;
+
+		printf("%s: %u transfers of %zu bytes in flight, %u buffers\n",
+			rd.get_transport().name().c_str(), cfg.transfers, cfg.transfer_size, cfg.buffers);
+		rd.start();
+		do {
+			if (!rd.next(v, 1000)) {
+				fprintf(stderr, "%s\n", rd.running() ? "no data" : rd.last_error().c_str());
+				return EXIT_FAILURE;
+			}
+			if (v.seq != next_seq) {
+				fprintf(stderr, "buffer %llu out of order\n", (unsigned long long)v.seq);
+				return EXIT_FAILURE;
+			}
+			++next_seq;
+			// Touch the data the way the decoder would
+			for (size_t i = 0; i < v.size; i += 64)
+				sum += v.data[i];
+			bytes += v.size;
+			if (rec && fwrite(v.data, 1, v.size, rec) != v.size) {
+				perror("recording failed");
+				return EXIT_FAILURE;
+			}
+			rd.release(v);
+			elapsed = std::chrono::steady_clock::now() - start;
+		} while (elapsed.count() < duration);
+		rd.stop();
+		sink = sum;
+		if (rec)
+			fclose(rec);
+
+		reader_stat const s = rd.stat();
+		printf("%.1f MB/sec, %llu buffers, %llu timeouts, %llu errors, %llu starved\n",
+			bytes / 1e6 / elapsed.count(), (unsigned long long)s.buffers, (unsigned long long)s.timeouts,
+			(unsigned long long)s.errors, (unsigned long long)s.starved);
+	} catch (error const& e) {
+		fprintf(stderr, "%s\n", e.what());
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
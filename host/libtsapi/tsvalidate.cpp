@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2023 TeraSense
+ * You may use, distribute and modify this code under the terms of the MIT license
+ *
+ * FIFO test pattern validator
+ *
+ * Decodes the FIFO stream and checks the test pattern the controller sends by
+ * :TEST:FIFO (start it by tsvictl.py fifo-test or :TEST:FIFO:STAT START). The stream
+ * is read from the FX2 FIFO device (-u), the recorded file (-f) or the simulated device
+ * with the link faults injected (-e). Reports the statistics, the events with their
+ * stream positions and the decoding speed per core compared to the USB 2.0 high speed
+ * bulk transfer rate.
+ */
+
+#include "tsapi.h"
+#include "validator.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+using namespace tsapi;
+using std::chrono::steady_clock;
+
+// The practical USB 2.0 high speed bulk rate, MB/s
+static constexpr double usb_hs_rate = 53.2;
+
+static const char* const event_names[] = {"gap", "pattern", "resync"};
+
+static void usage(const char* name)
+{
+	fprintf(stderr,
+		"Usage: %s [-u | -f file] [-e faults_per_MB] [-d seconds] [-v]\n"
+		"  -u  read the FX2 FIFO device rather than the simulated one\n"
+		"  -f  read the recorded file\n"
+		"  -e  inject the faults to the simulated stream\n"
+		"  -v  list the events\n", name);
+}
+
+static int report(validator const& v, uint64_t bytes, double wall, double busy, bool verbose)
+{
+	validator_stat const& s = v.stat();
+	decoder_stat const& d = v.decoder();
+	printf("%.1f MB in %.2f sec, decoding %.1f MB/sec per core (%.1fx USB HS)\n",
+		bytes / 1e6, wall, bytes / 1e6 / busy, bytes / 1e6 / busy / usb_hs_rate);
+	printf("%llu frames (%llu test), %llu pattern errors, %llu gaps (%llu frames missing), %llu resyncs, longest clean run %llu frames\n",
+		(unsigned long long)s.frames, (unsigned long long)s.test_frames, (unsigned long long)s.errors,
+		(unsigned long long)s.gaps, (unsigned long long)s.missing, (unsigned long long)s.resyncs,
+		(unsigned long long)s.longest_run);
+	printf("decoder: %llu CRC errors, %llu bits skipped, %llu overflows\n",
+		(unsigned long long)d.crc_err, (unsigned long long)d.skipped, (unsigned long long)d.overflow);
+	if (verbose)
+		for (validator_event const& e : v.events())
+			printf("  %-7s at bit %llu before frame %u: %llu\n", event_names[e.kind],
+				(unsigned long long)e.pos, e.seq, (unsigned long long)e.count);
+	return s.errors || s.gaps || s.resyncs || !s.test_frames ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int main(int argc, char* argv[])
+{
+	sim_config sim;
+	bool usb = false, verbose = false;
+	const char* file = nullptr;
+	double duration = 5;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "uf:e:d:vh")) != -1) {
+		switch (opt) {
+		case 'u':
+			usb = true;
+			break;
+		case 'f':
+			file = optarg;
+			break;
+		case 'e':
+			sim.faults = atof(optarg);
+			break;
+		case 'd':
+			duration = atof(optarg);
+			break;
+		case 'v':
+			verbose = true;
+			break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	validator v;
+	uint64_t bytes = 0;
+	std::chrono::duration<double> busy(0);
+	auto const start = steady_clock::now();
+
+	if (file) {
+		static uint8_t buf[1 << 16];
+		FILE* f = fopen(file, "rb");
+		if (!f) {
+			perror(file);
+			return EXIT_FAILURE;
+		}
+		size_t n;
+		while ((n = fread(buf, 1, sizeof(buf), f))) {
+			auto const t = steady_clock::now();
+			v.feed(buf, n);
+			busy += steady_clock::now() - t;
+			bytes += n;
+		}
+		fclose(f);
+	} else {
+		try {
+			fifo_reader rd(usb ? usb_transport_open() : sim_transport_open(sim));
+			buffer_view b;
+			rd.start();
+			while (steady_clock::now() - start < std::chrono::duration<double>(duration)) {
+				if (!rd.next(b, 1000)) {
+					fprintf(stderr, "%s\n", rd.running() ? "no data" : rd.last_error().c_str());
+					return EXIT_FAILURE;
+				}
+				auto const t = steady_clock::now();
+				v.feed(b.data, b.size);
+				busy += steady_clock::now() - t;
+				bytes += b.size;
+				rd.release(b);
+			}
+			rd.stop();
+		} catch (error const& e) {
+			fprintf(stderr, "%s\n", e.what());
+			return EXIT_FAILURE;
+		}
+	}
+	std::chrono::duration<double> const wall = steady_clock::now() - start;
+	return report(v, bytes, wall.count(), busy.count(), verbose);
+}
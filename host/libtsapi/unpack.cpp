@@ -0,0 +1,114 @@
+#include "unpack.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define UNPACK_X86
+#include <immintrin.h>
+#endif
+
+namespace tsapi {
+
+static void unpack_bits_scalar(uint8_t const* in, size_t len, uint8_t* out)
+{
+	for (; len >= unpack_ratio; len -= unpack_ratio, in += unpack_ratio) {
+		unsigned b = 0;
+		for (unsigned i = 0; i < unpack_ratio; i += 2)
+			b = (b << 1) | (in[i] & 1);
+		*out++ = b;
+	}
+}
+
+#ifdef UNPACK_X86
+
+// Reverse the 16 bit lanes so the first bit goes to the MSB of the output byte
+static inline __m128i lanes_reverse(__m128i v)
+{
+	v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+	v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+	return _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+}
+
+static void unpack_bits_sse2(uint8_t const* in, size_t len, uint8_t* out)
+{
+	for (; len >= 32; len -= 32, in += 32, out += 2) {
+		__m128i const a = _mm_slli_epi16(_mm_loadu_si128((__m128i const*)in), 15);
+		__m128i const b = _mm_slli_epi16(_mm_loadu_si128((__m128i const*)(in + 16)), 15);
+		uint16_t const m = _mm_movemask_epi8(_mm_packs_epi16(lanes_reverse(a), lanes_reverse(b)));
+		memcpy(out, &m, sizeof(m));
+	}
+	unpack_bits_scalar(in, len, out);
+}
+
+__attribute__((target("avx2")))
+static void unpack_bits_avx2(uint8_t const* in, size_t len, uint8_t* out)
+{
+	// Reverse the bytes within each 8 bytes group
+	__m256i const rev = _mm256_setr_epi8(
+		7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+		7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8
+	);
+	for (; len >= 64; len -= 64, in += 64, out += 4) {
+		__m256i const a = _mm256_slli_epi16(_mm256_loadu_si256((__m256i const*)in), 15);
+		__m256i const b = _mm256_slli_epi16(_mm256_loadu_si256((__m256i const*)(in + 32)), 15);
+		// The packing works within 128 bit lanes, restore the order of the 64 bit parts
+		__m256i const p = _mm256_permute4x64_epi64(_mm256_packs_epi16(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+		uint32_t const m = _mm256_movemask_epi8(_mm256_shuffle_epi8(p, rev));
+		memcpy(out, &m, sizeof(m));
+	}
+	unpack_bits_sse2(in, len, out);
+}
+
+#endif
+
+unpack_fn unpack_select(unpack_kernel k)
+{
+	switch (k) {
+	case unpack_scalar:
+		return unpack_bits_scalar;
+#ifdef UNPACK_X86
+	case unpack_sse2:
+		return unpack_bits_sse2;
+	case unpack_avx2:
+		return __builtin_cpu_supports("avx2") ? unpack_bits_avx2 : nullptr;
+	case unpack_auto:
+		return __builtin_cpu_supports("avx2") ? unpack_bits_avx2 : unpack_bits_sse2;
+#else
+	case unpack_auto:
+		return unpack_bits_scalar;
+#endif
+	default:
+		return nullptr;
+	}
+}
+
+const char* unpack_name(unpack_kernel k)
+{
+	static const char* const names[] = {"scalar", "sse2", "avx2", "auto"};
+	return names[k];
+}
+
+size_t bit_unpacker::feed(uint8_t const* in, size_t len, uint8_t* out)
+{
+	size_t n = 0;
+	if (m_carry_len) {
+		size_t const fill = std::min(len, unpack_ratio - m_carry_len);
+		memcpy(m_carry + m_carry_len, in, fill);
+		m_carry_len += fill;
+		in += fill;
+		len -= fill;
+		if (m_carry_len < unpack_ratio)
+			return 0;
+		m_fn(m_carry, unpack_ratio, out);
+		m_carry_len = 0;
+		n = 1;
+	}
+	size_t const bulk = len - len % unpack_ratio;
+	m_fn(in, bulk, out + n);
+	n += bulk / unpack_ratio;
+	m_carry_len = len - bulk;
+	memcpy(m_carry, in + bulk, m_carry_len);
+	return n;
+}
+
+}
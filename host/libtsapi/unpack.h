@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2023 TeraSense
+ * You may use, distribute and modify this code under the terms of the MIT license
+ *
+ * FX2 FIFO bit unpacking
+ *
+ * The controller words are sent one bit per 16 bit FIFO word, the data bit is the LSB
+ * of the even byte. The unpacking gathers these bits to the bytes of the bit stream,
+ * the first bit received is the MSB of the first byte. The stream is not aligned
+ * to the controller words, the frame decoder looks for the header at any bit position.
+ *
+ * The scalar kernel takes the bits one by one. The vector ones shift the data bit of
+ * every 16 bit lane to its sign, pack the lanes to bytes with signed saturation and
+ * gather the byte signs by movemask after reversing their order within each output byte.
+ * The AVX2 kernel is compiled for that target only and selected at run time.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace tsapi {
+
+// The FIFO bytes per output byte
+static constexpr size_t unpack_ratio = 16;
+
+// Unpack len FIFO bytes (multiple of unpack_ratio) to len / unpack_ratio bytes
+typedef void (*unpack_fn)(uint8_t const* in, size_t len, uint8_t* out);
+
+enum unpack_kernel {
+	unpack_scalar,
+	unpack_sse2,
+	unpack_avx2,
+	unpack_auto,  // the best one supported
+};
+
+// Returns NULL if the kernel is not supported by the CPU or the build
+unpack_fn unpack_select(unpack_kernel k = unpack_auto);
+
+const char* unpack_name(unpack_kernel k);
+
+// Unpacks the stream split onto buffers of any length
+class bit_unpacker {
+public:
+	explicit bit_unpacker(unpack_fn fn = unpack_select())
+		: m_fn(fn)
+	{
+	}
+
+	// Unpack the FIFO bytes to out having room for at least out_max(len) bytes.
+	// The bytes not making the whole output byte are kept till the next call. Returns
+	// the number of bytes output.
+	size_t feed(uint8_t const* in, size_t len, uint8_t* out);
+
+	void reset() { m_carry_len = 0; }
+
+	static size_t out_max(size_t len) { return len / unpack_ratio + 1; }
+
+private:
+	unpack_fn m_fn;
+	uint8_t   m_carry[unpack_ratio];
+	size_t    m_carry_len = 0;
+};
+
+}
@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2023 TeraSense
+ * You may use, distribute and modify this code under the terms of the MIT license
+ *
+ * FX2 FIFO bit unpacking benchmark
+ *
+ * Runs every unpacking kernel supported over the synthetic buffers (the simulated test
+ * frames stream and the random bytes) and the recorded FIFO data if given. Reports the
+ * speed in GB/s of the FIFO bytes and checks every kernel output matches the scalar one,
+ * the streaming unpacker is checked on the buffers split at random.
+ * The -w option writes the unpacked input file, unpack_check.py compares it with the
+ * Python reference decoder.
+ */
+
+#include "unpack.h"
+#include "sim_stream.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+using namespace tsapi;
+
+struct corpus {
+	std::string          name;
+	std::vector<uint8_t> data;
+};
+
+static bool load(const char* name, std::vector<uint8_t>& data)
+{
+	FILE* f = fopen(name, "rb");
+	if (!f) {
+		perror(name);
+		return false;
+	}
+	uint8_t buf[65536];
+	size_t n;
+	while ((n = fread(buf, 1, sizeof(buf), f)))
+		data.insert(data.end(), buf, buf + n);
+	fclose(f);
+	return true;
+}
+
+static bool save(const char* name, std::vector<uint8_t> const& data)
+{
+	FILE* f = fopen(name, "wb");
+	if (!f) {
+		perror(name);
+		return false;
+	}
+	bool const ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+	return !fclose(f) && ok;
+}
+
+// Unpack the data split at random by the streaming unpacker
+static std::vector<uint8_t> unpack_split(std::vector<uint8_t> const& data, std::mt19937& rnd)
+{
+	bit_unpacker u;
+	std::vector<uint8_t> out(bit_unpacker::out_max(data.size()));
+	size_t pos = 0, n = 0;
+	while (pos < data.size()) {
+		size_t const len = std::min<size_t>(data.size() - pos, rnd() % 4096);
+		n += u.feed(data.data() + pos, len, out.data() + n);
+		pos += len;
+	}
+	out.resize(n);
+	return out;
+}
+
+static int bench(corpus const& c, unsigned repeat, std::mt19937& rnd)
+{
+	size_t const len = c.data.size() - c.data.size() % unpack_ratio;
+	std::vector<uint8_t> ref(len / unpack_ratio), out(len / unpack_ratio);
+	int rc = 0;
+
+	unpack_select(unpack_scalar)(c.data.data(), len, ref.data());
+	for (unsigned k = unpack_scalar; k < unpack_auto; ++k) {
+		unpack_fn const fn = unpack_select(static_cast<unpack_kernel>(k));
+		if (!fn) {
+			printf("%-8s %-6s not supported\n", c.name.c_str(), unpack_name(static_cast<unpack_kernel>(k)));
+			continue;
+		}
+		memset(out.data(), 0, out.size());
+		auto const start = std::chrono::steady_clock::now();
+		for (unsigned i = 0; i < repeat; ++i)
+			fn(c.data.data(), len, out.data());
+		std::chrono::duration<double> const t = std::chrono::steady_clock::now() - start;
+		bool const ok = out == ref;
+		printf("%-8s %-6s %7.2f GB/s%s\n", c.name.c_str(), unpack_name(static_cast<unpack_kernel>(k)),
+			len * (double)repeat / 1e9 / t.count(), ok ? "" : " MISMATCH");
+		if (!ok)
+			rc = 1;
+	}
+	if (unpack_split(c.data, rnd) != ref) {
+		printf("%-8s streaming unpacker MISMATCH\n", c.name.c_str());
+		rc = 1;
+	}
+	return rc;
+}
+
+static void usage(const char* name)
+{
+	fprintf(stderr,
+		"Usage: %s [-f recorded_file] [-w unpacked_file] [-m synthetic_MB] [-n repeat]\n", name);
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<corpus> corpora;
+	const char* in_name = nullptr;
+	const char* out_name = nullptr;
+	size_t mb = 64;
+	unsigned repeat = 10;
+	std::mt19937 rnd(1);
+	int opt, rc = 0;
+
+	while ((opt = getopt(argc, argv, "f:w:m:n:h")) != -1) {
+		switch (opt) {
+		case 'f':
+			in_name = optarg;
+			break;
+		case 'w':
+			out_name = optarg;
+			break;
+		case 'm':
+			mb = atoi(optarg);
+			break;
+		case 'n':
+			repeat = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (out_name && !in_name) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (mb) {
+		corpus frames{"frames", std::vector<uint8_t>(mb << 20)};
+		sim_stream().fill(frames.data.data(), frames.data.size());
+		corpora.push_back(std::move(frames));
+		corpus random{"random", std::vector<uint8_t>(mb << 20)};
+		for (uint8_t& b : random.data)
+			b = rnd();
+		corpora.push_back(std::move(random));
+	}
+	if (in_name) {
+		corpus rec{"recorded", {}};
+		if (!load(in_name, rec.data))
+			return EXIT_FAILURE;
+		if (out_name) {
+			std::vector<uint8_t> out(bit_unpacker::out_max(rec.data.size()));
+			out.resize(bit_unpacker().feed(rec.data.data(), rec.data.size(), out.data()));
+			if (!save(out_name, out))
+				return EXIT_FAILURE;
+		}
+		corpora.push_back(std::move(rec));
+	}
+	for (corpus const& c : corpora)
+		rc |= bench(c, repeat, rnd);
+	return rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,62 @@
+#!/usr/bin/python3
+
+"""
+Copyright (C) 2023 TeraSense
+You may use, distribute and modify this code under the terms of the MIT license
+
+Checks the native FIFO bit unpacking against the Python reference
+
+Unpacks the random FIFO data and the recorded one if given by unpack_bench -w and
+compares the result with the bits taken by ts_stream.stream_decoder from the same
+data fed in chunks of random sizes. The native unpacker keeps the last even byte
+till the odd one following it is received so its output may be one byte shorter.
+
+Usage: unpack_check.py [recorded_file]
+"""
+
+import os
+import sys
+import random
+import tempfile
+import subprocess
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..'))
+from ts_stream import stream_decoder
+
+BENCH = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'unpack_bench')
+
+def reference(data, rnd):
+	"""The bits the stream decoder takes from the data as bytes"""
+	d, pos = stream_decoder(), 0
+	while pos < len(data):
+		n = rnd.randint(1, 4096)
+		d.take_bits(data[pos:pos + n])
+		pos += n
+	bits = d.bits[:len(d.bits) - len(d.bits) % 8]
+	return int(bits, 2).to_bytes(len(bits) // 8, 'big') if bits else b''
+
+def check(name, data, rnd):
+	with tempfile.TemporaryDirectory() as tmp:
+		fin, fout = os.path.join(tmp, 'in'), os.path.join(tmp, 'out')
+		with open(fin, 'wb') as f:
+			f.write(data)
+		subprocess.run([BENCH, '-m', '0', '-n', '1', '-f', fin, '-w', fout], check=True, stdout=subprocess.DEVNULL)
+		with open(fout, 'rb') as f:
+			out = f.read()
+	ref = reference(data, rnd)
+	ok = out == ref[:len(out)] and len(ref) - len(out) <= 1
+	print('%s: %u bytes %s' % (name, len(data), 'ok' if ok else 'MISMATCH'))
+	return ok
+
+def main():
+	rnd = random.Random(1)
+	ok = True
+	for size in (0, 1, 15, 16, 17, 31, 63, 64, 65, 4096 + 7, 1 << 20):
+		ok &= check('random', bytes(rnd.getrandbits(8) for _ in range(size)), rnd)
+	if len(sys.argv) > 1:
+		with open(sys.argv[1], 'rb') as f:
+			ok &= check(sys.argv[1], f.read(), rnd)
+	return 0 if ok else 1
+
+if __name__ == '__main__':
+	sys.exit(main())
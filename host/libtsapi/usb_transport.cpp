@@ -0,0 +1,158 @@
+#include "transport.h"
+
+#ifdef TSAPI_USB
+
+#include <libusb.h>
+
+namespace tsapi {
+
+static constexpr unsigned usb_timeout_ms = 1000;
+
+static std::string usb_error(const char* what, int rc)
+{
+	return std::string(what) + ": " + libusb_error_name(rc);
+}
+
+class usb_transport : public transport {
+public:
+	usb_transport(uint16_t vid, uint16_t pid, uint8_t ep)
+		: m_ep(ep)
+	{
+		int rc;
+		if ((rc = libusb_init(&m_ctx)))
+			throw error(usb_error("libusb init failed", rc));
+		if (!(m_dev = libusb_open_device_with_vid_pid(m_ctx, vid, pid))) {
+			libusb_exit(m_ctx);
+			throw error("FX2 FIFO device not found");
+		}
+		if ((rc = libusb_claim_interface(m_dev, 0))) {
+			libusb_close(m_dev);
+			libusb_exit(m_ctx);
+			throw error(usb_error("failed to claim FX2 FIFO interface", rc));
+		}
+	}
+
+	~usb_transport() override
+	{
+		cancel();
+		// The transfers may be freed only after their callbacks are called
+		while (m_in_flight)
+			if (libusb_handle_events(m_ctx))
+				break;
+		for (xfer* x : m_xfers) {
+			libusb_free_transfer(x->lt);
+			delete x;
+		}
+		libusb_release_interface(m_dev, 0);
+		libusb_close(m_dev);
+		libusb_exit(m_ctx);
+	}
+
+	void submit(transfer* t) override
+	{
+		xfer* x = static_cast<xfer*>(t->priv);
+		if (!x) {
+			x = new xfer{this, t, libusb_alloc_transfer(0), false};
+			if (!x->lt) {
+				delete x;
+				throw error("failed to allocate USB transfer");
+			}
+			m_xfers.push_back(x);
+			t->priv = x;
+		}
+		t->actual = 0;
+		libusb_fill_bulk_transfer(x->lt, m_dev, m_ep, t->data, static_cast<int>(t->size), on_complete, x, usb_timeout_ms);
+		int const rc = libusb_submit_transfer(x->lt);
+		if (rc)
+			throw error(usb_error("failed to submit USB transfer", rc));
+		x->in_flight = true;
+		++m_in_flight;
+	}
+
+	void wait(std::vector<transfer*>& done, int timeout_ms) override
+	{
+		if (m_done.empty()) {
+			timeval tv = {timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+			int const rc = libusb_handle_events_timeout_completed(m_ctx, &tv, nullptr);
+			if (rc && rc != LIBUSB_ERROR_INTERRUPTED)
+				throw error(usb_error("USB events handling failed", rc));
+		}
+		done.insert(done.end(), m_done.begin(), m_done.end());
+		m_done.clear();
+	}
+
+	void cancel() override
+	{
+		for (xfer* x : m_xfers)
+			if (x->in_flight)
+				libusb_cancel_transfer(x->lt);
+	}
+
+	std::string name() const override
+	{
+		return "FX2 FIFO";
+	}
+
+private:
+	struct xfer {
+		usb_transport*   self;
+		transfer*        t;
+		libusb_transfer* lt;
+		bool             in_flight;
+	};
+
+	// Called from libusb_handle_events() by the thread calling wait()
+	static void LIBUSB_CALL on_complete(libusb_transfer* lt)
+	{
+		xfer* const x = static_cast<xfer*>(lt->user_data);
+		transfer* const t = x->t;
+		t->actual = lt->actual_length;
+		switch (lt->status) {
+		case LIBUSB_TRANSFER_COMPLETED:
+			t->status = xfer_ok;
+			break;
+		case LIBUSB_TRANSFER_TIMED_OUT:
+			// The data received before the timeout is valid
+			t->status = t->actual ? xfer_ok : xfer_timeout;
+			break;
+		case LIBUSB_TRANSFER_CANCELLED:
+			t->status = xfer_cancelled;
+			break;
+		case LIBUSB_TRANSFER_NO_DEVICE:
+			t->status = xfer_gone;
+			break;
+		default:
+			t->status = xfer_error;
+		}
+		x->in_flight = false;
+		--x->self->m_in_flight;
+		x->self->m_done.push_back(t);
+	}
+
+	libusb_context*        m_ctx = nullptr;
+	libusb_device_handle*  m_dev = nullptr;
+	uint8_t                m_ep;
+	std::vector<xfer*>     m_xfers;
+	std::vector<transfer*> m_done;
+	unsigned               m_in_flight = 0;
+};
+
+std::unique_ptr<transport> usb_transport_open(uint16_t vid, uint16_t pid, uint8_t ep)
+{
+	return std::unique_ptr<transport>(new usb_transport(vid, pid, ep));
+}
+
+}
+
+#else
+
+namespace tsapi {
+
+std::unique_ptr<transport> usb_transport_open(uint16_t, uint16_t, uint8_t)
+{
+	throw error("built without libusb");
+}
+
+}
+
+#endif
@@ -0,0 +1,87 @@
+#include "validator.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <emmintrin.h>
+#define VALIDATOR_SSE2
+#endif
+
+namespace tsapi {
+
+validator::validator(size_t max_events)
+	: m_decoder(
+		[this](frame const& f) { on_frame(f); },
+		[this](uint64_t pos, uint64_t bits) { on_resync(pos, bits); })
+	, m_max_events(max_events)
+{
+}
+
+size_t validator::check_pattern(uint16_t const* payload, size_t len, uint16_t base)
+{
+	size_t i = 0;
+#ifdef VALIDATOR_SSE2
+	__m128i const step = _mm_set1_epi16(8);
+	__m128i expect = _mm_add_epi16(_mm_set1_epi16(base), _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7));
+	for (; i + 8 <= len; i += 8) {
+		__m128i const eq = _mm_cmpeq_epi16(_mm_loadu_si128((__m128i const*)(payload + i)), expect);
+		unsigned const m = _mm_movemask_epi8(eq);
+		if (m != 0xffff)
+			return i + __builtin_ctz(~m) / 2;
+		expect = _mm_add_epi16(expect, step);
+	}
+#endif
+	for (; i < len; ++i)
+		if (payload[i] != static_cast<uint16_t>(base + i))
+			return i;
+	return len;
+}
+
+void validator::event(validator_event::kind_t kind, uint64_t pos, uint32_t seq, uint64_t count)
+{
+	if (m_events.size() < m_max_events)
+		m_events.push_back(validator_event{kind, pos, seq, count});
+	m_stat.clean_run = 0;
+}
+
+void validator::on_resync(uint64_t pos, uint64_t bits)
+{
+	m_resync = true;
+	m_resync_pos = pos;
+	m_resync_bits = bits;
+}
+
+void validator::on_frame(frame const& f)
+{
+	++m_stat.frames;
+	// The stream is checked since the first frame after the test start
+	if (!m_started) {
+		// The data preceding it is not the resync
+		m_resync = false;
+		if (!(f.flags & ACQ_FL_START))
+			return;
+		m_started = true;
+	}
+	if (m_resync) {
+		++m_stat.resyncs;
+		event(validator_event::resync, m_resync_pos, f.seq, m_resync_bits);
+		m_resync = false;
+	}
+	if (!(f.flags & ACQ_FL_START) && f.seq != m_next_seq) {
+		++m_stat.gaps;
+		m_stat.missing += f.seq - m_next_seq;
+		event(validator_event::gap, f.pos, f.seq, f.seq - m_next_seq);
+	}
+	m_next_seq = f.seq + 1;
+	if (f.flags & ACQ_FL_TEST) {
+		++m_stat.test_frames;
+		size_t const bad = check_pattern(f.payload, f.len, static_cast<uint16_t>(f.seq * f.len));
+		if (bad != f.len) {
+			++m_stat.errors;
+			event(validator_event::pattern, f.pos, f.seq, bad);
+			return;
+		}
+	}
+	if (++m_stat.clean_run > m_stat.longest_run)
+		m_stat.longest_run = m_stat.clean_run;
+}
+
+}
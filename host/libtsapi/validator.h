@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2023 TeraSense
+ * You may use, distribute and modify this code under the terms of the MIT license
+ *
+ * FIFO test pattern validator
+ *
+ * Checks the stream the controller sends by :TEST:FIFO (see Src/test.c): the test frame
+ * payload is the incrementing words continuing from the previous frame so the frame seq
+ * payload starts from seq * len. The whole payload is compared with the expected counter
+ * block at once 8 words per SSE2 compare. The frame counter gaps, the test pattern errors
+ * and the decoder resyncs are recorded as events with the stream position.
+ */
+
+#pragma once
+
+#include "frame_decoder.h"
+
+namespace tsapi {
+
+struct validator_event {
+	enum kind_t {
+		gap,     // frames missing, count is their number
+		pattern, // the test pattern error, count is the index of the first bad word
+		resync,  // the decoder skipped count bits
+	} kind;
+	uint64_t pos;   // the stream bit position
+	uint32_t seq;   // the frame counter of the frame following the event
+	uint64_t count;
+};
+
+struct validator_stat {
+	uint64_t frames;
+	uint64_t test_frames;
+	uint64_t errors;      // the pattern errors
+	uint64_t gaps;
+	uint64_t missing;     // the frames missing in gaps
+	uint64_t resyncs;
+	uint64_t clean_run;   // the frames received since the last event
+	uint64_t longest_run; // the longest clean run
+};
+
+class validator {
+public:
+	// Up to max_events events are kept
+	explicit validator(size_t max_events = 1000);
+
+	// Decode and check the FIFO bytes
+	void feed(uint8_t const* data, size_t len) { m_decoder.feed(data, len); }
+
+	validator_stat const& stat() const { return m_stat; }
+	decoder_stat const& decoder() const { return m_decoder.stat(); }
+	std::vector<validator_event> const& events() const { return m_events; }
+
+	// Returns the index of the first payload word differing from the counter starting
+	// at base or len if they are all equal
+	static size_t check_pattern(uint16_t const* payload, size_t len, uint16_t base);
+
+private:
+	void on_frame(frame const& f);
+	void on_resync(uint64_t pos, uint64_t bits);
+	void event(validator_event::kind_t kind, uint64_t pos, uint32_t seq, uint64_t count);
+
+	frame_decoder                m_decoder;
+	size_t                       m_max_events;
+	std::vector<validator_event> m_events;
+	validator_stat               m_stat = {};
+	bool                         m_started = false;
+	uint32_t                     m_next_seq = 0;
+	// The resync is reported before the frame following it
+	bool                         m_resync = false;
+	uint64_t                     m_resync_pos = 0;
+	uint64_t                     m_resync_bits = 0;
+};
+
+}
@@ -7,37 +7,61 @@ Author: Oleg Volkov
 from serial import SerialException
 
 class ts_com_serial:
-	"""COM port communications helper"""
+	"""
+	COM port communications helper
+	The received data is buffered: every port read takes all the bytes pending
+	so the responses are parsed without the system call per byte.
+	"""
 
 	def __init__(self, com):
 		self.com = com
+		self.rx = bytearray()
 
 	def purge(self):
 		self.com.flushOutput()
 		self.com.flushInput()
+		self.rx.clear()
+
+	def _fill(self):
+		"""Read the bytes pending, at least one unless timed out. Returns the number of bytes read."""
+		s = self.com.read(max(1, self.com.in_waiting))
+		self.rx += s
+		return len(s)
+
+	def _take(self, sz, skip=0):
+		data = bytes(self.rx[:sz])
+		del self.rx[:sz + skip]
+		return data
 
 	def read(self, sz):
 		"""Read given amount of data"""
-		buff, sz_ = '', sz
 		zlimit = 2
+		while len(self.rx) < sz:
+			if self._fill():
+				continue
+			if self.rx:
+				raise SerialException("failed to read %d out of %d byte(s)" % (sz - len(self.rx), sz))
+			zlimit -= 1
+			if zlimit <= 0:
+				raise SerialException("failed to read %d byte(s)" % (sz,))
+		return self._take(sz)
+
+	def read_line(self, eol, max_sz):
+		"""Read data up to the eol byte, returns it without eol or None if it exceeds max_sz bytes"""
+		pos, zlimit = 0, 2
 		while True:
-			s = self.com.read(sz_)
-			read_sz = len(s)
-			if read_sz == sz:
-				return s
-			if not read_sz:
-				if sz_ == sz:
-					zlimit -= 1
-					if zlimit <= 0:
-						raise SerialException("failed to read %d byte(s)" % (sz_,))
-					else:
-						continue
-				else:
-					raise SerialException("failed to read %d out of %d byte(s)" % (sz_, sz))				
-			buff += s
-			sz_ -= read_sz
-			if not sz_:
-				return buff
+			i = self.rx.find(eol, pos)
+			if i >= 0:
+				return self._take(i, len(eol))
+			pos = len(self.rx)
+			if pos > max_sz:
+				return None
+			if self._fill():
+				zlimit = 2
+				continue
+			zlimit -= 1
+			if zlimit <= 0:
+				raise SerialException("failed to read line")
 
 	def write(self, data):
 		"""Write data"""
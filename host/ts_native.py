@@ -0,0 +1,71 @@
+"""
+Copyright (C) 2023 TeraSense
+You may use, distribute and modify this code under the terms of the MIT license
+
+Native FIFO stream reader and decoder
+
+Wraps the _tsapi extension module built by make python in libtsapi/. The decoder is the
+drop-in replacement of ts_stream.stream_decoder, the reader keeps many USB transfers in
+flight by the reader thread and decodes the data with the GIL released. The frames have
+the same attributes as the ts_stream ones, their payload is the memoryview of 16 bit words
+exported without copying, so numpy.frombuffer(f, numpy.uint16) gets the payload array.
+The available flag is False if the module is not built, the callers should fall back
+to ts_stream then.
+"""
+
+import os
+import sys
+
+import ts_stream
+
+sys.path.append(os.path.join(os.path.dirname(os.path.abspath(__file__)), 'libtsapi'))
+try:
+	import _tsapi
+except ImportError:
+	_tsapi = None
+
+available = _tsapi is not None
+
+def usb_supported():
+	"""Returns True if the native reader may open the FX2 FIFO device"""
+	return available and _tsapi.usb_supported()
+
+def _account(decoder, native_stat, frames):
+	"""Updates the ts_stream decoder statistics by the native decoder ones and the frames decoded"""
+	s = decoder.stat
+	s.crc_err, s.resyncs, s.skipped = native_stat['crc_err'], native_stat['resyncs'], native_stat['skipped']
+	for f in frames:
+		decoder._account(f.seq, f.ts, f.flags, f.rx_ts)
+	return frames
+
+class stream_decoder(ts_stream.stream_decoder):
+	"""Decodes the FIFO bytes by the native code, accounts the frames the same way as ts_stream does"""
+	def __init__(self):
+		super().__init__()
+		self.native = _tsapi.decoder()
+
+	def feed(self, data, rx_ts):
+		"""Returns the list of frames decoded from the data read at rx_ts microseconds"""
+		frames = self.native.feed(data, rx_ts)
+		return _account(self, self.native.stat(), frames)
+
+class fifo_reader:
+	"""
+	Reads the FX2 FIFO device or the simulated one (sim=True) by the native reader thread.
+	The keyword arguments are passed to _tsapi.reader: transfers, transfer_size, buffers,
+	sim_rate, sim_faults. The received data is decoded unless decode=False.
+	"""
+	def __init__(self, sim=False, decode=True, **kw):
+		self.decoder = ts_stream.stream_decoder()
+		self.native = _tsapi.reader(sim=sim, decode=decode, **kw)
+
+	def read(self, timeout=1.):
+		"""Returns the number of bytes read, 0 on timeout, and the list of frames decoded"""
+		nbytes, frames = self.native.read(timeout)
+		return nbytes, _account(self.decoder, self.native.stat(), frames)
+
+	def stat(self):
+		return self.native.stat()
+
+	def close(self):
+		self.native.close()
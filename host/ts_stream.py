@@ -0,0 +1,219 @@
+"""
+Copyright (C) 2023 TeraSense
+You may use, distribute and modify this code under the terms of the MIT license
+
+FX2 FIFO stream frame decoder
+
+The controller sends 16 bit words MSB first, FX2 samples them one bit per 16 bit FIFO word
+so the data bit is the LSB of every even byte read from the FIFO endpoint.
+The words are split onto frames with the header (see Inc/acq_core.h):
+  magic, version << 8 | flags, frame counter (2 words), microsecond timestamp (2 words),
+  payload length, configuration straps, ROI mask, averaging count,
+  CRC-16/CCITT of the preceding header words and the payload
+The acquisition frame payload is the samples of the channels selected by the ROI mask,
+see frame_channels() to rebuild the full set. The payload flagged by FL_RICE is delta + Rice
+coded (see Inc/rice.h), sample_decoder rebuilds the samples.
+The decoder looks for the magic at any bit position so it resynchronizes on the next
+header after losing bits as well as words.
+"""
+
+import binascii
+from collections import namedtuple
+
+MAGIC       = 0x5ac3
+VERSION     = 3
+HDR_LEN     = 11
+CHANNELS    = 8
+PAYLOAD_MAX = 4096
+
+FL_START    = 1
+FL_LOST     = 2
+FL_TEST     = 4
+FL_RICE     = 8
+FL_KEY      = 16
+
+RICE_ESC    = 12
+RICE_K_BITS = 4
+
+# The configuration straps
+CFG_CHAIN_MASK = 0x07
+CFG_WIDE       = 0x08
+CFG_MOD_SHIFT  = 4
+CFG_MOD_MASK   = 0x07 << CFG_MOD_SHIFT
+
+WORD_BITS   = 16
+MAGIC_BITS  = format(MAGIC, '016b')
+
+# The byte LSB as '0' / '1' character
+_BIT_CHARS = bytes(ord('0') + (b & 1) for b in range(256))
+
+frame = namedtuple('frame', 'seq ts flags cfg roi avg payload rx_ts')
+
+def frame_channels(f, channels=CHANNELS, samples=None):
+	"""
+	Returns the list of samples of all channels, None for the ones out of the ROI.
+	The samples of the compressed frame are the ones returned by sample_decoder.
+	"""
+	res, it = [], iter(f.payload if samples is None else samples)
+	for ch in range(channels):
+		res.append(next(it, None) if f.roi & (1 << ch) else None)
+	return res
+
+def rice_decode(words, prev):
+	"""
+	Returns the samples decoded from the delta + Rice coded words relative to the previous ones.
+	The unary codes are found by str.find() over the bit string rather than bit by bit.
+	"""
+	bits = ''.join(format(w, '016b') for w in words)
+	k, pos, res = int(bits[:RICE_K_BITS], 2), RICE_K_BITS, []
+	for p in prev:
+		q = bits.find('0', pos, pos + RICE_ESC) - pos
+		if q < 0:
+			u, n = 0, 16
+			pos += RICE_ESC
+		else:
+			u, n = q << k, k
+			pos += q + 1
+		if pos + n > len(bits):
+			raise ValueError('truncated payload')
+		if n:
+			u |= int(bits[pos:pos + n], 2)
+			pos += n
+		res.append((p + ((u >> 1) ^ -(u & 1))) & 0xffff)
+	if (pos + WORD_BITS - 1) // WORD_BITS != len(words):
+		raise ValueError('payload length mismatch')
+	return res
+
+class sample_decoder:
+	"""
+	Rebuilds the samples of the frames. The compressed frame depends on the previous one
+	unless it is the key frame so the ones following the frames lost are skipped till the
+	next key frame.
+	"""
+	def __init__(self):
+		self.prev     = None
+		self.next_seq = None
+		self.skipped  = 0
+
+	def samples(self, f):
+		"""Returns the samples of the channels in the ROI or None if they can't be decoded"""
+		s = None
+		if not f.flags & FL_RICE:
+			s = list(f.payload)
+		elif f.flags & FL_KEY:
+			s = rice_decode(f.payload, [0] * bin(f.roi).count('1'))
+		elif self.prev is not None and f.seq == self.next_seq:
+			s = rice_decode(f.payload, self.prev)
+		if s is None:
+			self.skipped += 1
+		self.prev, self.next_seq = s, (f.seq + 1) & 0xffffffff
+		return s
+
+def cfg_info(cfg):
+	"""Returns (modules chained, wide mode, module type) described by the configuration straps"""
+	return (cfg & CFG_CHAIN_MASK) + 1, bool(cfg & CFG_WIDE), (cfg & CFG_MOD_MASK) >> CFG_MOD_SHIFT
+
+def crc16(words, crc=0xffff):
+	return binascii.crc_hqx(b''.join(w.to_bytes(2, 'big') for w in words), crc)
+
+class stream_stat:
+	"""The stream statistics"""
+	def __init__(self):
+		self.frames   = 0
+		self.dropped  = 0  # frames missing according to the frame counter
+		self.overflow = 0  # frames flagged by the controller as following the dropped ones
+		self.crc_err  = 0
+		self.resyncs  = 0  # the times the stream was out of sync
+		self.skipped  = 0  # bits skipped while looking for the header
+		self.latency  = [] # microseconds, see stream_decoder.feed()
+
+	def percentile(self, p):
+		if not self.latency:
+			return 0
+		lat = sorted(self.latency)
+		return lat[min(len(lat) - 1, int(len(lat) * p / 100))]
+
+	def __str__(self):
+		return '%u frames, %u dropped (%u overflows), %u CRC errors, %u resyncs (%u bits skipped), latency p50 %u p99 %u max %u usec' % (
+			self.frames, self.dropped, self.overflow, self.crc_err, self.resyncs, self.skipped,
+			self.percentile(50), self.percentile(99), self.percentile(100)
+		)
+
+class stream_decoder:
+	"""Decodes the data read from the FIFO endpoint onto frames"""
+	def __init__(self):
+		self.bits    = ''
+		self.odd     = False # the next byte is the odd one
+		self.synced  = False
+		self.next_seq  = None
+		self.ts_offset = None # the minimal (rx_ts - ts) seen
+		self.ts_last   = None
+		self.ts_high   = 0    # the controller timestamp wraps
+		self.stat = stream_stat()
+
+	def take_bits(self, data):
+		"""Appends the data bits of the bytes read from the FIFO endpoint to the bit string"""
+		self.bits += bytes(data[1 if self.odd else 0::2]).translate(_BIT_CHARS).decode()
+		self.odd ^= len(data) & 1 != 0
+
+	def _words(self, pos, cnt):
+		return [int(self.bits[i:i+WORD_BITS], 2) for i in range(pos, pos + cnt * WORD_BITS, WORD_BITS)]
+
+	def _skip(self, nbits):
+		if not nbits:
+			return
+		if self.synced:
+			self.synced = False
+			self.stat.resyncs += 1
+		self.stat.skipped += nbits
+		self.bits = self.bits[nbits:]
+
+	def _account(self, seq, ts, flags, rx_ts):
+		s = self.stat
+		s.frames += 1
+		if flags & FL_LOST:
+			s.overflow += 1
+		if self.next_seq is not None and not (flags & FL_START):
+			s.dropped += (seq - self.next_seq) & 0xffffffff
+		self.next_seq = (seq + 1) & 0xffffffff
+		if self.ts_last is not None and ts < self.ts_last:
+			self.ts_high += 1 << 32
+		self.ts_last = ts
+		offset = rx_ts - (self.ts_high + ts)
+		if self.ts_offset is None or offset < self.ts_offset:
+			self.ts_offset = offset
+		s.latency.append(offset - self.ts_offset)
+
+	def feed(self, data, rx_ts):
+		"""
+		Generates frames decoded from the data read at rx_ts microseconds. The controller and host
+		clocks are not synchronized so the latency is accounted relative to the lowest one observed.
+		The clock drift is not compensated so it adds up over the long runs.
+		"""
+		self.take_bits(data)
+		while True:
+			pos = self.bits.find(MAGIC_BITS)
+			if pos < 0:
+				self._skip(max(0, len(self.bits) - WORD_BITS + 1))
+				return
+			if pos:
+				self._skip(pos)
+			if len(self.bits) < HDR_LEN * WORD_BITS:
+				return
+			hdr = self._words(0, HDR_LEN)
+			ln = hdr[6]
+			if hdr[1] >> 8 != VERSION or ln > PAYLOAD_MAX:
+				self._skip(1)
+				continue
+			if len(self.bits) < (HDR_LEN + ln) * WORD_BITS:
+				return
+			payload = self._words(HDR_LEN * WORD_BITS, ln)
+			if crc16(payload, crc16(hdr[:-1])) != hdr[-1]:
+				self.stat.crc_err += 1
+				self._skip(1)
+				continue
+			self.bits = self.bits[(HDR_LEN + ln) * WORD_BITS:]
+			self.synced = True
+			seq, ts, flags = hdr[2] | hdr[3] << 16, hdr[4] | hdr[5] << 16, hdr[1] & 0xff
+			self._account(seq, ts, flags, rx_ts)
+			yield frame(seq, ts, flags, hdr[7], hdr[8], hdr[9], payload, rx_ts)
@@ -12,12 +12,16 @@ import sys
 import time
 import serial
 import random
+import struct
 import usb.core
+import ts_native
 
+from array import array
 from serial.tools.list_ports import comports
 from ts_com_serial import ts_com_serial
+from ts_stream import stream_decoder, FL_START, FL_TEST
 from serial import SerialException
-from collections import namedtuple
+from collections import namedtuple, deque
 
 err_inv_args = 1
 err_port     = 254
@@ -59,6 +63,35 @@ class error(RuntimeError):
 comm_errors  = (SerialException, IOError)
 valid_errors = comm_errors + (error,)
 
+class cmd_future:
+	"""The response to the command sent by controller.submit()"""
+	def __init__(self, dev, cmd):
+		self.dev = dev
+		self.cmd = cmd
+		self.tx_ts = time.perf_counter()
+		self.rx_ts = None
+		self.resp = None
+		self.err = None
+
+	def resolve(self, resp, err=None):
+		self.rx_ts = time.perf_counter()
+		self.resp, self.err = resp, err
+
+	def done(self):
+		return self.rx_ts is not None
+
+	def result(self):
+		"""Returns the response receiving the ones preceding it if necessary, raises the command error"""
+		while not self.done():
+			self.dev.cmd_rx_next()
+		if self.err is not None:
+			raise self.err
+		return self.resp
+
+	def latency(self):
+		"""The time from sending the command till receiving the response, sec"""
+		return self.rx_ts - self.tx_ts
+
 class controller:
 	"""Controller interface implementation"""
 	vendor = b'TeraSense'
@@ -66,6 +99,8 @@ class controller:
 	timeout = 1.
 	eol = b'\r'
 	err_pref = b'#'
+	blk_tag = b'#'
+	evt_tag = b'!'
 	# error codes
 	err_ok          = 0
 	err_state       = 1
@@ -87,6 +122,7 @@ class controller:
 	}
 	max_req_size  = 0x1100
 	max_resp_size = 0x1100
+	max_blk_size  = 0x100000
 
 	@staticmethod
 	def get_err_text(code):
@@ -102,6 +138,8 @@ class controller:
 		self.sn      = None
 		self.ver_maj = None
 		self.ver_min = None
+		self.on_event = None
+		self.pending = deque()  # the futures of the commands in flight
 
 	def open_port(self, port):
 		com = serial.Serial(port,
@@ -115,6 +153,7 @@ class controller:
 		return True
 
 	def protocol_reset(self):
+		self.pending_fail(error(controller.err_proto, more_info='protocol reset'))
 		self.com.purge()
 		self.cmd_tx_request(b'-')
 		time.sleep(.1)
@@ -146,6 +185,7 @@ class controller:
 		return self.read_idn()
 
 	def close(self):
+		self.pending_fail(error(controller.err_proto, more_info='closed'))
 		if self.com:
 			self.com.disconnect()
 			self.com = None
@@ -189,30 +229,115 @@ class controller:
 		assert len(cmd) < controller.max_req_size
 		self.com.write(cmd + controller.eol)
 
+	def cmd_rx_block(self, digits):
+		"""Receive definite length arbitrary block content following the #<n> header"""
+		if not digits.isdigit():
+			raise error(controller.err_proto, more_info='bad block header')
+		sz = int(self.com.read(int(digits)))
+		if sz > controller.max_blk_size:
+			raise error(controller.err_proto, more_info='err resp too large')
+		data = self.com.read(sz) if sz else b''
+		if self.com.read(1) != controller.eol:
+			raise error(controller.err_proto, more_info='bad block tail')
+		return data
+
+	def rx_line(self, buff):
+		line = self.com.read_line(controller.eol, controller.max_resp_size - len(buff))
+		if line is None:
+			raise error(controller.err_proto, more_info='err resp too large')
+		return buff + line
+
+	def rx_event(self):
+		"""Receive the rest of unsolicited event line and pass it to the on_event callback"""
+		evt = self.rx_line(b'').decode()
+		if self.on_event:
+			self.on_event(evt)
+
+	def wait_event(self):
+		"""Wait for unsolicited event, returns False on timeout"""
+		assert self.is_open()
+		first = self.com.read(1)
+		if not first:
+			return False
+		if first != controller.evt_tag:
+			raise error(controller.err_proto, more_info='unexpected response')
+		self.rx_event()
+		return True
+
 	def cmd_rx_response(self):
 		assert self.is_open()
 		first = self.com.read(1)
+		while first == controller.evt_tag:
+			# events may precede the response
+			self.rx_event()
+			first = self.com.read(1)
 		if first == controller.eol:
 			return b''
 		if first == controller.err_pref:
-			msg = self.com.read(5)
+			second = self.com.read(1)
+			if first == controller.blk_tag and second != b'0':
+				return self.cmd_rx_block(second)
+			msg = second + self.com.read(4)
 			if msg[4:] != controller.eol:
 				raise error(controller.err_proto, more_info='err tail='+repr(msg[4:]))
 			raise error(int(msg[:4]), remote=True)
-		buff = first
-		while True:
-			c = self.com.read(1)
-			if c == controller.eol:
-				return buff
-			buff += c
-			if len(buff) > controller.max_resp_size:
-				raise error(controller.err_proto, more_info='err resp too large')
+		return self.rx_line(first)
+
+	def cmd_rx_next(self):
+		"""Receive the response to the oldest command in flight and resolve its future"""
+		f = self.pending.popleft()
+		try:
+			f.resolve(self.cmd_rx_response())
+		except error as e:
+			f.resolve(None, e)
+			if not e.is_remote():
+				# the responses to the rest can't be matched
+				self.pending_fail(e)
+				raise
+		except comm_errors as e:
+			f.resolve(None, e)
+			self.pending_fail(e)
+			raise
+
+	def pending_fail(self, e):
+		while self.pending:
+			self.pending.popleft().resolve(None, e)
+
+	def submit(self, *cmds):
+		"""
+		Send the commands back to back without waiting for the responses. Returns the list
+		of futures resolved in order as the responses are received.
+		"""
+		cmds = [cmd.encode() if isinstance(cmd, str) else cmd for cmd in cmds]
+		assert self.is_open()
+		assert all(len(cmd) < controller.max_req_size for cmd in cmds)
+		futures = [cmd_future(self, cmd) for cmd in cmds]
+		self.com.write(b''.join(cmd + controller.eol for cmd in cmds))
+		self.pending.extend(futures)
+		return futures
+
+	def send_many(self, cmds, depth=8):
+		"""
+		Send the commands keeping up to depth of them in flight. Returns the list of futures
+		all resolved, the remote errors are raised by their result().
+		"""
+		futures, i = [], 0
+		while i < len(cmds) or self.pending:
+			n = min(depth - len(self.pending), len(cmds) - i)
+			if n > 0:
+				futures += self.submit(*cmds[i:i + n])
+				i += n
+			self.cmd_rx_next()
+		return futures
 
 	def send_command(self, cmd):
-		if isinstance(cmd, str):
-			cmd = cmd.encode()
-		self.cmd_tx_request(cmd)
-		return self.cmd_rx_response()
+		f, = self.submit(cmd)
+		return f.result()
+
+def scpi_block(data):
+	"""Encode data as definite length arbitrary block"""
+	sz = b'%u' % len(data)
+	return b'#%u' % len(sz) + sz + data
 
 def random_str(sz):
 	codes = [ord(' ')] + [random.randrange(ord('a'), ord('z') + 1) for _ in range(sz-1)]
@@ -244,6 +369,33 @@ def echo_test(dev, echo_len = 0x1000):
 	if nbytes and elapsed:
 		print ('%u messages sent (%u bytes), %u bytes/sec' % (i, nbytes, nbytes / elapsed))
 
+def pipe_test(dev, depth, count, cmd_len):
+	"""
+	Measure the command rate keeping up to depth echo commands in flight.
+	Returns the commands/sec rate and the sorted list of latencies, sec.
+	"""
+	cmds = [b'TEST:ECHO' + random_str(random.randrange(1, cmd_len + 1)) for _ in range(count)]
+	started = time.perf_counter()
+	futures = dev.send_many(cmds, depth)
+	elapsed = time.perf_counter() - started
+	for i, f in enumerate(futures):
+		if f.result() != cmds[i][9:]:
+			raise error(controller.err_proto, more_info='invalid response to command #%d' % i)
+	return count / elapsed, sorted(f.latency() for f in futures)
+
+def percentile(vals, p):
+	return vals[min(len(vals) - 1, len(vals) * p // 100)]
+
+def do_pipe_test(args):
+	c = controller()
+	with c.connect_serial(args.port) as dev:
+		print ('Found', dev)
+		for depth in sorted(set(args.depth)):
+			rate, lat = pipe_test(dev, depth, args.count, args.length)
+			print ('depth %3u: %6u commands/sec, latency p50 %7.1f p99 %7.1f usec' % (
+				depth, rate, percentile(lat, 50) * 1e6, percentile(lat, 99) * 1e6))
+	return 0
+
 def do_echo_test(args):
 	c = controller()
 	with c.connect_serial(args.port) as dev:
@@ -271,6 +423,151 @@ def do_send(args):
 		print (dev.send_command(args.command).decode())
 	return 0
 
+def do_monitor(args):
+	c = controller()
+	with c.connect_serial(args.port) as dev:
+		dev.on_event = lambda evt: print(time.strftime('%H:%M:%S'), evt, flush=True)
+		if args.errors is not None:
+			dev.send_command(b':SYST:EVEN:ERRL %u' % args.errors)
+		dev.send_command(b':SYST:EVEN:ENAB 1')
+		try:
+			while True:
+				dev.wait_event()
+		except KeyboardInterrupt:
+			pass
+		finally:
+			dev.send_command(b':SYST:EVEN:ENAB 0')
+	return 0
+
+def do_stats(args):
+	c = controller()
+	with c.connect_serial(args.port) as dev:
+		if args.reset:
+			dev.send_command(b':SYST:STAT:RES')
+			return 0
+		clk = int(dev.send_command(b':SYST:STAT:CLOC?')) / 1e6
+		for line in dev.send_command(b':SYST:STAT:HIST?').decode().split('\n'):
+			if not line:
+				continue
+			name, cnt, max_cyc, hist = line.split(' ')
+			print ('%-12s %8s commands, max %.1f usec' % (name, cnt, int(max_cyc) / clk))
+			for i, h in enumerate(map(int, hist.split(','))):
+				if h:
+					print ('  < %10.1f usec %8u' % ((1 << i) / clk, h))
+	return 0
+
+# Vendor control requests giving access to the controller register map
+VND_REG_INFO  = 0x00
+VND_REG_READ  = 0x01
+VND_REG_WRITE = 0x02
+VND_REG_MAX   = 32
+VND_RD_TYPE   = 0xC0 # vendor, device to host
+VND_WR_TYPE   = 0x40 # vendor, host to device
+REG_WRITABLE  = 2
+
+def regs_info(dev):
+	"""Returns the list of (path, access flags) tuples of the registers"""
+	regs = []
+	while True:
+		try:
+			info = dev.ctrl_transfer(VND_RD_TYPE, VND_REG_INFO, len(regs), 0, 64)
+		except usb.core.USBError:
+			return regs
+		regs.append((bytes(info[1:]).decode(), info[0]))
+
+def regs_read(dev, first, cnt):
+	vals = []
+	while cnt:
+		n = min(cnt, VND_REG_MAX)
+		data = dev.ctrl_transfer(VND_RD_TYPE, VND_REG_READ, first, 0, 4 * n)
+		vals += struct.unpack('<%uI' % n, bytes(data))
+		first, cnt = first + n, cnt - n
+	return vals
+
+def do_regs(args):
+	dev = usb.core.find(idVendor=0x0483, idProduct=0x5740)
+	if dev is None:
+		print ('controller not found', file=sys.stderr)
+		return err_failure
+	regs = regs_info(dev)
+	if args.write:
+		reg, val = int(args.write[0], 0), int(args.write[1], 0)
+		if reg >= len(regs) or not (regs[reg][1] & REG_WRITABLE):
+			print ('register is not writable', file=sys.stderr)
+			return err_inv_args
+		dev.ctrl_transfer(VND_WR_TYPE, VND_REG_WRITE, reg, 0, struct.pack('<I', val))
+	for i, ((path, access), val) in enumerate(zip(regs, regs_read(dev, 0, len(regs)))):
+		print ('%2u %-2s %-28s %u' % (i, ('R' if access & 1 else '') + ('W' if access & 2 else ''), path, val))
+	return 0
+
+# Diagnostic stream records read from the vendor bulk IN endpoint
+DIAG_EP        = 0x83
+DIAG_TAG       = 0xA5
+DIAG_HDR       = struct.Struct('<BBHI') # tag, type, length, timestamp (msec)
+DIAG_REC_EVENT = 0
+DIAG_REC_FILL  = 1
+DIAG_REC_LOST  = 2
+DIAG_READ_SZ   = 4096
+
+def diag_records(dev, timeout=1000):
+	"""Generates (type, timestamp, data) tuples of the records received, None on read timeout"""
+	buf = b''
+	while True:
+		try:
+			buf += bytes(dev.read(DIAG_EP, DIAG_READ_SZ, timeout))
+		except usb.core.USBError:
+			yield None
+			continue
+		while len(buf) >= DIAG_HDR.size:
+			tag, typ, ln, ts = DIAG_HDR.unpack_from(buf)
+			if tag != DIAG_TAG:
+				# The stream was left unread in the middle of the record
+				buf = buf[1:]
+				continue
+			if len(buf) < DIAG_HDR.size + ln:
+				break
+			yield typ, ts, buf[DIAG_HDR.size:DIAG_HDR.size+ln]
+			buf = buf[DIAG_HDR.size+ln:]
+
+def diag_fill_test(dev, usb_dev, size):
+	dev.send_command(b':SYST:DIAG:FILL %u' % size)
+	received, start = 0, time.time()
+	for rec in diag_records(usb_dev):
+		if rec is None:
+			break
+		if rec[0] == DIAG_REC_FILL:
+			received += len(rec[2])
+			if received >= size:
+				break
+	elapsed = time.time() - start
+	print ('%u bytes received in %.3f sec, %.1f KB/sec' % (received, elapsed, received / elapsed / 1024))
+	return 0 if received >= size else err_failure
+
+def do_diag(args):
+	usb_dev = usb.core.find(idVendor=0x0483, idProduct=0x5740)
+	if usb_dev is None:
+		print ('controller not found', file=sys.stderr)
+		return err_failure
+	c = controller()
+	with c.connect_serial(args.port) as dev:
+		if args.fill:
+			return diag_fill_test(dev, usb_dev, args.fill)
+		dev.send_command(b':SYST:DIAG:TRAC 1')
+		try:
+			for rec in diag_records(usb_dev):
+				if rec is None:
+					continue
+				typ, ts, data = rec
+				if typ == DIAG_REC_EVENT:
+					print ('%10.3f event %u %u' % ((ts / 1000.,) + struct.unpack('<II', data)), flush=True)
+				elif typ == DIAG_REC_LOST:
+					print ('%10.3f lost %u records' % (ts / 1000., struct.unpack('<I', data)[0]), flush=True)
+		except KeyboardInterrupt:
+			pass
+		finally:
+			dev.send_command(b':SYST:DIAG:TRAC 0')
+	return 0
+
 def do_version(args):
 	c = controller()
 	with c.connect_serial(args.port) as dev:
@@ -293,20 +590,42 @@ def fx2_prog(dev, f):
 				if pg[0] != 0xc2:
 					print ('the firmware file is invalid', file=sys.stderr)
 					return err_failure
-			dev.send_command((b':SYST:FX2:EEPR:WR %u ' % addr) + b' '.join((b'%u' % b for b in pg)))
+			dev.send_command((b':SYST:FX2:EEPR:WRB %u ' % addr) + scpi_block(pg))
 			addr += pg_sz
 		time.sleep(.01)
 		return 0
 	finally:
 		dev.send_command(b':SYST:FX2:RES0')
 
+def do_fx2_dump(args):
+	c = controller()
+	with c.connect_serial(args.port) as dev:
+		data = dev.send_command(b':SYST:FX2:EEPR:DUMP?')
+		with open(args.file, 'wb') as f:
+			f.write(data)
+	return 0
+
 def do_fx2_prog(args):
 	c = controller()
 	with c.connect_serial(args.port) as dev:
 		with open(args.file, 'rb') as f:
 			return fx2_prog(dev, f)
 
-def fifo_open():
+def fifo_open(args):
+	"""
+	Returns the native FIFO reader if the _tsapi module is built with libusb,
+	the PyUSB device otherwise or if the Python data path is requested
+	"""
+	if args.sim:
+		if not ts_native.available:
+			print ('simulated FIFO needs the native module, run make python in libtsapi', file=sys.stderr)
+			return None
+		return ts_native.fifo_reader(sim=True, decode=not args.unchecked)
+	if ts_native.usb_supported() and not args.python:
+		try:
+			return ts_native.fifo_reader(decode=not args.unchecked)
+		except ts_native._tsapi.error as e:
+			print ('native FIFO reader: %s' % e, file=sys.stderr)
 	com = usb.core.find(idVendor=0x04B4, idProduct=0x4717)
 	if com is None:
 		print ('FIFO not found', file=sys.stderr)
@@ -315,78 +634,85 @@ def fifo_open():
 	return com
 
 def fifo_test(args, com, dev):
-	EP, BUF_SZ, WORD_BITS = 0x86, 4096, 16
-	WORD_MASK = (1<<WORD_BITS)-1
-	START_TAGS = [0x8dbe, 0x3ad6]
-	started, last_sn = 0, WORD_MASK if dev else None
-	next_bit, curr_word, byte_cnt = 0, 0, 0
-	buff_cnt = 0
+	EP, BUF_SZ = 0x86, 4096
+	byte_cnt, buff_cnt, started = 0, 0, dev is None
+	# The test pattern is compared with the slice of the counter wrapping around
+	ramp = memoryview(array('H', range(0x10000)) * 2)
+
+	if isinstance(com, ts_native.fifo_reader):
+		decoder, read = com.decoder, com.read
+	else:
+		decoder = ts_native.stream_decoder() if ts_native.available and not args.python else stream_decoder()
+
+		def read():
+			buf = com.read(EP, BUF_SZ)
+			if not buf or args.unchecked:
+				return len(buf), ()
+			return len(buf), decoder.feed(buf, time.monotonic() * 1e6)
 
 	if dev:
+		dev.send_command(':TEST:FIFO:STR %u' % args.stream)
 		dev.send_command(':TEST:FIFO:STAT START')
 	start_ts = time.time()
 
-	def check_word(w, verbose):
-		nonlocal started, last_sn
-		if dev and started < 2:
-			if time.time() - start_ts > 5:
-				print (' no start token', file=sys.stderr)
-				return False
-			if w == START_TAGS[started]:
-				started += 1
-			else:
-				started = 0
-			return True
-		if last_sn is None:
-			last_sn = w
+	def check_frame(f):
+		nonlocal started
+		if not started:
+			if not (f.flags & FL_START):
+				return True
+			started = True
+		if not (f.flags & FL_TEST):
 			return True
-		last_sn = (last_sn + 1) & WORD_MASK
-		if last_sn != w:
-			if verbose:
-				print ('bad sequence: {0:b}, {1:b}'.format(last_sn, w), file=sys.stderr)
-			return False
-		return True
+		sn = f.seq * len(f.payload) & 0xffff
+		expect = ramp[sn:sn + len(f.payload)]
+		return f.payload == (expect if isinstance(f.payload, memoryview) else expect.tolist())
 
 	try:
 		while True:
-			buf = com.read(EP, BUF_SZ)
-			if not buf:
+			errors = decoder.stat.crc_err + decoder.stat.resyncs + decoder.stat.dropped
+			nbytes, frames = read()
+			if not nbytes:
 				print (' no data', file=sys.stderr)
 				return err_failure
 			buff_cnt += 1
+			byte_cnt += nbytes
 			if args.unchecked:
-				byte_cnt += len(buf)
 				if not buff_cnt % 64:
 					print('*', end='', flush=True)
 				continue
 			print('.', end='', flush=True)
-			for b in buf:
-				byte_cnt += 1
-				if not (byte_cnt & 1):
-					continue
-				curr_word = (curr_word << 1) | (b & 1)
-				next_bit += 1
-				if next_bit >= WORD_BITS:
-					if not check_word(curr_word, not args.skip_errors):
-						if args.skip_errors:
-							print('!', end='', flush=True)
-						else:
-							return err_failure
-					curr_word, next_bit = 0, 0
+			if not started and time.time() - start_ts > 5:
+				print (' no start frame', file=sys.stderr)
+				return err_failure
+			for f in frames:
+				if not check_frame(f):
+					if not args.skip_errors:
+						print ('\nbad test pattern in frame %u' % f.seq, file=sys.stderr)
+						return err_failure
+					print('!', end='', flush=True)
+			if errors != decoder.stat.crc_err + decoder.stat.resyncs + decoder.stat.dropped:
+				if not args.skip_errors:
+					print ('\n%s' % decoder.stat, file=sys.stderr)
+					return err_failure
+				print('!', end='', flush=True)
 	except KeyboardInterrupt:
 		pass
 	finally:
 		if dev:
 			dev.send_command(':TEST:FIFO:STAT STOP')
+		if isinstance(com, ts_native.fifo_reader):
+			com.close()
 
 	print('\n%f MB/sec' % (byte_cnt / (1e6*(time.time() - start_ts))))
+	if not args.unchecked:
+		print(decoder.stat)
 	return 0
 
 def do_fifo_test(args):
 	c = controller()
 	with c.connect_serial(args.port) as dev:
 		print ('Found', dev)
-		com = fifo_open()
+		com = fifo_open(args)
 		if not com:
 			return err_failure
 		if args.unchecked:
@@ -394,7 +720,7 @@ def do_fifo_test(args):
 		fifo_test(args, com, dev)
 
 def do_fifo_read(args):
-	com = fifo_open()
+	com = fifo_open(args)
 	if not com:
 		return err_failure
 	if args.unchecked:
@@ -421,19 +747,45 @@ if __name__ == '__main__':
 	parser_echo_test = subparsers.add_parser('echo-test', help='run echo test')
 	parser_echo_test.set_defaults(func=do_echo_test)
 
+	parser_pipe_test = subparsers.add_parser('pipe-test', help='run echo test with several commands in flight, report command rate and latency')
+	parser_pipe_test.add_argument('-d', '--depth', help="the numbers of commands in flight (default 1 2 4 8 16)", type=int, nargs='+', default=[1, 2, 4, 8, 16])
+	parser_pipe_test.add_argument('-n', '--count', help="the number of commands to send (default 10000)", type=int, default=10000)
+	parser_pipe_test.add_argument('-l', '--length', help="max echo command length (default 32)", type=int, default=32)
+	parser_pipe_test.set_defaults(func=do_pipe_test)
+
 	parser_fifo_test = subparsers.add_parser('fifo-test', help='run FIFO test')
 	parser_fifo_test.add_argument('-i', '--skip-errors', help="don't abort on error", action='store_true')
 	parser_fifo_test.add_argument('-u', '--unchecked', help="don't check received data stream", action='store_true')
-	parser_fifo_test.set_defaults(func=do_fifo_test)
+	parser_fifo_test.add_argument('-s', '--stream', help="send continuous stream by circular DMA instead of bursts", action='store_true')
+	parser_fifo_test.add_argument('-P', '--python', help="use Python FIFO reader and decoder even if the native ones are built", action='store_true')
+	parser_fifo_test.set_defaults(func=do_fifo_test, sim=False)
 
 	parser_fifo_read = subparsers.add_parser('fifo-read', help='read FIFO continuously')
 	parser_fifo_read.add_argument('-i', '--skip-errors', help="don't abort on error", action='store_true')
 	parser_fifo_read.add_argument('-u', '--unchecked', help="don't check received data stream", action='store_true')
+	parser_fifo_read.add_argument('-P', '--python', help="use Python FIFO reader and decoder even if the native ones are built", action='store_true')
+	parser_fifo_read.add_argument('--sim', help="read simulated device by the native reader instead", action='store_true')
 	parser_fifo_read.set_defaults(func=do_fifo_read)
 
 	parser_term = subparsers.add_parser('terminal', help='interactive terminal')
 	parser_term.set_defaults(func=do_terminal)
 
+	parser_monitor = subparsers.add_parser('monitor', help='print controller events till interrupted')
+	parser_monitor.add_argument('-e', '--errors', help="report every given number of failed commands (0 - disable)", type=int, default=None)
+	parser_monitor.set_defaults(func=do_monitor)
+
+	parser_stats = subparsers.add_parser('stats', help='show command latency statistics')
+	parser_stats.add_argument('-r', '--reset', help="clear statistics", action='store_true')
+	parser_stats.set_defaults(func=do_stats)
+
+	parser_regs = subparsers.add_parser('regs', help='show controller registers read by vendor control requests')
+	parser_regs.add_argument('-w', '--write', nargs=2, metavar=('REG', 'VALUE'), help="write register before reading")
+	parser_regs.set_defaults(func=do_regs)
+
+	parser_diag = subparsers.add_parser('diag', help='print event trace received from the diagnostic stream endpoint till interrupted')
+	parser_diag.add_argument('-f', '--fill', type=int, metavar='BYTES', help="measure the diagnostic stream bandwidth instead")
+	parser_diag.set_defaults(func=do_diag)
+
 	parser_send = subparsers.add_parser('send', help='send command to controller')
 	parser_send.set_defaults(func=do_send)
 	parser_send.add_argument('command', help='command to send')
@@ -442,6 +794,10 @@ if __name__ == '__main__':
 	parser_send.set_defaults(func=do_fx2_prog)
 	parser_send.add_argument('file', help='firmware file to program')	
 
+	parser_dump = subparsers.add_parser('fx2-dump', help='save the content of the FX2 firmware EEPROM')
+	parser_dump.set_defaults(func=do_fx2_dump)
+	parser_dump.add_argument('file', help='file to save EEPROM content to')
+
 	args = parser.parse_args()
 	try:
 		res = args.func(args)
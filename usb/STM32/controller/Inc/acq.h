@@ -0,0 +1,11 @@
+#pragma once
+
+//
+// ADS8568 acquisition engine. The conversions are started by TIM3 at the programmed rate,
+// the results are read out over SPI2 by DMA and queued as frames (see acq_core.h) to be
+// sent to the FX2 FIFO.
+//
+
+struct scpi_node;
+
+extern const struct scpi_node acq_nodes[];
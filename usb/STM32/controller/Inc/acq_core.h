@@ -0,0 +1,150 @@
+#pragma once
+
+//
+// Acquisition data framing core. It is the portable code free of any hardware
+// dependencies so it may be built and checked on the host (see tools/acq_sim.c).
+//
+// The data sent to the FX2 FIFO is the stream of 16 bit words split onto frames.
+// Each frame starts with the ACQ_HDR_LEN words header:
+//   ACQ_MAGIC
+//   ACQ_VERSION << 8 | flags
+//   frame counter, low word first
+//   microsecond timestamp, low word first
+//   payload length in words
+//   the layout of the payload (see struct acq_layout): configuration, ROI mask, averaging count
+//   CRC-16/CCITT (0x1021, initial 0xffff) of the preceding header words and the payload,
+//   each word taken high byte first the same way it is sent
+// The frame counter is incremented for every frame built so the host can count the frames
+// dropped exactly. The receiver that lost the sync should look for the next ACQ_MAGIC.
+//
+// The ADC readout is ACQ_RAW_LEN bytes: the 16 bit two's complement samples of all
+// channels, big endian, channel 0 first. Each readout becomes the frame with payload of
+// the samples of the channels selected by the region of interest mask in the ascending
+// order. The host rebuilds the full set of channels from the ROI mask in the header. The
+// frame timestamp is the conversion start time. In the averaging mode the readouts are
+// summed and the frame of the rounded averages is built every avg readouts, its timestamp
+// is the one of the first readout. The frames are queued to the word ring buffer the FIFO
+// output engine takes them from.
+//
+// In the compressed mode the payload is delta + Rice coded (see rice.h) and flagged by
+// ACQ_FL_RICE unless the coded one is not shorter than the samples. The key frame flagged
+// by ACQ_FL_KEY is coded relative to zeros rather than the previous frame. It is the first
+// one, the one following the dropped frames and every ACQ_KEY_INTERVAL-th one so the host
+// recovers from the frames lost in transfer.
+//
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define ACQ_CHANNELS   8
+#define ACQ_CHAN_ALL   ((1 << ACQ_CHANNELS) - 1)
+#define ACQ_RAW_LEN    (2 * ACQ_CHANNELS)
+
+#define ACQ_MAGIC      0x5ac3
+#define ACQ_VERSION    3
+
+// The header words
+enum acq_hdr {
+	acq_hdr_magic,
+	acq_hdr_ver_flags,
+	acq_hdr_seq_lo,
+	acq_hdr_seq_hi,
+	acq_hdr_ts_lo,
+	acq_hdr_ts_hi,
+	acq_hdr_len,
+	acq_hdr_cfg,
+	acq_hdr_roi,
+	acq_hdr_avg,
+	acq_hdr_crc,
+	ACQ_HDR_LEN
+};
+
+// The header flags
+#define ACQ_FL_START   1 /* the first frame since start */
+#define ACQ_FL_LOST    2 /* the frames before this one were dropped due to the buffer overflow */
+#define ACQ_FL_TEST    4 /* the payload is the test pattern */
+#define ACQ_FL_RICE    8 /* the payload is compressed */
+#define ACQ_FL_KEY     16 /* the compressed payload does not depend on the previous frame */
+
+#define ACQ_KEY_INTERVAL 64
+
+#define ACQ_FRAME_MAX  (ACQ_HDR_LEN + ACQ_CHANNELS)
+
+// The max number of readouts averaged. The sum of 16 bit samples fits in 32 bits.
+#define ACQ_AVG_MAX    65535
+
+uint16_t acq_crc16(uint16_t crc, uint16_t const* data, unsigned len);
+
+// The payload layout description
+struct acq_layout {
+	uint16_t cfg; /* the detector configuration straps (see system.h), 0 for the test pattern */
+	uint16_t roi; /* the mask of the channels sent */
+	uint16_t avg; /* the number of readouts averaged */
+};
+
+// Fill the header of the frame with payload_len words following it. The layout may be NULL.
+void acq_hdr_build(uint16_t* frame, uint32_t seq, uint32_t ts, unsigned flags, struct acq_layout const* l, unsigned payload_len);
+
+struct acq_framer {
+	struct acq_layout layout;
+	uint16_t flags;   /* for the next frame */
+	uint32_t seq;
+	uint8_t  nchan;   /* the number of the channels selected */
+	uint8_t  chan[ACQ_CHANNELS]; /* and their list */
+	uint16_t avg_cnt; /* the number of readouts accumulated */
+	uint32_t avg_ts;  /* the timestamp of the first one */
+	int32_t  acc[ACQ_CHANNELS];
+	bool     compress;
+	uint16_t prev[ACQ_CHANNELS]; /* the previous frame payload for the delta coding */
+};
+
+void acq_framer_init(struct acq_framer* f, uint16_t cfg, uint16_t roi, uint16_t avg, bool compress);
+
+// The number of bytes of the ADC readout covering the channels selected
+unsigned acq_raw_len(uint16_t roi);
+
+// Add the ADC readout samples to the accumulators
+void acq_accum(int32_t* acc, uint8_t const* raw);
+
+// Get the rounded average of the accumulated sum
+static inline int16_t acq_avg(int32_t sum, unsigned n)
+{
+	return sum >= 0 ? (sum + (int32_t)(n / 2)) / (int32_t)n : -((-sum + (int32_t)(n / 2)) / (int32_t)n);
+}
+
+// The frame length in words
+unsigned acq_frame_len(uint16_t roi);
+
+// Build the frame from the ADC readout. Returns its length in words.
+unsigned acq_frame_build(struct acq_framer* f, uint8_t const* raw, uint32_t ts, uint16_t* out);
+
+// The single producer single consumer ring buffer of words. The producer and consumer
+// should not preempt each other.
+struct acq_ring {
+	uint16_t*         buff;
+	unsigned          size; /* must be power of 2 */
+	volatile unsigned head; /* free running positions */
+	volatile unsigned tail;
+	uint32_t          lost; /* frames dropped due to overflow */
+};
+
+void acq_ring_init(struct acq_ring* r, uint16_t* buff, unsigned size);
+
+// Queue the whole frame or drop it if there is no room
+bool acq_ring_put(struct acq_ring* r, uint16_t const* data, unsigned len);
+
+// Get up to max contiguous words queued. Returns their number.
+unsigned acq_ring_peek(struct acq_ring const* r, uint16_t const** data, unsigned max);
+
+// Release words taken by acq_ring_peek()
+void acq_ring_consume(struct acq_ring* r, unsigned len);
+
+static inline unsigned acq_ring_used(struct acq_ring const* r)
+{
+	return r->head - r->tail;
+}
+
+// Build the frame and queue it to the ring. The next frame is marked by ACQ_FL_LOST if it was dropped.
+// In the averaging mode the readout is accumulated and the frame is queued every avg readouts.
+// Returns true if the frame is queued.
+bool acq_frame_queue(struct acq_framer* f, struct acq_ring* r, uint8_t const* raw, uint32_t ts);
@@ -1,14 +1,44 @@
 #pragma once
 
 #include <stdint.h>
-#include <stdio.h>
+#include <stdbool.h>
 #include "errors.h"
 
 void cli_init(void);
+// Process data received over USB and arm the OUT endpoint for the next transfer.
+// If there is no room for it yet the reception will be resumed by cli_run().
 void cli_receive(uint8_t* Buf, uint32_t *Len);
 void cli_run(void);
 
+// The number of commands processed successfully and failed
+extern uint32_t cli_cmd_total;
+extern uint32_t cli_cmd_errors;
+
 err_t cli_put(char const* buff, unsigned sz);
+// The room available for the response data in the transmit buffer
+unsigned cli_tx_room(void);
+// Reserve space for sz bytes in the transmit buffer. Returns pointer to it or NULL if there is no room.
+char* cli_tx_alloc(unsigned sz);
+
+// Streamed response producer. It is called by cli_run() each time the previous
+// portion of the response is sent to put the next one. Returns positive value if
+// there is more data to come, zero on completion or negative error code.
+// The producer may put nothing while pending so it also serves the commands
+// completed asynchronously. It is polled then till the reply is ready.
+typedef int (*cli_producer_t)(void);
+
+// Called by command handler to continue the response by the producer. The error
+// returned by the producer after some data is sent follows that data so the host
+// will see broken response. The commands following in the queue are not processed
+// till the producer completes.
+void cli_stream(cli_producer_t producer);
 
-__PRINTFPR err_t cli_printf(const char* fmt, ...);
+// Formatters putting values straight to the transmit buffer
+err_t cli_put_str(char const* str);
+// Put decimal value padded with zeros to at least width digits (up to 10)
+err_t cli_put_u(uint32_t v, unsigned width);
+// Put the lowest width hexadecimal digits of the value
+err_t cli_put_hex(uint32_t v, unsigned width);
+// Put boolean value as 1 or 0
+err_t cli_put_bool(bool v);
 
@@ -3,5 +3,10 @@
 #include "errors.h"
 
 void  cli_parser_init(void);
-err_t cli_parse(const char* str, unsigned sz);
+struct scpi_node;
+
+// Parse command, the first top level node it matched is returned via top (NULL if none)
+err_t cli_parse(const char* str, unsigned sz, struct scpi_node const** top);
+// Find the node given its path
+struct scpi_node const* cli_find(const char* path, unsigned sz);
 
@@ -0,0 +1,49 @@
+#pragma once
+
+//
+// Diagnostic data stream. The records are queued to the ring buffer and sent to
+// the host over the dedicated vendor bulk IN endpoint so they never compete with
+// the command replies on the CDC data pipe. The endpoint is the byte stream of
+// records, each one starts with the struct diag_hdr followed by len bytes of data.
+// The records are dropped when the ring is full (the host is not reading).
+//
+
+#include "usbd_def.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#define DIAG_EP       0x83
+#define DIAG_EP_SIZE  64
+#define DIAG_TAG      0xA5
+// The max data length of the single record
+#define DIAG_REC_MAX  1024
+
+enum diag_rec_type {
+	diag_rec_event, /* event id, argument as 32 bit words, see events.h */
+	diag_rec_fill,  /* test pattern: the 32 bit counter followed by the incrementing bytes */
+	diag_rec_lost,  /* the number of records dropped since the previous one */
+};
+
+struct diag_hdr {
+	uint8_t  tag;  /* DIAG_TAG */
+	uint8_t  type; /* enum diag_rec_type */
+	uint16_t len;  /* data length */
+	uint32_t ts;   /* system tick, ms */
+};
+
+extern bool diag_trace;
+
+// Queue record. May be called from interrupt handler. Returns false if dropped.
+bool diag_put(enum diag_rec_type type, void const* data, unsigned len);
+
+// Endpoint open / close / transfer completion handlers called by the USB class
+void diag_open(USBD_HandleTypeDef* pdev);
+void diag_close(USBD_HandleTypeDef* pdev);
+void diag_data_in(USBD_HandleTypeDef* pdev);
+
+// Start transmission of the queued data and generate test records
+void diag_run(void);
+
+struct scpi_node;
+
+extern const struct scpi_node diag_nodes[];
@@ -0,0 +1,42 @@
+#pragma once
+
+//
+// Unsolicited event notifications. They are sent to the host between command
+// replies as separate lines starting with EVT_TAG so the host can tell them
+// apart from replies. The text reply starting with EVT_TAG is never sent, the
+// command gets the err_param error instead. Disabled by default.
+//
+
+#include "errors.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#define EVT_TAG '!'
+// The max length of the notification without terminator
+#define EVT_MAX_LEN 24
+
+enum evt_id {
+	evt_fifo_paused,  /* FIFO test stream paused since FX2 is full or not in HS mode */
+	evt_fifo_resumed, /* FIFO test stream resumed */
+	evt_hs_lost,      /* FX2 high speed link lost */
+	evt_hs_restored,  /* FX2 high speed link established */
+	evt_errors,       /* the number of command errors reached the multiple of evt_err_limit */
+	evt_lost,         /* the events lost due to the queue overflow */
+	evt_epm_failed,   /* EEPROM dump failed at the address given, the rest of the block is padded */
+};
+
+extern bool     evt_enabled;
+extern uint32_t evt_err_limit;
+
+// Post event with optional argument. May be called from interrupt handler.
+void evt_post(enum evt_id id, uint32_t arg);
+
+// Check if there are events to send
+bool evt_pending(void);
+
+// Put the oldest pending event to the response
+err_t evt_put_next(void);
+
+struct scpi_node;
+
+extern const struct scpi_node evt_nodes[];
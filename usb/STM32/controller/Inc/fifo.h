@@ -0,0 +1,43 @@
+#pragma once
+
+//
+// FX2 FIFO output engine. The data words are sent to FX2 over SPI1 by DMA either in
+// bursts limited by the FX2 FIFO flags or as the continuous stream by circular DMA
+// paused while FX2 is almost full. The data come from the source, only one source
+// may be active at a time.
+//
+
+#include <stdint.h>
+#include <stdbool.h>
+
+struct fifo_source {
+	// Called on start to begin the data from the beginning. May be NULL.
+	void     (*start)(void);
+	// Get up to max words to send. Returns the number of words available at *data, 0 if none.
+	// The data should remain valid till they are released by put().
+	unsigned (*get)(uint16_t const** data, unsigned max);
+	// Release the words returned by get() after they are sent. May be NULL.
+	void     (*put)(unsigned len);
+	// Fill the continuous stream buffer. NULL if the source does not support streaming.
+	void     (*fill)(uint16_t* buff, unsigned len);
+};
+
+// Start sending data from the source. The stream mode is used if the source supports it.
+// The current source is stopped first.
+void fifo_start(struct fifo_source const* src, bool stream);
+
+// Stop sending if the source is the current one
+void fifo_stop(struct fifo_source const* src);
+
+// Notify engine the source has more data. Should be called from interrupt
+// of the same priority as the SPI DMA or with interrupts disabled.
+void fifo_kick(void);
+
+// Check the source is active
+bool fifo_active(struct fifo_source const* src);
+
+// Get the current state of the source: STOPPED, STOPPING, PAUSED or RUNNING
+const char* fifo_state(struct fifo_source const* src);
+
+extern volatile bool fifo_paused;   /* paused waiting for FX2 */
+extern uint32_t      fifo_words;    /* the number of data words sent */
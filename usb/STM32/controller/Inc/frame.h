@@ -0,0 +1,75 @@
+#pragma once
+
+//
+// Binary framed control protocol. It is switched on by the text line FRAME_MODE_ESC,
+// the fixed length frames are expected then instead of the text commands till the
+// reset token (-\r at the frame boundary) switches back to the text mode. The partial
+// frame is abandoned if the rest of it is not received in FRAME_IDLE_TOUT msec so the
+// reset token following it is recognized. The event notifications are not sent in
+// the binary mode, they are held till switching back to the text mode.
+// The frame layout is compatible with the legacy 64 byte packet protocol:
+//   cmd    - command code, FRAME_RESP bit requests the reply frame
+//   sn     - serial number copied to the reply
+//   flags  - FRAME_SEQ bit for the commands in sequential mode, error code in reply
+//   status - FRAME_ST_xxx bits accumulated since the last reset (reply only)
+//   data   - FRAME_DATA_SZ bytes of command specific payload
+//   crc    - CRC16-CCITT of the preceding bytes, little endian
+// The commands in sequential mode are expected to have serial numbers incremented
+// by one. The sequence break is reported by FRAME_ST_SEQ status bit. The corrupted
+// frame is replied with err_proto regardless of FRAME_RESP bit so the host waiting
+// for the reply is not stalled, its header fields may be corrupted though.
+//
+
+#include "errors.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#define FRAME_MODE_ESC  "\x1b" "B"
+#define FRAME_IDLE_TOUT 20
+
+#define FRAME_LEN     64
+#define FRAME_HDR_SZ  4
+#define FRAME_CRC_SZ  2
+#define FRAME_DATA_SZ (FRAME_LEN - FRAME_HDR_SZ - FRAME_CRC_SZ)
+
+/* Header fields offsets */
+#define FRAME_CMD    0
+#define FRAME_SN     1
+#define FRAME_FLAGS  2
+#define FRAME_STATUS 3
+
+#define FRAME_RESP     0x80
+#define FRAME_CMD_MASK 0x7f
+#define FRAME_SEQ      0x80
+#define FRAME_ERR_MASK 0x7f
+
+/* Status bits */
+#define FRAME_ST_PROTO 1 /* corrupted or partial frame received */
+#define FRAME_ST_SEQ   2 /* sequence break */
+
+enum frame_cmd {
+	frame_info    = 0, /* returns vmaj, vmin, last sequential sn, the build date at offset 36 */
+	frame_reset   = 1, /* resets sequence, status and handles */
+	frame_scpi    = 2, /* len, text - executes SCPI command, returns len, reply text */
+	frame_resolve = 3, /* len, path - returns handle of the value node for typed access */
+	frame_get     = 4, /* handle - returns value as 32 bit little endian */
+	frame_set     = 5, /* handle, 32 bit little endian value */
+};
+
+static inline bool frame_need_reply(uint8_t const* f)
+{
+	return (f[FRAME_CMD] & FRAME_RESP) != 0;
+}
+
+struct scpi_node;
+
+// Process the frame received. The reply header is written to hdr located in the
+// transmit buffer, the reply payload is put to the transmit buffer after it.
+// The top level node of the SCPI command executed is returned via top.
+err_t frame_handle(uint8_t const* req, uint8_t* hdr, struct scpi_node const** top);
+
+// Report the partial frame abandoned
+void frame_abandoned(void);
+
+// Finalize reply frame given the payload length or the error code
+void frame_seal(uint8_t* f, unsigned len, err_t err);
@@ -0,0 +1,30 @@
+#pragma once
+
+//
+// Flat register map of the SCPI value nodes. It is built by walking the SCPI
+// tree so every node served by the generic value handlers gets the register
+// index in the order of the tree traversal. The registers are 32 bit wide.
+//
+
+#include "errors.h"
+#include <stdint.h>
+
+#define REGMAP_MAX 64
+
+struct scpi_tree;
+
+void regmap_init(struct scpi_tree const* tree);
+
+// The number of registers
+unsigned regmap_count(void);
+
+// Access flags SCPI_VAL_R / SCPI_VAL_W of the register
+unsigned regmap_access(unsigned i);
+
+// Returns zero for registers that can't be read
+uint32_t regmap_get(unsigned i);
+err_t    regmap_set(unsigned i, uint32_t v);
+
+// Put the register path like :SYSTem:FX2:RESet to the buffer.
+// Returns its length or 0 if it does not fit.
+unsigned regmap_path(unsigned i, char* buf, unsigned sz);
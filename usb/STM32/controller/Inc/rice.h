@@ -0,0 +1,30 @@
+#pragma once
+
+//
+// Delta + Rice codec of the sample frames. It is the portable code so the same
+// implementation is built on the host (see tools/rice_bench.c).
+//
+// Each sample is replaced by its difference from the same channel of the previous frame
+// (modulo 2^16). The differences are zigzag mapped to unsigned values and Rice coded with
+// the parameter k chosen per frame from their mean: the value u is sent as u >> k in unary
+// (ones terminated by zero) followed by k low bits of u. The values with the quotient of
+// RICE_ESC or more are sent as RICE_ESC ones followed by 16 bits of u. The frame bit stream
+// starts with RICE_K_BITS bits of k and is packed to 16 bit words MSB first, the last one
+// padded with zeros. The sample takes at most RICE_BITS_MAX bits so the time per frame is bounded.
+//
+
+#include <stdint.h>
+
+#define RICE_ESC      12
+#define RICE_K_BITS   4
+#define RICE_K_MAX    15
+#define RICE_BITS_MAX (RICE_ESC + 16)
+
+// Encode n samples to at most max words. The prev holds the previous frame samples,
+// it is updated with the current ones in any case. Returns the number of words written,
+// 0 if they do not fit.
+unsigned rice_encode(uint16_t* prev, uint16_t const* in, unsigned n, uint16_t* out, unsigned max);
+
+// Decode n samples from len words updating prev the same way. Returns the number of words
+// consumed, 0 if the data is invalid.
+unsigned rice_decode(uint16_t* prev, uint16_t const* in, unsigned len, uint16_t* out, unsigned n);
@@ -7,11 +7,16 @@
 
 #include "errors.h"
 #include <ctype.h>
+#include <stdint.h>
 #include <stdbool.h>
 
 #define SCPI_DELIM ';' 
+// IEEE 488.2 definite length arbitrary block tag: #<n><len><bytes>
+#define SCPI_BLOCK_TAG '#'
+#define SCPI_BLOCK_MAX_DIGITS 9
 
 struct scpi_node;
+struct scpi_index;
 
 // User supplied callback. Process input, returns number of bytes consumed or negative error code.
 typedef int (*scpi_handler_t)(const char* str, unsigned sz, struct scpi_node const*);
@@ -39,18 +44,53 @@ struct scpi_node {
 		void*           param2;
 		int             iparam2;
 	};
+	// The lookup index of the dir array generated by tools/scpi_index.py. Optional, may be NULL.
+	struct scpi_index const* index;
 };
 
 #define SCPI_NODE_END {NULL}
 
+// The trie node of the generated lookup index. The node 0 is the root.
+struct scpi_trie {
+	// Upper case character matched by this node
+	char                    ch;
+	// The index of the next node on the same level, 0 if none
+	uint8_t                 next;
+	// The index of the first node on the next level, 0 if none
+	uint8_t                 child;
+	// Bit mask of the dir entries having short or long name form ending at this node
+	uint32_t                accept;
+};
+
+// The lookup index of the particular dir array
+struct scpi_index {
+	// The number of entries in the dir array
+	unsigned                count;
+	// Space separated entry names used to validate the index against the dir array
+	const char*             names;
+	struct scpi_trie const* trie;
+};
+
 struct scpi_tree {
-	struct scpi_node const* star_nodes;
-	struct scpi_node const* colon_nodes;
-	unsigned                enabled;
+	struct scpi_node const*  star_nodes;
+	struct scpi_node const*  colon_nodes;
+	unsigned                 enabled;
+	struct scpi_index const* star_index;
+	struct scpi_index const* colon_index;
+	// Set by scpi_index_init() if all indexes match their dir arrays
+	bool                     indexed;
 };
 
-// Parse command given the arrays of root nodes for '*' and ':' heading hierarchy
-err_t scpi_parse(const char* str, unsigned sz, struct scpi_tree const* tree);
+// Validate lookup indexes against the tree. The parser falls back to linear lookup if they are stale.
+bool scpi_index_init(struct scpi_tree* tree);
+
+// Parse command given the arrays of root nodes for '*' and ':' heading hierarchy.
+// The first top level node matched is stored to the optional top pointer which
+// should be initialized by NULL.
+err_t scpi_parse(const char* str, unsigned sz, struct scpi_tree const* tree, struct scpi_node const** top);
+
+// Find the node given its path like SYST:EVEN:ENAB. Returns NULL if not found.
+struct scpi_node const* scpi_find(const char* str, unsigned sz, struct scpi_tree const* tree);
 
 // Enable nodes with corresponding bits set in hidden field
 static inline void scpi_enable(unsigned what, struct scpi_tree* tree)
@@ -89,6 +129,16 @@ static inline unsigned scpi_match(const char* str, unsigned sz, const char* name
 	return matched;
 }
 
+// Scan definite length arbitrary block #<n><len><bytes> optionally preceded by spaces.
+// On success the data pointer and length refer to the block content in the source buffer.
+// Returns the number of bytes consumed or negative error code.
+int scpi_scan_block(const char* str, unsigned sz, uint8_t const** data, unsigned* len);
+
+// Put data to the response as definite length arbitrary block
+err_t scpi_put_block(void const* data, unsigned len);
+// Put the block header only. The len bytes of data must follow, possibly streamed by cli_stream().
+err_t scpi_put_block_hdr(unsigned len);
+
 //
 // Generic value handlers
 //
@@ -114,3 +164,14 @@ typedef void(*bool_set_fn)(bool);
 int scpi_bool_rw_handler2(const char* str, unsigned sz, struct scpi_node const* n);
 int scpi_bool_r_handler2(const char* str, unsigned sz, struct scpi_node const* n);
 int scpi_bool_w_handler2(const char* str, unsigned sz, struct scpi_node const* n);
+
+//
+// Typed access to the values of the nodes served by the above generic handlers
+// bypassing text parsing and formatting. Returns err_cmd for other nodes.
+//
+#define SCPI_VAL_R 1
+#define SCPI_VAL_W 2
+// Returns the combination of the above bits for value nodes, 0 for other nodes
+unsigned scpi_value_access(struct scpi_node const* n);
+err_t scpi_value_get(struct scpi_node const* n, uint32_t* v);
+err_t scpi_value_set(struct scpi_node const* n, uint32_t v);
@@ -0,0 +1,25 @@
+/*
+ * SCPI node lookup indexes
+ * Generated by tools/scpi_index.py - do not edit
+ */
+
+#pragma once
+
+#include "scpi.h"
+
+// The number of nodes served by the generic value handlers
+#define SCPI_VALUE_NODES 22
+
+extern const struct scpi_index acq_compress_nodes_index;
+extern const struct scpi_index acq_nodes_index;
+extern const struct scpi_index colon_nodes_index;
+extern const struct scpi_index diag_nodes_index;
+extern const struct scpi_index evt_nodes_index;
+extern const struct scpi_index fx2_nodes_index;
+extern const struct scpi_index i2c_eeprom_nodes_index;
+extern const struct scpi_index reset_nodes_index;
+extern const struct scpi_index star_nodes_index;
+extern const struct scpi_index stat_nodes_index;
+extern const struct scpi_index system_nodes_index;
+extern const struct scpi_index test_fifo_nodes_index;
+extern const struct scpi_index test_nodes_index;
@@ -0,0 +1,28 @@
+#pragma once
+
+//
+// Command latency statistics. The time from the start of the command parsing
+// till its reply is queued for transmission is measured by the DWT cycle counter
+// and accounted in log2 histogram of the top level node the command starts with.
+//
+
+#include "stm32f4xx_hal.h"
+#include <stdint.h>
+
+// Histogram bucket i counts latencies in [2^(i-1), 2^i) cycles, the last one - all the rest
+#define STAT_BUCKETS 32
+
+// Enable the cycle counter
+void stat_init(void);
+
+static inline uint32_t stat_ts(void)
+{
+	return DWT->CYCCNT;
+}
+
+struct scpi_node;
+
+// Account command latency. The NULL node stands for the commands failed to match any.
+void stat_record(struct scpi_node const* top, uint32_t cycles);
+
+extern const struct scpi_node stat_nodes[];
@@ -55,6 +55,35 @@ static inline void u32_to_hex(uint32_t v, char buf[8])
 	u16_to_hex(v, buf + 4);
 }
 
+// Convert the lowest width digits of the value to hexadecimal representation
+static inline void u32_to_hex_w(uint32_t v, unsigned width, char* buf)
+{
+	while (width) {
+		buf[--width] = to_hex(v & 0xf);
+		v >>= 4;
+	}
+}
+
+#define U32_DEC_MAX 10
+
+// Convert value to decimal representation padded with zeros to the given width.
+// The buffer should have room for max(width, U32_DEC_MAX) characters.
+// Returns the number of characters stored.
+static inline unsigned u32_to_dec(uint32_t v, unsigned width, char* buf)
+{
+	char tmp[U32_DEC_MAX];
+	unsigned n = 0, i = 0;
+	do {
+		tmp[n++] = '0' + v % 10;
+		v /= 10;
+	} while (v);
+	for (; width > n; --width)
+		buf[i++] = '0';
+	while (n)
+		buf[i++] = tmp[--n];
+	return i;
+}
+
 // Read unsigned value from the buffer. The value may start from the radix prefix.
 // Returns the number of bytes consumed or 0 if buffer does not start with the number.
 static inline unsigned scan_u(const char* buf, unsigned len, uint32_t* val)
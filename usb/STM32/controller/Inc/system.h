@@ -1,10 +1,27 @@
 #pragma once
 
+#include "stm32f4xx_hal.h"
+#include <stdint.h>
+
 /* Early stage initialization routine */
 void sys_first_init(void);
 
 void sys_init(void);
 void sys_run(void);
 
+// The detector configuration straps read on startup
+#define SYS_CFG_CHAIN_MASK 0x07 /* CFG_CHAIN0..2 - the number of chained modules less one */
+#define SYS_CFG_WIDE       0x08 /* CFG_WIDE */
+#define SYS_CFG_MOD_SHIFT  4    /* CFG_MOD0..2 - the module type */
+#define SYS_CFG_MOD_MASK   (0x07 << SYS_CFG_MOD_SHIFT)
+
+extern uint16_t sys_cfg;
+
+// The free running microsecond clock
+static inline uint32_t sys_us(void)
+{
+	return TIM2->CNT;
+}
+
 void _sys_schedule_bootloader(void);
 void _sys_reset(void);
@@ -1,7 +1,6 @@
 #pragma once
 
 void test_init(void);
-void test_run(void);
 
 struct scpi_node;
 
@@ -0,0 +1,34 @@
+#pragma once
+
+//
+// Vendor specific control requests giving access to the register map (see regmap.h)
+// over the control endpoint bypassing the CDC command stream:
+//   VND_REG_INFO  IN,  wValue = register: access flags, path
+//   VND_REG_READ  IN,  wValue = first register, wLength = 4 * count: 32 bit little endian values
+//   VND_REG_WRITE OUT, wValue = first register, wLength = 4 * count: 32 bit little endian values
+// The requests may be addressed to device or interface. Invalid requests are stalled.
+// Writes are applied by usb_vendor_run() called from the main loop.
+//
+// The class also makes the device composite adding the vendor interface with the
+// diagnostic stream bulk IN endpoint (see diag.h) after the CDC interfaces.
+//
+
+#include "usbd_def.h"
+
+#define VND_REG_INFO  0x00
+#define VND_REG_READ  0x01
+#define VND_REG_WRITE 0x02
+
+/* The max number of registers accessed by single request */
+#define VND_REG_MAX   32
+
+// Extend the USBD_CDC class in place. Should be called before it is registered.
+void usb_vendor_init(void);
+
+// Re-plan the FIFO RAM giving the TX FIFO to the diagnostic stream endpoint. The generated
+// USBD_LL_Init() sizes the FIFOs for CDC only and the device is connected by USBD_Start()
+// right after, so the device is detached from the bus while the FIFOs are set up.
+void usb_vendor_fifo_init(USBD_HandleTypeDef* pdev);
+
+// Apply pending register writes
+void usb_vendor_run(void);
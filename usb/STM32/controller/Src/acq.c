@@ -0,0 +1,416 @@
+#include "acq.h"
+#include "acq_core.h"
+#include "rice.h"
+#include "fifo.h"
+#include "main.h"
+#include "io_util.h"
+#include "str_util.h"
+#include "scpi.h"
+#include "scpi_index.h"
+#include "cli.h"
+#include "debug.h"
+#include "util.h"
+#include "system.h"
+#include "stat.h"
+#include <string.h>
+
+#define hADC_SPI hspi2
+#define hADC_TIM htim3
+
+#define ACQ_RATE_MIN  1
+#define ACQ_RATE_MAX  50000
+#define ACQ_RATE_DEF  1000
+
+// The CONVST pulse width and the time from its leading edge till the conversion results are ready
+#define ADS_CONVST_NS 500
+#define ADS_CONV_NS   2000
+
+/* Must be power of 2 */
+#define ACQ_RING_LEN  4096
+
+BUILD_BUG_ON(ACQ_RING_LEN & (ACQ_RING_LEN - 1));
+
+extern SPI_HandleTypeDef hADC_SPI;
+extern TIM_HandleTypeDef hADC_TIM;
+
+static uint16_t          acq_buff[ACQ_RING_LEN];
+static struct acq_ring   acq_ring;
+static struct acq_framer acq_framer;
+static uint8_t           acq_raw[ACQ_RAW_LEN];
+static uint8_t           acq_sdi[ACQ_RAW_LEN]; /* zeros leave the ADS configuration intact */
+static unsigned          acq_raw_cnt; /* the readout length covering the channels selected */
+static uint32_t          acq_ts;
+static volatile bool     acq_on;
+
+static uint32_t acq_rate  = ACQ_RATE_DEF;
+static uint32_t acq_roi = ACQ_CHAN_ALL;
+static uint32_t acq_avg_n = 1;
+static bool     acq_compress;
+static uint32_t acq_frames;
+static uint32_t acq_overruns; /* conversions skipped since the previous readout was not completed */
+
+struct acq_limits {
+	uint32_t min;
+	uint32_t max;
+};
+
+static const struct acq_limits acq_rate_lim = {ACQ_RATE_MIN, ACQ_RATE_MAX};
+static const struct acq_limits acq_chan_lim = {1, ACQ_CHAN_ALL};
+static const struct acq_limits acq_avg_lim  = {1, ACQ_AVG_MAX};
+
+// The frames are queued by the SPI DMA interrupt and taken by the FIFO engine
+// on the interrupts of the same priority so they never preempt each other.
+
+// Called by the FIFO engine when it is ready to send. The previous transfer is completed
+// at this point so the ring may be safely reset.
+static void acq_src_start(void)
+{
+	acq_ring_init(&acq_ring, acq_buff, ACQ_RING_LEN);
+	acq_framer_init(&acq_framer, sys_cfg, acq_roi, acq_avg_n, acq_compress);
+}
+
+static unsigned acq_src_get(uint16_t const** data, unsigned max)
+{
+	return acq_ring_peek(&acq_ring, data, max);
+}
+
+static void acq_src_put(unsigned len)
+{
+	acq_ring_consume(&acq_ring, len);
+}
+
+static const struct fifo_source acq_src = {
+	.start = acq_src_start,
+	.get = acq_src_get,
+	.put = acq_src_put,
+};
+
+static uint32_t ns_to_ticks(uint32_t ns, uint32_t clk)
+{
+	uint32_t const t = ((uint64_t)ns * clk + 999999999) / 1000000000;
+	return t ? t : 1;
+}
+
+// Setup free running timer period and the compare events
+static void acq_tim_setup(void)
+{
+	// APB1 timers run at the doubled bus clock since APB1 is divided
+	uint32_t const clk   = 2 * HAL_RCC_GetPCLK1Freq();
+	uint32_t const ticks = clk / acq_rate;
+	uint32_t const psc   = (ticks - 1) / 0x10000;
+	uint32_t const cnt_clk = clk / (psc + 1);
+	TIM_TypeDef* const tim = hADC_TIM.Instance;
+
+	CLEAR_BIT(tim->CR1, TIM_CR1_OPM);
+	tim->PSC  = psc;
+	tim->ARR  = ticks / (psc + 1) - 1;
+	tim->CCR1 = ns_to_ticks(ADS_CONVST_NS, cnt_clk);
+	tim->CCR2 = ns_to_ticks(ADS_CONV_NS, cnt_clk);
+	tim->CNT  = 0;
+	// Load prescaler
+	tim->EGR  = TIM_EGR_UG;
+	__HAL_TIM_CLEAR_FLAG(&hADC_TIM, TIM_FLAG_UPDATE | TIM_FLAG_CC2);
+}
+
+static void acq_start(void)
+{
+	if (acq_on)
+		return;
+	acq_frames = acq_overruns = 0;
+	// The channels are read out in order so the ones after the last selected are skipped
+	acq_raw_cnt = acq_raw_len(acq_roi);
+	acq_tim_setup();
+	fifo_start(&acq_src, false);
+	acq_on = true;
+	HAL_TIM_OC_Start_IT(&hADC_TIM, TIM_CHANNEL_2);
+	HAL_TIM_PWM_Start(&hADC_TIM, TIM_CHANNEL_1);
+}
+
+static void acq_stop(void)
+{
+	if (!acq_on)
+		return;
+	HAL_TIM_PWM_Stop(&hADC_TIM, TIM_CHANNEL_1);
+	HAL_TIM_OC_Stop_IT(&hADC_TIM, TIM_CHANNEL_2);
+	acq_on = false;
+	fifo_stop(&acq_src);
+}
+
+// The conversion is completed, read it out
+void HAL_TIM_OC_DelayElapsedCallback(TIM_HandleTypeDef* htim)
+{
+	if (htim != &hADC_TIM || !acq_on)
+		return;
+	if (!fifo_active(&acq_src)) {
+		// FX2 FIFO is taken by the test
+		acq_stop();
+		return;
+	}
+	if (hADC_SPI.State != HAL_SPI_STATE_READY) {
+		++acq_overruns;
+		return;
+	}
+	// The conversion start time
+	acq_ts = sys_us() - ADS_CONV_NS / 1000;
+	WRITE_PIN(ADS_nFSYNC, 0);
+	HAL_SPI_TransmitReceive_DMA(&hADC_SPI, acq_sdi, acq_raw, acq_raw_cnt);
+}
+
+void HAL_SPI_TxRxCpltCallback(SPI_HandleTypeDef* hspi)
+{
+	if (hspi != &hADC_SPI)
+		return;
+	WRITE_PIN(ADS_nFSYNC, 1);
+	++acq_frames;
+	if (acq_frame_queue(&acq_framer, &acq_ring, acq_raw, acq_ts))
+		fifo_kick();
+}
+
+static bool acq_active_get(void)
+{
+	return acq_on;
+}
+
+static void acq_active_set(bool v)
+{
+	if (v)
+		acq_start();
+	else
+		acq_stop();
+}
+
+// The parameter value handler checking the range. The value can't be changed while running.
+static int acq_param_handler(const char* str, unsigned sz, struct scpi_node const* n)
+{
+	uint32_t val;
+	unsigned rc;
+	struct acq_limits const* lim = n->param2;
+
+	if (!sz)
+		return -err_cmd;
+	if (*str == '?')
+		return scpi_u32_r_handler(str, sz, n);
+
+	rc = scan_u(str, sz, &val);
+	if (!rc || val < lim->min || val > lim->max)
+		return -err_param;
+	if (acq_on)
+		return -err_state;
+	*(uint32_t*)n->param = val;
+	return rc;
+}
+
+// Parse the channel list like (@0:3,6) to the mask. Returns the number of chars consumed, 0 if invalid.
+static unsigned acq_roi_parse(const char* str, unsigned sz, uint32_t* roi)
+{
+	unsigned rc, pos = skip_spaces(str, sz);
+	bool const paren = PREFIX_MATCHED("(@", str + pos, sz - pos);
+	*roi = 0;
+	if (paren)
+		pos += STRZ_LEN("(@");
+	for (;;) {
+		uint32_t first, last;
+		if (!(rc = scan_u(str + pos, sz - pos, &first)))
+			return 0;
+		pos += rc;
+		last = first;
+		if (pos < sz && str[pos] == ':') {
+			++pos;
+			if (!(rc = scan_u(str + pos, sz - pos, &last)))
+				return 0;
+			pos += rc;
+		}
+		if (first > last || last >= ACQ_CHANNELS)
+			return 0;
+		for (; first <= last; ++first)
+			*roi |= 1 << first;
+		if (pos < sz && str[pos] == ',') {
+			++pos;
+			continue;
+		}
+		break;
+	}
+	if (paren) {
+		if (pos >= sz || str[pos] != ')')
+			return 0;
+		++pos;
+	}
+	return pos;
+}
+
+static err_t acq_roi_put(void)
+{
+	char buf[STRZ_LEN("(@)") + 4 * ACQ_CHANNELS];
+	unsigned first, ch = 0, n = 0;
+	buf[n++] = '(';
+	buf[n++] = '@';
+	for (; ch < ACQ_CHANNELS; ++ch) {
+		if (!(acq_roi & (1 << ch)))
+			continue;
+		for (first = ch; ch + 1 < ACQ_CHANNELS && (acq_roi & (1 << (ch + 1))); ++ch)
+			;
+		if (n > STRZ_LEN("(@"))
+			buf[n++] = ',';
+		n += u32_to_dec(first, 0, buf + n);
+		if (ch > first) {
+			buf[n++] = ':';
+			n += u32_to_dec(ch, 0, buf + n);
+		}
+	}
+	buf[n++] = ')';
+	return cli_put(buf, n);
+}
+
+static int acq_roi_handler(const char* str, unsigned sz, struct scpi_node const* n)
+{
+	uint32_t roi;
+	unsigned rc;
+
+	if (!sz)
+		return -err_cmd;
+	if (*str == '?') {
+		err_t err;
+		if (sz != 1)
+			return -err_cmd;
+		if ((err = acq_roi_put()))
+			return -err;
+		return sz;
+	}
+
+	if (!(rc = acq_roi_parse(str, sz, &roi)))
+		return -err_param;
+	if (acq_on)
+		return -err_state;
+	acq_roi = roi;
+	return rc;
+}
+
+#define ACQ_BENCH_FRAMES 1024
+
+// Code the synthetic frames of all channels: the random walk with steps up to +-8 LSB.
+// Puts the coded payload size in percents of the samples, the cycles per frame and
+// the coding speed in KB/s.
+static int acq_bench_handler(const char* str, unsigned sz, struct scpi_node const* n)
+{
+	uint16_t in[ACQ_CHANNELS], prev[ACQ_CHANNELS], out[ACQ_CHANNELS];
+	uint32_t rnd = 1, cycles = 0, words = 0;
+	unsigned i, ch;
+	err_t err;
+
+	if (sz != 1 || *str != '?')
+		return -err_cmd;
+	if (acq_on)
+		return -err_state;
+
+	for (ch = 0; ch < ACQ_CHANNELS; ++ch)
+		in[ch] = 1000 * ch;
+	for (i = 0; i < ACQ_BENCH_FRAMES; ++i) {
+		uint32_t t, len;
+		for (ch = 0; ch < ACQ_CHANNELS; ++ch) {
+			rnd = rnd * 1103515245 + 12345;
+			in[ch] += (int)((rnd >> 16) & 15) - 8;
+		}
+		if (!(i % ACQ_KEY_INTERVAL))
+			memset(prev, 0, sizeof(prev));
+		t = stat_ts();
+		len = rice_encode(prev, in, ACQ_CHANNELS, out, ACQ_CHANNELS - 1);
+		cycles += stat_ts() - t;
+		words += len ? len : ACQ_CHANNELS;
+	}
+	if (
+		(err = cli_put_u(words * 100 / (ACQ_BENCH_FRAMES * ACQ_CHANNELS), 0)) ||
+		(err = cli_put(" ", 1)) ||
+		(err = cli_put_u(cycles / ACQ_BENCH_FRAMES, 0)) ||
+		(err = cli_put(" ", 1)) ||
+		(err = cli_put_u((uint64_t)ACQ_BENCH_FRAMES * ACQ_RAW_LEN * (SystemCoreClock / 1000) / cycles, 0))
+	)
+		return -err;
+	return sz;
+}
+
+static const struct scpi_node acq_compress_nodes[] = {
+	{
+		"ENABle",
+		NULL,
+		scpi_bool_rw_handler,
+		"(0|1) disables|enables sending the delta + Rice coded frames since the next start. ENABle? returns the current setting.",
+		.param = &acq_compress
+	},
+	{
+		"BENChmark",
+		NULL,
+		acq_bench_handler,
+		"? codes the synthetic frames, returns the coded size in percents, the cycles per frame and the speed in KB/s"
+	},
+	SCPI_NODE_END
+};
+
+const struct scpi_node acq_nodes[] = {
+	{
+		"ACTive",
+		NULL,
+		scpi_bool_rw_handler2,
+		"(0|1) stops|starts acquisition. ACTive? returns 1 if it is started.",
+		.param  = (void*)acq_active_get,
+		.param2 = (void*)acq_active_set
+	},
+	{
+		"RATE",
+		NULL,
+		acq_param_handler,
+		" N sets the sampling rate in Hz (" xstr(ACQ_RATE_MIN) ".." xstr(ACQ_RATE_MAX) "). RATE? returns the current setting.",
+		.param  = &acq_rate,
+		.param2 = (void*)&acq_rate_lim
+	},
+	{
+		"CHANnels",
+		NULL,
+		acq_param_handler,
+		" MASK selects the channels to send (the region of interest), bit 0 is channel 0. CHANnels? returns the current setting.",
+		.param  = &acq_roi,
+		.param2 = (void*)&acq_chan_lim
+	},
+	{
+		"ROI",
+		NULL,
+		acq_roi_handler,
+		" (@0:3,6) selects the channels to send by the list of channels and ranges. ROI? returns the current setting."
+	},
+	{
+		"AVERage",
+		NULL,
+		acq_param_handler,
+		" N sends the frame of the samples averaged over N conversions (1.." xstr(ACQ_AVG_MAX) "). AVERage? returns the current setting.",
+		.param  = &acq_avg_n,
+		.param2 = (void*)&acq_avg_lim
+	},
+	{
+		"COMPress",
+		acq_compress_nodes,
+		NULL,
+		" controls the lossless compression of the frames by means of the following tags:",
+		.index = &acq_compress_nodes_index
+	},
+	{
+		"FRAMes",
+		NULL,
+		scpi_u32_r_handler,
+		"? returns the number of conversions since start",
+		.param = &acq_frames
+	},
+	{
+		"LOST",
+		NULL,
+		scpi_u32_r_handler,
+		"? returns the number of frames dropped since FX2 was not able to accept them",
+		.param = &acq_ring.lost
+	},
+	{
+		"OVERruns",
+		NULL,
+		scpi_u32_r_handler,
+		"? returns the number of conversions skipped since the readout was not completed in time",
+		.param = &acq_overruns
+	},
+	SCPI_NODE_END
+};
@@ -0,0 +1,224 @@
+#include "acq_core.h"
+#include "rice.h"
+#include <string.h>
+
+#ifdef __ICCARM__
+#include <intrinsics.h>
+#define rev16(w) __REV16(w)
+#else
+static inline uint32_t rev16(uint32_t w)
+{
+	return ((w & 0xff00ff00) >> 8) | ((w & 0x00ff00ff) << 8);
+}
+#endif
+
+static const uint16_t crc16_tab[256] = {
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+	0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
+	0x1231, 0x0210, 0x3273, 0x2252, 0x52b5, 0x4294, 0x72f7, 0x62d6,
+	0x9339, 0x8318, 0xb37b, 0xa35a, 0xd3bd, 0xc39c, 0xf3ff, 0xe3de,
+	0x2462, 0x3443, 0x0420, 0x1401, 0x64e6, 0x74c7, 0x44a4, 0x5485,
+	0xa56a, 0xb54b, 0x8528, 0x9509, 0xe5ee, 0xf5cf, 0xc5ac, 0xd58d,
+	0x3653, 0x2672, 0x1611, 0x0630, 0x76d7, 0x66f6, 0x5695, 0x46b4,
+	0xb75b, 0xa77a, 0x9719, 0x8738, 0xf7df, 0xe7fe, 0xd79d, 0xc7bc,
+	0x48c4, 0x58e5, 0x6886, 0x78a7, 0x0840, 0x1861, 0x2802, 0x3823,
+	0xc9cc, 0xd9ed, 0xe98e, 0xf9af, 0x8948, 0x9969, 0xa90a, 0xb92b,
+	0x5af5, 0x4ad4, 0x7ab7, 0x6a96, 0x1a71, 0x0a50, 0x3a33, 0x2a12,
+	0xdbfd, 0xcbdc, 0xfbbf, 0xeb9e, 0x9b79, 0x8b58, 0xbb3b, 0xab1a,
+	0x6ca6, 0x7c87, 0x4ce4, 0x5cc5, 0x2c22, 0x3c03, 0x0c60, 0x1c41,
+	0xedae, 0xfd8f, 0xcdec, 0xddcd, 0xad2a, 0xbd0b, 0x8d68, 0x9d49,
+	0x7e97, 0x6eb6, 0x5ed5, 0x4ef4, 0x3e13, 0x2e32, 0x1e51, 0x0e70,
+	0xff9f, 0xefbe, 0xdfdd, 0xcffc, 0xbf1b, 0xaf3a, 0x9f59, 0x8f78,
+	0x9188, 0x81a9, 0xb1ca, 0xa1eb, 0xd10c, 0xc12d, 0xf14e, 0xe16f,
+	0x1080, 0x00a1, 0x30c2, 0x20e3, 0x5004, 0x4025, 0x7046, 0x6067,
+	0x83b9, 0x9398, 0xa3fb, 0xb3da, 0xc33d, 0xd31c, 0xe37f, 0xf35e,
+	0x02b1, 0x1290, 0x22f3, 0x32d2, 0x4235, 0x5214, 0x6277, 0x7256,
+	0xb5ea, 0xa5cb, 0x95a8, 0x8589, 0xf56e, 0xe54f, 0xd52c, 0xc50d,
+	0x34e2, 0x24c3, 0x14a0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+	0xa7db, 0xb7fa, 0x8799, 0x97b8, 0xe75f, 0xf77e, 0xc71d, 0xd73c,
+	0x26d3, 0x36f2, 0x0691, 0x16b0, 0x6657, 0x7676, 0x4615, 0x5634,
+	0xd94c, 0xc96d, 0xf90e, 0xe92f, 0x99c8, 0x89e9, 0xb98a, 0xa9ab,
+	0x5844, 0x4865, 0x7806, 0x6827, 0x18c0, 0x08e1, 0x3882, 0x28a3,
+	0xcb7d, 0xdb5c, 0xeb3f, 0xfb1e, 0x8bf9, 0x9bd8, 0xabbb, 0xbb9a,
+	0x4a75, 0x5a54, 0x6a37, 0x7a16, 0x0af1, 0x1ad0, 0x2ab3, 0x3a92,
+	0xfd2e, 0xed0f, 0xdd6c, 0xcd4d, 0xbdaa, 0xad8b, 0x9de8, 0x8dc9,
+	0x7c26, 0x6c07, 0x5c64, 0x4c45, 0x3ca2, 0x2c83, 0x1ce0, 0x0cc1,
+	0xef1f, 0xff3e, 0xcf5d, 0xdf7c, 0xaf9b, 0xbfba, 0x8fd9, 0x9ff8,
+	0x6e17, 0x7e36, 0x4e55, 0x5e74, 0x2e93, 0x3eb2, 0x0ed1, 0x1ef0,
+};
+
+uint16_t acq_crc16(uint16_t crc, uint16_t const* data, unsigned len)
+{
+	for (; len; --len, ++data) {
+		crc = (crc << 8) ^ crc16_tab[(uint8_t)((crc >> 8) ^ (*data >> 8))];
+		crc = (crc << 8) ^ crc16_tab[(uint8_t)((crc >> 8) ^ *data)];
+	}
+	return crc;
+}
+
+void acq_hdr_build(uint16_t* frame, uint32_t seq, uint32_t ts, unsigned flags, struct acq_layout const* l, unsigned payload_len)
+{
+	frame[acq_hdr_magic]     = ACQ_MAGIC;
+	frame[acq_hdr_ver_flags] = (ACQ_VERSION << 8) | flags;
+	frame[acq_hdr_seq_lo]    = seq;
+	frame[acq_hdr_seq_hi]    = seq >> 16;
+	frame[acq_hdr_ts_lo]     = ts;
+	frame[acq_hdr_ts_hi]     = ts >> 16;
+	frame[acq_hdr_len]       = payload_len;
+	frame[acq_hdr_cfg]       = l ? l->cfg : 0;
+	frame[acq_hdr_roi]       = l ? l->roi : 0;
+	frame[acq_hdr_avg]       = l ? l->avg : 0;
+	frame[acq_hdr_crc]       = acq_crc16(acq_crc16(0xffff, frame, acq_hdr_crc), frame + ACQ_HDR_LEN, payload_len);
+}
+
+void acq_framer_init(struct acq_framer* f, uint16_t cfg, uint16_t roi, uint16_t avg, bool compress)
+{
+	unsigned ch;
+	f->layout.cfg = cfg;
+	f->layout.roi = roi & ACQ_CHAN_ALL;
+	f->layout.avg = avg ? avg : 1;
+	f->flags = ACQ_FL_START;
+	f->seq = 0;
+	f->avg_cnt = 0;
+	f->compress = compress;
+	f->nchan = 0;
+	for (ch = 0; ch < ACQ_CHANNELS; ++ch)
+		if (f->layout.roi & (1 << ch))
+			f->chan[f->nchan++] = ch;
+}
+
+unsigned acq_raw_len(uint16_t roi)
+{
+	unsigned n = 0;
+	for (roi &= ACQ_CHAN_ALL; roi; roi >>= 1)
+		n += 2;
+	return n;
+}
+
+unsigned acq_frame_len(uint16_t roi)
+{
+	unsigned n = ACQ_HDR_LEN;
+	for (roi &= ACQ_CHAN_ALL; roi; roi &= roi - 1)
+		++n;
+	return n;
+}
+
+// Replace the payload by the compressed one if it is shorter
+static unsigned acq_frame_compress(struct acq_framer* f, uint16_t* payload, unsigned n)
+{
+	uint16_t buff[ACQ_CHANNELS];
+	unsigned len;
+	if (!(f->seq % ACQ_KEY_INTERVAL) || (f->flags & (ACQ_FL_START|ACQ_FL_LOST))) {
+		memset(f->prev, 0, sizeof(f->prev));
+		f->flags |= ACQ_FL_KEY;
+	}
+	len = rice_encode(f->prev, payload, n, buff, n - 1);
+	if (!len)
+		return n;
+	memcpy(payload, buff, len * sizeof(*buff));
+	f->flags |= ACQ_FL_RICE;
+	return len;
+}
+
+static unsigned acq_frame_finish(struct acq_framer* f, uint32_t ts, uint16_t* out, unsigned n)
+{
+	if (f->compress && n > ACQ_HDR_LEN)
+		n = ACQ_HDR_LEN + acq_frame_compress(f, out + ACQ_HDR_LEN, n - ACQ_HDR_LEN);
+	acq_hdr_build(out, f->seq++, ts, f->flags, &f->layout, n - ACQ_HDR_LEN);
+	f->flags = 0;
+	return n;
+}
+
+unsigned acq_frame_build(struct acq_framer* f, uint8_t const* raw, uint32_t ts, uint16_t* out)
+{
+	unsigned i, n = ACQ_HDR_LEN;
+	for (i = 0; i < f->nchan; ++i) {
+		uint8_t const* s = raw + 2 * f->chan[i];
+		out[n++] = (s[0] << 8) | s[1];
+	}
+	return acq_frame_finish(f, ts, out, n);
+}
+
+// The pair of big endian samples is loaded as the single word, REV16 swaps the bytes
+// of both at once, the halfwords are then sign extended and added (SXTAH on Cortex-M4).
+// The SMLAD / SADD16 are of no use here since they sum across the halfwords or keep
+// 16 bit sums which would overflow.
+void acq_accum(int32_t* acc, uint8_t const* raw)
+{
+	unsigned ch;
+	for (ch = 0; ch < ACQ_CHANNELS; ch += 2, raw += 4) {
+		uint32_t w;
+		memcpy(&w, raw, sizeof(w));
+		w = rev16(w);
+		acc[ch]     += (int16_t)w;
+		acc[ch + 1] += (int32_t)w >> 16;
+	}
+}
+
+static unsigned acq_frame_build_avg(struct acq_framer* f, uint16_t* out)
+{
+	unsigned i, n = ACQ_HDR_LEN;
+	for (i = 0; i < f->nchan; ++i)
+		out[n++] = acq_avg(f->acc[f->chan[i]], f->layout.avg);
+	return acq_frame_finish(f, f->avg_ts, out, n);
+}
+
+void acq_ring_init(struct acq_ring* r, uint16_t* buff, unsigned size)
+{
+	r->buff = buff;
+	r->size = size;
+	r->head = r->tail = 0;
+	r->lost = 0;
+}
+
+bool acq_ring_put(struct acq_ring* r, uint16_t const* data, unsigned len)
+{
+	unsigned i, head = r->head;
+	if (r->size - (head - r->tail) < len) {
+		++r->lost;
+		return false;
+	}
+	for (i = 0; i < len; ++i, ++head)
+		r->buff[head & (r->size - 1)] = data[i];
+	r->head = head;
+	return true;
+}
+
+unsigned acq_ring_peek(struct acq_ring const* r, uint16_t const** data, unsigned max)
+{
+	unsigned const off = r->tail & (r->size - 1);
+	unsigned len = r->head - r->tail;
+	if (len > r->size - off)
+		len = r->size - off;
+	if (len > max)
+		len = max;
+	*data = r->buff + off;
+	return len;
+}
+
+void acq_ring_consume(struct acq_ring* r, unsigned len)
+{
+	r->tail += len;
+}
+
+bool acq_frame_queue(struct acq_framer* f, struct acq_ring* r, uint8_t const* raw, uint32_t ts)
+{
+	uint16_t frame[ACQ_FRAME_MAX];
+	unsigned len;
+	if (f->layout.avg > 1) {
+		if (!f->avg_cnt) {
+			f->avg_ts = ts;
+			memset(f->acc, 0, sizeof(f->acc));
+		}
+		acq_accum(f->acc, raw);
+		if (++f->avg_cnt < f->layout.avg)
+			return false;
+		f->avg_cnt = 0;
+		len = acq_frame_build_avg(f, frame);
+	} else
+		len = acq_frame_build(f, raw, ts, frame);
+	if (acq_ring_put(r, frame, len))
+		return true;
+	f->flags |= ACQ_FL_LOST;
+	return false;
+}
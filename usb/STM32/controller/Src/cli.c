@@ -1,10 +1,18 @@
 #include "main.h"
 #include "cli.h"
 #include "cli_parse.h"
+#include "scpi.h"
+#include "events.h"
+#include "stat.h"
+#include "frame.h"
+#include "usb_vendor.h"
+#include "diag.h"
 #include "usb_device.h"
 #include "usbd_cdc_if.h"
+#include "usbd_core.h"
+#include "debug.h"
+#include "str_util.h"
 #include <stdbool.h>
-#include <stdarg.h>
 
 #define RX_BUFF_SZ 0x1100
 #define TX_BUFF_SZ 0x1100
@@ -12,41 +20,135 @@
 #define CLI_EOL     "\r"
 #define CLI_EOL_CHR '\r'
 #define CLI_RST_CHR '-'
-#define CLI_ERR_FMT "#%04d"
+#define CLI_ERR_PREF   "#"
+#define CLI_ERR_DIGITS 4
 
-/* Receive context */
-static uint8_t  rx_buff[RX_BUFF_SZ+1];
-static unsigned rx_sz;
-static int      rx_cmd_sz;
+/* The number of completed commands that may wait for processing. Must be power of 2. */
+#define CLI_QUEUE_LEN 8
 
-/* Transmit context */
-static uint8_t  tx_buff[TX_BUFF_SZ+1];
-static unsigned tx_sz;
+/* The receive buffer has room for the next packet after the command of the max size */
+#define RX_PKT_SZ   CDC_DATA_FS_MAX_PACKET_SIZE
+#define RX_BUFF_LEN (RX_BUFF_SZ + RX_PKT_SZ)
+/* The max size of multi-packet OUT transfer */
+#define RX_XFER_MAX (16 * RX_PKT_SZ)
+
+/* Receive context. Completed commands are kept in rx_buff in the order of reception
+ * till processed. The command being received follows the last completed one. The OUT
+ * endpoint receives data in place right after it. The command is moved to the buffer
+ * start if there is no room for the next transfer at the buffer end. */
+static uint8_t  rx_buff[RX_BUFF_LEN];
+static unsigned rx_start; /* offset of the command being received */
+static unsigned rx_sz;    /* and the number of its bytes scanned so far */
+static unsigned rx_pend;  /* the number of received bytes following them not scanned yet */
+static err_t    rx_err;   /* the error receiving this command */
+
+/* The packet received to the driver buffer and not copied yet. It happens once after
+ * the interface initialization since the driver arms the OUT endpoint on its own. */
+static uint8_t const* rx_pkt;
+static unsigned       rx_pkt_len;
+/* Set if the OUT endpoint is not armed till we have room for the next packet */
+static volatile bool  rx_hold;
+
+/* Completed command descriptor */
+struct cli_cmd {
+	uint16_t off;
+	uint16_t sz;
+	uint8_t  err;   /* the error receiving command */
+	bool     flush; /* the reset token discarding preceding commands */
+	bool     frame; /* binary frame */
+};
+
+/* The queue of completed commands. The tail is advanced by the receive handler, the head by cli_run(). */
+static struct cli_cmd    rx_queue[CLI_QUEUE_LEN];
+static volatile unsigned rx_q_head;
+static volatile unsigned rx_q_tail;
+
+BUILD_BUG_ON(CLI_QUEUE_LEN & (CLI_QUEUE_LEN - 1));
+BUILD_BUG_ON(RX_BUFF_LEN > (uint16_t)~0);
+
+/* The received data scanner state. It tracks arbitrary blocks so the command
+ * terminator inside the block data is not taken for the end of command. */
+enum rx_scan_state {
+	rx_scan_text,
+	rx_scan_blk_tag,  /* block tag received */
+	rx_scan_blk_len,  /* receiving block length digits */
+	rx_scan_blk_data, /* receiving block data */
+	rx_scan_frame,    /* receiving binary frame */
+};
+
+enum rx_scan_res {
+	rx_scan_more,  /* command is not completed */
+	rx_scan_eol,   /* command completed */
+	rx_scan_reset, /* reset token received */
+	rx_scan_frame_end, /* binary frame completed */
+	rx_scan_bin,   /* binary mode escape received */
+};
 
-static err_t    cli_err;    // the error code
+struct rx_scanner {
+	uint8_t  st;
+	bool     rst; /* the last text character is the reset token */
+	bool     txt; /* text command is being received */
+	bool     bin; /* binary frames are expected instead of text commands */
+	uint8_t  esc; /* the number of the binary mode escape characters matched */
+	unsigned cnt; /* the number of length digits or data bytes remaining */
+	unsigned len;
+};
+
+static struct rx_scanner rx_scanner;
+/* The last data reception time to abandon the partial frame */
+static volatile uint32_t rx_last_ts;
+
+/* Transmit context. The reply is formatted in tx_buff while the other buffer
+ * may be sent by the USB core. */
+static uint8_t  tx_buffs[2][TX_BUFF_SZ+1];
+static uint8_t* tx_buff = tx_buffs[0];
+static unsigned tx_sz;
+static bool     tx_ready; /* tx_buff content is ready to be sent */
+/* The producer of the streamed response */
+static cli_producer_t tx_producer;
+/* The binary reply frame being formatted in tx_buff */
+static uint8_t*       tx_frame;
+/* Nothing of the text reply to the current command is sent yet */
+static bool           tx_first;
 
 /* Total number of successfully processed commands */
-static unsigned cmd_total;
+uint32_t cli_cmd_total;
+/* Total number of commands failed */
+uint32_t cli_cmd_errors;
+/* The command being processed start time and the top level node it matched */
+static uint32_t                cmd_start;
+static struct scpi_node const* cmd_top;
 
 static inline void tx_reset(void)
 {
 	tx_sz = 0;
 }
 
-static inline void rx_reset(void)
+static inline int usb_busy(void)
 {
-	rx_sz = 0;
-	rx_cmd_sz = 0;
-	cli_err = err_ok;
+	USBD_CDC_HandleTypeDef* hcdc = (USBD_CDC_HandleTypeDef*)hUsbDeviceFS.pClassData;
+	return !hcdc || hcdc->TxState != 0 || (USB_OTG_FS->GRSTCTL & USB_OTG_GRSTCTL_TXFFLSH);
 }
 
-static err_t cli_reply(void)
+// Send the buffer if the previous transmission is completed and switch to the other one
+static err_t cli_transmit(void)
 {
-	uint8_t const rc = CDC_Transmit_FS(tx_buff, tx_sz);
+	uint8_t rc;
+	if (usb_busy())
+		return err_ok;
+	rc = CDC_Transmit_FS(tx_buff, tx_sz);
+	tx_buff = tx_buff == tx_buffs[0] ? tx_buffs[1] : tx_buffs[0];
+	tx_ready = false;
 	tx_reset();
 	return rc == USBD_OK ? err_ok : err_internal;
 }
 
+static err_t cli_reply(void)
+{
+	tx_ready = true;
+	return cli_transmit();
+}
+
 err_t cli_put(char const* buff, unsigned sz)
 {
 	if (tx_sz + sz > TX_BUFF_SZ)
@@ -56,20 +158,54 @@ err_t cli_put(char const* buff, unsigned sz)
 	return err_ok;
 }
 
-__PRINTFPR err_t cli_printf(const char* fmt, ...)
+unsigned cli_tx_room(void)
+{
+	// Reserve space for the terminator
+	return TX_BUFF_SZ - 1 - tx_sz;
+}
+
+void cli_stream(cli_producer_t producer)
 {
-	int res;
-	int space = TX_BUFF_SZ - tx_sz;
-	va_list args;
-	va_start(args, fmt);
-	res = vsnprintf((char*)tx_buff + tx_sz, space, fmt, args);
-	va_end(args);
-	if (res < 0 || res > space)
+	tx_producer = producer;
+}
+
+char* cli_tx_alloc(unsigned sz)
+{
+	char* ptr;
+	if (tx_sz + sz > TX_BUFF_SZ)
+		return NULL;
+	ptr = (char*)tx_buff + tx_sz;
+	tx_sz += sz;
+	return ptr;
+}
+
+err_t cli_put_str(char const* str)
+{
+	return cli_put(str, strlen(str));
+}
+
+err_t cli_put_u(uint32_t v, unsigned width)
+{
+	char buf[U32_DEC_MAX];
+	if (width > U32_DEC_MAX)
+		return err_internal;
+	return cli_put(buf, u32_to_dec(v, width, buf));
+}
+
+err_t cli_put_hex(uint32_t v, unsigned width)
+{
+	char* const ptr = cli_tx_alloc(width);
+	if (!ptr)
 		return err_internal;
-	tx_sz += res;
+	u32_to_hex_w(v, width, ptr);
 	return err_ok;
 }
 
+err_t cli_put_bool(bool v)
+{
+	return cli_put(v ? "1" : "0", 1);
+}
+
 static err_t cli_eol(void)
 {
 	if (tx_sz < TX_BUFF_SZ) {
@@ -82,25 +218,92 @@ static err_t cli_eol(void)
 	}
 }
 
+// Complete the reply frame. It is dropped if the reply was not requested.
+static err_t cli_frame_reply(err_t err)
+{
+	uint8_t* const f = tx_frame;
+	unsigned const off = f - tx_buff;
+	tx_frame = NULL;
+	if (!err && tx_sz - off > FRAME_LEN - FRAME_CRC_SZ)
+		// The reply does not fit the frame
+		err = err_internal;
+	if (err)
+		tx_sz = off + FRAME_HDR_SZ;
+	if (!frame_need_reply(f)) {
+		tx_sz = off;
+		return err_ok;
+	}
+	memset(tx_buff + tx_sz, 0, off + FRAME_LEN - FRAME_CRC_SZ - tx_sz);
+	frame_seal(f, tx_sz - off - FRAME_HDR_SZ, err);
+	tx_sz = off + FRAME_LEN;
+	return cli_reply();
+}
+
+// Send the portion of the text reply. The reply starting with EVT_TAG is rejected
+// since the host would take it for the event notification.
+static err_t cli_text_reply(void)
+{
+	if (!tx_sz)
+		return err_ok;
+	if (tx_first && tx_buff[0] == EVT_TAG)
+		return err_param;
+	tx_first = false;
+	return cli_reply();
+}
+
 static err_t cli_respond_err(err_t res)
 {
+	if (tx_frame)
+		return cli_frame_reply(res);
 	tx_reset();
-	cli_printf(CLI_ERR_FMT CLI_EOL, res);
+	cli_put(CLI_ERR_PREF, STRZ_LEN(CLI_ERR_PREF));
+	cli_put_u(res, CLI_ERR_DIGITS);
+	cli_eol();
 	return cli_reply();
 }
 
-static err_t cli_handle_input(unsigned sz)
+static err_t cli_handle_frame(uint8_t const* req)
 {
 	err_t err;
-	if (!sz)
+	if (!(tx_frame = (uint8_t*)cli_tx_alloc(FRAME_HDR_SZ)))
 		return err_internal;
-	if (
-		(err = cli_parse((const char*)rx_buff, sz - 1)) ||
-		(err = cli_eol())
-	)
+	if ((err = frame_handle(req, tx_frame, &cmd_top)))
 		return err;
+	return tx_producer ? err_ok : cli_frame_reply(err_ok);
+}
 
-	return cli_reply();
+static err_t cli_handle_input(struct cli_cmd const* cmd)
+{
+	err_t err;
+	if (!cmd->sz)
+		return err_internal;
+	if (cmd->frame)
+		return cli_handle_frame(rx_buff + cmd->off);
+	if ((err = cli_parse((const char*)rx_buff + cmd->off, cmd->sz - 1, &cmd_top)))
+		return err;
+	if (!tx_producer && (err = cli_eol()))
+		return err;
+
+	return cli_text_reply();
+}
+
+// Put the next portion of the streamed response
+static err_t cli_stream_next(void)
+{
+	err_t err;
+	int const res = tx_producer();
+	if (res < 0)
+		return (err_t)-res;
+	if (!res) {
+		tx_producer = NULL;
+		if (tx_frame)
+			return cli_frame_reply(err_ok);
+		if ((err = cli_eol()))
+			return err;
+	} else if (tx_frame)
+		// The frame is sent once completed so the producer can't be continued if it does not fit
+		return tx_sz - (tx_frame - tx_buff) > FRAME_LEN - FRAME_CRC_SZ ? err_internal : err_ok;
+	return cli_text_reply();
 }
 
 static inline int usb_connected(void)
@@ -108,94 +311,358 @@ static inline int usb_connected(void)
 	return hUsbDeviceFS.dev_state == USBD_STATE_CONFIGURED;
 }
 
-static inline int usb_busy(void)
+// Scan received data till the end of command. Returns the scan result for the last byte scanned.
+static enum rx_scan_res rx_scan(struct rx_scanner* sc, uint8_t const* buf, unsigned len, unsigned* used)
 {
-	USBD_CDC_HandleTypeDef* hcdc = (USBD_CDC_HandleTypeDef*)hUsbDeviceFS.pClassData;
-	return !hcdc || hcdc->TxState != 0 || (USB_OTG_FS->GRSTCTL & USB_OTG_GRSTCTL_TXFFLSH);
+	unsigned i = 0;
+	while (i < len) {
+		uint8_t const c = buf[i];
+		switch (sc->st) {
+		case rx_scan_frame:
+		case rx_scan_blk_data: {
+			unsigned const n = len - i < sc->cnt ? len - i : sc->cnt;
+			i += n;
+			if ((sc->cnt -= n))
+				continue;
+			if (sc->st == rx_scan_frame) {
+				sc->st = rx_scan_text;
+				*used = i;
+				return rx_scan_frame_end;
+			}
+			sc->st  = rx_scan_text;
+			sc->rst = false;
+			continue;
+		}
+		case rx_scan_blk_tag:
+			if ('1' <= c && c <= '9') {
+				sc->st  = rx_scan_blk_len;
+				sc->cnt = c - '0';
+				sc->len = 0;
+				++i;
+				continue;
+			}
+			break;
+		case rx_scan_blk_len:
+			if ('0' <= c && c <= '9') {
+				sc->len = sc->len * 10 + c - '0';
+				if (!--sc->cnt) {
+					sc->cnt = sc->len;
+					sc->st  = sc->len ? rx_scan_blk_data : rx_scan_text;
+				}
+				++i;
+				continue;
+			}
+			break;
+		default:
+			// The only text expected in binary mode is the reset token at the frame boundary
+			if (sc->bin && (sc->txt ? c != CLI_EOL_CHR : c != CLI_RST_CHR)) {
+				sc->st  = rx_scan_frame;
+				sc->cnt = FRAME_LEN - 1 - sc->txt;
+				sc->txt = false;
+				sc->rst = false;
+				++i;
+				continue;
+			}
+		}
+		// Text character
+		++i;
+		sc->txt = true;
+		if (c == CLI_EOL_CHR) {
+			bool const rst = sc->rst;
+			bool const esc = sc->esc == STRZ_LEN(FRAME_MODE_ESC);
+			sc->st  = rx_scan_text;
+			sc->rst = false;
+			sc->txt = false;
+			sc->esc = 0;
+			*used = i;
+			if (rst)
+				sc->bin = false;
+			else if (esc)
+				sc->bin = true;
+			return rst ? rx_scan_reset : esc ? rx_scan_bin : rx_scan_eol;
+		}
+		sc->st  = c == SCPI_BLOCK_TAG ? rx_scan_blk_tag : rx_scan_text;
+		sc->rst = c == CLI_RST_CHR;
+		if (sc->esc < STRZ_LEN(FRAME_MODE_ESC) && c == FRAME_MODE_ESC[sc->esc])
+			++sc->esc;
+		else
+			sc->esc = STRZ_LEN(FRAME_MODE_ESC) + 1;
+	}
+	*used = i;
+	return rx_scan_more;
+}
+
+static inline unsigned rx_queued(void)
+{
+	return rx_q_tail - rx_q_head;
 }
 
-static bool is_receive_completed(void)
+// Find room for the command being received given its new size.
+// Returns the offset where it should be placed or -1 if there is no room for it.
+static int rx_room(unsigned sz)
 {
-	if (cli_err)
-		return true;
-	return rx_sz && rx_buff[rx_sz - 1] == CLI_EOL_CHR;
+	unsigned const head = rx_q_head;
+	unsigned first;
+	if (head == rx_q_tail)
+		// The buffer is empty
+		return rx_start + sz <= RX_BUFF_LEN ? rx_start : (sz <= RX_BUFF_LEN ? 0 : -1);
+
+	first = rx_queue[head & (CLI_QUEUE_LEN-1)].off;
+	if (rx_start > first) {
+		if (rx_start + sz <= RX_BUFF_LEN)
+			return rx_start;
+		// Wrap leaving the gap so the full buffer is not taken for the empty one
+		if (sz < first)
+			return 0;
+	} else if (rx_start + sz < first)
+		return rx_start;
+
+	return -1;
+}
+
+// Move the command being received to the given offset
+static inline void rx_move(int off)
+{
+	if (off != rx_start) {
+		memmove(rx_buff + off, rx_buff + rx_start, rx_sz + rx_pend);
+		rx_start = off;
+	}
 }
 
-static bool has_reset_token(void)
+static void rx_complete(enum rx_scan_res res)
 {
-	return	rx_sz >= 2 &&
-		rx_buff[rx_sz - 1] == CLI_EOL_CHR &&
-		rx_buff[rx_sz - 2] == CLI_RST_CHR;
+	struct cli_cmd* const cmd = &rx_queue[rx_q_tail & (CLI_QUEUE_LEN-1)];
+	bool const flush = res == rx_scan_reset;
+	cmd->off   = rx_start;
+	cmd->sz    = rx_sz;
+	cmd->err   = flush ? err_ok : rx_err;
+	cmd->flush = flush;
+	cmd->frame = res == rx_scan_frame_end;
+	if (!rx_err && rx_sz && !cmd->frame)
+		// Replace terminator by zero
+		rx_buff[rx_start + rx_sz - 1] = 0;
+	if (!flush)
+		rx_start += rx_sz;
+	rx_sz  = 0;
+	rx_err = err_ok;
+	++rx_q_tail;
 }
 
-static void chk_receive_completed(void)
+// Process received data. Returns true if it was consumed completely.
+static bool rx_process(void)
 {
-	if (has_reset_token()) {
-		rx_reset();
+	if (rx_pkt_len) {
+		int off;
+		if (rx_sz + rx_pend + rx_pkt_len > RX_BUFF_LEN) {
+			// Can't be held anyway
+			rx_err = err_proto;
+			rx_pkt_len = 0;
+			return true;
+		}
+		off = rx_room(rx_sz + rx_pend + rx_pkt_len);
+		if (off < 0)
+			// Wait for the commands processing to free the space
+			return false;
+		rx_move(off);
+		memcpy(rx_buff + rx_start + rx_sz + rx_pend, rx_pkt, rx_pkt_len);
+		rx_pend   += rx_pkt_len;
+		rx_pkt_len = 0;
+	}
+	while (rx_pend) {
+		enum rx_scan_res res;
+		unsigned used;
+		if (rx_queued() >= CLI_QUEUE_LEN)
+			// No room for the command to complete
+			return false;
+		res = rx_scan(&rx_scanner, rx_buff + rx_start + rx_sz, rx_pend, &used);
+		rx_pend -= used;
+		if (!rx_err && rx_sz + used > RX_BUFF_SZ)
+			rx_err = err_proto;
+		if (rx_err) {
+			// Drop the data of the command being discarded
+			rx_start += rx_sz + used;
+			rx_sz = 0;
+		} else
+			rx_sz += used;
+		if (res == rx_scan_reset) {
+			rx_start += rx_sz;
+			rx_sz = 0;
+			rx_complete(res);
+		} else if (res == rx_scan_bin) {
+			// The escape is not the command
+			rx_start += rx_sz;
+			rx_sz  = 0;
+			rx_err = err_ok;
+		} else if (res != rx_scan_more)
+			rx_complete(res);
+	}
+	return true;
+}
+
+// Arm the OUT endpoint to receive data in place. Returns false if there is no room.
+static bool rx_arm(void)
+{
+	unsigned len = RX_PKT_SZ;
+	uint8_t* ptr;
+	int off;
+	if (rx_queued() >= CLI_QUEUE_LEN)
+		return false;
+	if (!rx_err && rx_scanner.st == rx_scan_blk_data) {
+		// The block data is known to follow so it is received by multi-packet transfer.
+		// It completes on short packet or when the whole length is received. Since it
+		// does not exceed the data remaining it does not wait for the data never sent.
+		unsigned const blk = rx_scanner.cnt - rx_scanner.cnt % RX_PKT_SZ;
+		if (blk > len)
+			len = blk < RX_XFER_MAX ? blk : RX_XFER_MAX;
+	}
+	while ((off = rx_room(rx_sz + len)) < 0) {
+		if (len == RX_PKT_SZ)
+			return false;
+		len = RX_PKT_SZ;
+	}
+	rx_move(off);
+	ptr = rx_buff + rx_start + rx_sz;
+	USBD_CDC_SetRxBuffer(&hUsbDeviceFS, ptr);
+	USBD_LL_PrepareReceive(&hUsbDeviceFS, CDC_OUT_EP, ptr, len);
+	return true;
+}
+
+// Resume reception paused due to the lack of space
+static void rx_resume(void)
+{
+	if (!rx_process() || !rx_arm())
 		return;
+	// The host could not send the rest of the frame while on hold
+	rx_last_ts = HAL_GetTick();
+	rx_hold = false;
+}
+
+// Drop commands preceding the reset token
+static void rx_chk_flush(void)
+{
+	unsigned const tail = rx_q_tail;
+	unsigned i;
+	for (i = rx_q_head; i != tail; ++i) {
+		if (rx_queue[i & (CLI_QUEUE_LEN-1)].flush) {
+			rx_q_head = i + 1;
+			// Abort streamed response
+			tx_producer = NULL;
+			if (tx_frame) {
+				tx_sz = tx_frame - tx_buff;
+				tx_frame = NULL;
+			}
+		}
 	}
-	if (rx_cmd_sz) {
-		// we have not processed previous message yet
-		if (rx_sz)
-			cli_err = err_proto;
-	}
-	if (is_receive_completed()) {
-		if (!cli_err) {
-			rx_cmd_sz = rx_sz;
-			rx_buff[rx_cmd_sz] = 0;
-		} else {
-			rx_cmd_sz = -1;
-			rx_buff[0] = 0;
+}
+
+// Put pending event notifications to the transmit buffer and send them
+static void cli_send_events(void)
+{
+	while (evt_pending() && cli_tx_room() >= EVT_MAX_LEN) {
+		unsigned const sz = tx_sz;
+		if (evt_put_next() || cli_eol()) {
+			// Drop the incomplete notification
+			tx_sz = sz;
+			break;
 		}
-		rx_sz = 0;
 	}
+	if (tx_sz)
+		cli_reply();
 }
 
 void cli_init(void)
 {
+	stat_init();
 	cli_parser_init();
 }
 
+// Abandon the partial frame if its rest is not received in time. Otherwise the reset
+// token sent by the host recovering the link would be taken for the frame data.
+static void rx_chk_idle(void)
+{
+	uint32_t primask;
+	if (rx_scanner.st != rx_scan_frame || rx_hold || HAL_GetTick() - rx_last_ts < FRAME_IDLE_TOUT)
+		return;
+	primask = __get_PRIMASK();
+	__disable_irq();
+	if (rx_scanner.st == rx_scan_frame && !rx_pend && !rx_pkt_len) {
+		// The OUT endpoint is armed right after the data dropped so it stays in place
+		rx_start += rx_sz;
+		rx_sz = 0;
+		rx_err = err_ok;
+		rx_scanner.st = rx_scan_text;
+		frame_abandoned();
+	}
+	__set_PRIMASK(primask);
+}
+
 void cli_receive(uint8_t* Buf, uint32_t *Len)
 {
-	unsigned len = *Len;
-	if (!cli_err) {
-		if (rx_sz + len > RX_BUFF_SZ) {
-			cli_err = err_proto;
-		} else {
-			memcpy(rx_buff + rx_sz, Buf, len);
-			rx_sz += len;
-		}
+	rx_last_ts = HAL_GetTick();
+	if (Buf == rx_buff + rx_start + rx_sz)
+		rx_pend = *Len;
+	else {
+		rx_pkt     = Buf;
+		rx_pkt_len = *Len;
 	}
-	chk_receive_completed();
+	if (rx_process() && rx_arm())
+		return;
+	rx_hold = true;
 }
 
 void cli_run(void)
 {
 	err_t err;
-	unsigned sz;
+	struct cli_cmd const* cmd;
 	if (!usb_connected()) {
 		return;
 	}
-	if (usb_busy()) {
-		// Don't do anything till the previous packet transmission completion
+	usb_vendor_run();
+	diag_run();
+	rx_chk_flush();
+	rx_chk_idle();
+	if (rx_hold) {
+		rx_resume();
+	}
+	if (tx_ready) {
+		// Both buffers are taken till the previous packet transmission completion
+		if (usb_busy())
+			return;
+		cli_transmit();
+	}
+	if (!tx_producer && evt_pending() && !rx_scanner.bin) {
+		// Send notifications between replies, the binary mode replies are not interleaved with them
+		cli_send_events();
 		return;
 	}
 	// Check we need to reply
-	if (!tx_sz && (sz = rx_cmd_sz))
-	{
-		rx_cmd_sz = 0;
+	if (!rx_queued())
+		return;
+
+	cmd = &rx_queue[rx_q_head & (CLI_QUEUE_LEN-1)];
+	if (tx_producer) {
+		// Continue streamed response
+		err = cli_stream_next();
+	} else {
+		cmd_start = stat_ts();
+		cmd_top = NULL;
+		tx_first = true;
 		// Process incoming command
-		if (!cli_err) {
-			err = cli_handle_input(sz);
-		} else {
-			err = cli_err;
-		}
-		if (err) {
-			cli_err = cli_respond_err(err);
-		} else {
-			++cmd_total;
-		}
+		err = cmd->err ? (err_t)cmd->err : cli_handle_input(cmd);
 	}
+	if (err) {
+		tx_producer = NULL;
+		cli_respond_err(err);
+		++cli_cmd_errors;
+		if (evt_err_limit && !(cli_cmd_errors % evt_err_limit))
+			evt_post(evt_errors, cli_cmd_errors);
+	} else if (tx_producer) {
+		// Keep the command till its response is completed
+		return;
+	} else {
+		++cli_cmd_total;
+	}
+	stat_record(cmd_top, stat_ts() - cmd_start);
+	// Release command buffer space
+	++rx_q_head;
 }
-
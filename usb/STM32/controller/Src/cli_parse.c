@@ -3,12 +3,18 @@
 #include "i2c_eeprom.h"
 #include "system.h"
 #include "scpi.h"
+#include "scpi_index.h"
 #include "uuid.h"
 #include "debug.h"
 #include "str_util.h"
 #include "io_util.h"
 #include "version.h"
 #include "test.h"
+#include "events.h"
+#include "stat.h"
+#include "regmap.h"
+#include "diag.h"
+#include "acq.h"
 #include "main.h"
 
 #include <stddef.h>
@@ -29,16 +35,11 @@ static void cli_init_idn(void)
 	u32_to_hex(UUID[1], idn_buff + SN_OFFSET + 8);
 }
 
-void cli_parser_init(void)
-{
-	cli_init_idn();
-}
-
 static int idn_handler(const char* str, unsigned sz, struct scpi_node const* n)
 {
 	if (sz != 1 || *str != '?')
 		return -err_cmd;
-	err_t err = cli_printf("%s", idn_buff);
+	err_t err = cli_put(idn_buff, STRZ_LEN(idn_buff));
 	if (err)
 		return -err;
 	return sz;
@@ -84,6 +85,21 @@ static void fx2_reset_set(bool v)
 	WRITE_PIN(FX_nRST, !v);
 }
 
+static bool fx2_hs_get(void)
+{
+	return !READ_PIN(FX_nHS);
+}
+
+static bool fx2_full_get(void)
+{
+	return !READ_PIN(FX_nFULL);
+}
+
+static bool fx2_afull_get(void)
+{
+	return !READ_PIN(FX_nAFULL);
+}
+
 static const struct scpi_node star_nodes[] = {
 	{
 		"IDN",
@@ -113,11 +129,33 @@ static const struct scpi_node fx2_nodes[] = {
 		.param  = (void*)fx2_reset_get,
 		.param2 = (void*)fx2_reset_set
 	},
+	{
+		"HS",
+		NULL,
+		scpi_bool_r_handler2,
+		"? returns 1 if FX2 is connected to the host in high speed mode",
+		.param = (void*)fx2_hs_get
+	},
+	{
+		"FULL",
+		NULL,
+		scpi_bool_r_handler2,
+		"? returns 1 if FX2 FIFO is full",
+		.param = (void*)fx2_full_get
+	},
+	{
+		"AFULL",
+		NULL,
+		scpi_bool_r_handler2,
+		"? returns 1 if FX2 FIFO is almost full",
+		.param = (void*)fx2_afull_get
+	},
 	{
 		"EEPRom",
 		i2c_eeprom_nodes,
 		NULL,
-		" provides access to EEPROM attached to FX2 by means of the following tags:"
+		" provides access to EEPROM attached to FX2 by means of the following tags:",
+		.index = &i2c_eeprom_nodes_index
 	},
 	SCPI_NODE_END
 };
@@ -133,13 +171,43 @@ static const struct scpi_node system_nodes[] = {
 		"RESet",
 		reset_nodes,
 		reset_handler,
-		" performs controller reset. The following tag is optional:"
+		" performs controller reset. The following tag is optional:",
+		.index = &reset_nodes_index
+	},
+	{
+		"CONFig",
+		NULL,
+		scpi_u16_r_handler,
+		"? returns the detector configuration straps: bits 0-2 - the number of chained modules less one, bit 3 - wide mode, bits 4-6 - module type",
+		.param = &sys_cfg
 	},
 	{
 		"FX2",
 		fx2_nodes,
 		NULL,
-		" provides access to the Cypress FX2 USB Peripheral Controller by means of the following tags:"
+		" provides access to the Cypress FX2 USB Peripheral Controller by means of the following tags:",
+		.index = &fx2_nodes_index
+	},
+	{
+		"EVENts",
+		evt_nodes,
+		NULL,
+		" controls unsolicited notifications sent as lines starting with '!' by means of the following tags:",
+		.index = &evt_nodes_index
+	},
+	{
+		"STATistics",
+		stat_nodes,
+		NULL,
+		" provides command latency statistics by means of the following tags:",
+		.index = &stat_nodes_index
+	},
+	{
+		"DIAGnostic",
+		diag_nodes,
+		NULL,
+		" controls the diagnostic data stream sent over the vendor bulk IN endpoint by means of the following tags:",
+		.index = &diag_nodes_index
 	},
 	SCPI_NODE_END
 };
@@ -148,6 +216,7 @@ static const struct scpi_node test_nodes[] = {
 	{
 		"FIFO",
 		test_fifo_nodes,
+		.index = &test_fifo_nodes_index
 	},
 	{
 		"ECHO",
@@ -161,22 +230,44 @@ static const struct scpi_node test_nodes[] = {
 static const struct scpi_node colon_nodes[] = {
 	{
 		"SYSTem",
-		system_nodes
+		system_nodes,
+		.index = &system_nodes_index
+	},
+	{
+		"ACQuire",
+		acq_nodes,
+		.index = &acq_nodes_index
 	},
 	{
 		"TEST",
-		test_nodes
+		test_nodes,
+		.index = &test_nodes_index
 	},
 	SCPI_NODE_END,
 };
 
 static struct scpi_tree parse_tree = {
 	star_nodes,
-	colon_nodes
+	colon_nodes,
+	.star_index  = &star_nodes_index,
+	.colon_index = &colon_nodes_index
 };
 
-err_t cli_parse(const char* str, unsigned sz)
+void cli_parser_init(void)
+{
+	cli_init_idn();
+	scpi_index_init(&parse_tree);
+	regmap_init(&parse_tree);
+}
+
+err_t cli_parse(const char* str, unsigned sz, struct scpi_node const** top)
+{
+	*top = NULL;
+	return scpi_parse(str, sz, &parse_tree, top);
+}
+
+struct scpi_node const* cli_find(const char* path, unsigned sz)
 {
-	return scpi_parse(str, sz, &parse_tree);
+	return scpi_find(path, sz, &parse_tree);
 }
 
@@ -0,0 +1,191 @@
+#include "diag.h"
+#include "main.h"
+#include "usbd_core.h"
+#include "scpi.h"
+#include "debug.h"
+
+#include <string.h>
+
+/* Must be power of 2 */
+#define DIAG_RING_SZ  4096
+/* The max length of the single transfer */
+#define DIAG_XFER_MAX 1024
+/* The data length of the test records */
+#define DIAG_FILL_LEN 256
+
+BUILD_BUG_ON(DIAG_RING_SZ & (DIAG_RING_SZ - 1));
+BUILD_BUG_ON(sizeof(struct diag_hdr) != 8);
+
+static uint8_t           diag_ring[DIAG_RING_SZ];
+/* Free running positions, the head is advanced by producers, the tail on transfer completion */
+static volatile unsigned diag_head;
+static volatile unsigned diag_tail;
+/* The length of the transfer in progress, 0 if idle */
+static volatile unsigned diag_xfer;
+/* The device handle while the endpoint is open */
+static USBD_HandleTypeDef* volatile diag_dev;
+
+static uint32_t diag_lost;       /* dropped since the last diag_rec_lost record */
+static uint32_t diag_lost_total;
+static uint32_t diag_sent;       /* bytes */
+static uint32_t diag_fill_left;  /* test data bytes to generate */
+static uint32_t diag_fill_cnt;
+
+bool diag_trace;
+
+static inline unsigned diag_room(void)
+{
+	return DIAG_RING_SZ - (diag_head - diag_tail);
+}
+
+static void diag_ring_write(unsigned pos, void const* data, unsigned len)
+{
+	unsigned const off = pos & (DIAG_RING_SZ - 1);
+	unsigned const n = len < DIAG_RING_SZ - off ? len : DIAG_RING_SZ - off;
+	memcpy(diag_ring + off, data, n);
+	memcpy(diag_ring, (uint8_t const*)data + n, len - n);
+}
+
+// Should be called with interrupts disabled
+static bool diag_put_locked(enum diag_rec_type type, void const* data, unsigned len)
+{
+	struct diag_hdr const hdr = {
+		.tag  = DIAG_TAG,
+		.type = type,
+		.len  = len,
+		.ts   = HAL_GetTick()
+	};
+	if (diag_room() < sizeof(hdr) + len)
+		return false;
+	diag_ring_write(diag_head, &hdr, sizeof(hdr));
+	diag_ring_write(diag_head + sizeof(hdr), data, len);
+	diag_head += sizeof(hdr) + len;
+	return true;
+}
+
+bool diag_put(enum diag_rec_type type, void const* data, unsigned len)
+{
+	bool ok = false;
+	uint32_t const primask = __get_PRIMASK();
+	if (len > DIAG_REC_MAX)
+		return false;
+	__disable_irq();
+	// Report the losses first to keep the stream order
+	if (diag_lost && diag_put_locked(diag_rec_lost, &diag_lost, sizeof(diag_lost)))
+		diag_lost = 0;
+	if (!diag_lost)
+		ok = diag_put_locked(type, data, len);
+	if (!ok) {
+		++diag_lost;
+		++diag_lost_total;
+	}
+	__set_PRIMASK(primask);
+	return ok;
+}
+
+// Start the next transfer if idle. The transfer is limited by the ring end.
+static void diag_start(void)
+{
+	uint32_t const primask = __get_PRIMASK();
+	__disable_irq();
+	if (diag_dev && !diag_xfer && diag_head != diag_tail) {
+		unsigned const off = diag_tail & (DIAG_RING_SZ - 1);
+		unsigned len = diag_head - diag_tail;
+		if (len > DIAG_RING_SZ - off)
+			len = DIAG_RING_SZ - off;
+		if (len > DIAG_XFER_MAX)
+			len = DIAG_XFER_MAX;
+		diag_xfer = len;
+		USBD_LL_Transmit(diag_dev, DIAG_EP, diag_ring + off, len);
+	}
+	__set_PRIMASK(primask);
+}
+
+void diag_open(USBD_HandleTypeDef* pdev)
+{
+	USBD_LL_OpenEP(pdev, DIAG_EP, USBD_EP_TYPE_BULK, DIAG_EP_SIZE);
+	pdev->ep_in[DIAG_EP & 0xFU].is_used = 1U;
+	diag_xfer = 0;
+	diag_dev = pdev;
+}
+
+void diag_close(USBD_HandleTypeDef* pdev)
+{
+	uint32_t const primask = __get_PRIMASK();
+	diag_dev = NULL;
+	USBD_LL_CloseEP(pdev, DIAG_EP);
+	pdev->ep_in[DIAG_EP & 0xFU].is_used = 0U;
+	// Discard the queued data so the stream starts from the record boundary after reconnection
+	__disable_irq();
+	diag_tail = diag_head;
+	diag_xfer = 0;
+	__set_PRIMASK(primask);
+}
+
+void diag_data_in(USBD_HandleTypeDef* pdev)
+{
+	diag_tail += diag_xfer;
+	diag_sent += diag_xfer;
+	diag_xfer = 0;
+	diag_start();
+}
+
+static void diag_fill(void)
+{
+	static uint8_t buff[DIAG_FILL_LEN];
+	unsigned i, len;
+	while (diag_fill_left) {
+		len = diag_fill_left < DIAG_FILL_LEN ? diag_fill_left : DIAG_FILL_LEN;
+		if (len < sizeof(diag_fill_cnt))
+			len = sizeof(diag_fill_cnt);
+		if (diag_room() < sizeof(struct diag_hdr) + len)
+			break;
+		memcpy(buff, &diag_fill_cnt, sizeof(diag_fill_cnt));
+		for (i = sizeof(diag_fill_cnt); i < len; ++i)
+			buff[i] = i;
+		if (!diag_put(diag_rec_fill, buff, len))
+			break;
+		++diag_fill_cnt;
+		diag_fill_left -= len < diag_fill_left ? len : diag_fill_left;
+	}
+}
+
+void diag_run(void)
+{
+	if (!diag_dev)
+		return;
+	diag_fill();
+	diag_start();
+}
+
+const struct scpi_node diag_nodes[] = {
+	{
+		"TRACe",
+		NULL,
+		scpi_bool_rw_handler,
+		"(0|1) disables|enables copying events to the diagnostic stream regardless of the notifications being enabled. TRACe? returns the current setting.",
+		.param = &diag_trace
+	},
+	{
+		"FILL",
+		NULL,
+		scpi_u32_rw_handler,
+		" N queues N bytes of test records to measure the stream bandwidth. FILL? returns the number of bytes not queued yet.",
+		.param = &diag_fill_left
+	},
+	{
+		"SENT",
+		NULL,
+		scpi_u32_r_handler,
+		"? returns the number of bytes sent",
+		.param = &diag_sent
+	},
+	{
+		"LOST",
+		NULL,
+		scpi_u32_r_handler,
+		"? returns the number of records dropped due to the buffer overflow",
+		.param = &diag_lost_total
+	},
+	SCPI_NODE_END
+};
@@ -0,0 +1,125 @@
+#include "events.h"
+#include "main.h"
+#include "scpi.h"
+#include "cli.h"
+#include "diag.h"
+#include "debug.h"
+
+/* Must be power of 2 */
+#define EVT_QUEUE_LEN 16
+
+struct evt {
+	uint8_t  id;
+	uint32_t arg;
+};
+
+static struct evt        evt_queue[EVT_QUEUE_LEN];
+static volatile unsigned evt_head;
+static volatile unsigned evt_tail;
+static volatile uint32_t evt_lost_cnt;
+
+bool     evt_enabled;
+uint32_t evt_err_limit;
+
+BUILD_BUG_ON(EVT_QUEUE_LEN & (EVT_QUEUE_LEN - 1));
+
+static const struct {
+	const char* name;
+	bool        has_arg;
+} evt_info[] = {
+	[evt_fifo_paused]  = {"FIFO PAUSED"},
+	[evt_fifo_resumed] = {"FIFO RUNNING"},
+	[evt_hs_lost]      = {"HS 0"},
+	[evt_hs_restored]  = {"HS 1"},
+	[evt_errors]       = {"ERRORS", true},
+	[evt_lost]         = {"LOST", true},
+	[evt_epm_failed]   = {"EEPROM FAILED", true},
+};
+
+void evt_post(enum evt_id id, uint32_t arg)
+{
+	uint32_t primask;
+	if (diag_trace) {
+		uint32_t const rec[2] = {id, arg};
+		diag_put(diag_rec_event, rec, sizeof(rec));
+	}
+	if (!evt_enabled)
+		return;
+	primask = __get_PRIMASK();
+	__disable_irq();
+	if (evt_tail - evt_head < EVT_QUEUE_LEN) {
+		struct evt* const e = &evt_queue[evt_tail & (EVT_QUEUE_LEN-1)];
+		e->id  = id;
+		e->arg = arg;
+		++evt_tail;
+	} else
+		++evt_lost_cnt;
+	__set_PRIMASK(primask);
+}
+
+bool evt_pending(void)
+{
+	return evt_head != evt_tail || evt_lost_cnt;
+}
+
+err_t evt_put_next(void)
+{
+	char const tag = EVT_TAG;
+	struct evt e;
+	err_t err;
+	if (evt_head != evt_tail) {
+		e = evt_queue[evt_head & (EVT_QUEUE_LEN-1)];
+		++evt_head;
+	} else if (evt_lost_cnt) {
+		uint32_t const primask = __get_PRIMASK();
+		__disable_irq();
+		e.id  = evt_lost;
+		e.arg = evt_lost_cnt;
+		evt_lost_cnt = 0;
+		__set_PRIMASK(primask);
+	} else
+		return err_ok;
+
+	if ((err = cli_put(&tag, 1)) || (err = cli_put_str(evt_info[e.id].name)))
+		return err;
+	if (evt_info[e.id].has_arg && (
+		(err = cli_put(" ", 1)) ||
+		(err = cli_put_u(e.arg, 0))
+	))
+		return err;
+	return err_ok;
+}
+
+static bool evt_enabled_get(void)
+{
+	return evt_enabled;
+}
+
+static void evt_enabled_set(bool v)
+{
+	if (v && !evt_enabled) {
+		// Drop stale events
+		evt_head = evt_tail;
+		evt_lost_cnt = 0;
+	}
+	evt_enabled = v;
+}
+
+const struct scpi_node evt_nodes[] = {
+	{
+		"ENABle",
+		NULL,
+		scpi_bool_rw_handler2,
+		"(0|1) disables|enables event notifications. ENABle? returns the current setting.",
+		.param  = (void*)evt_enabled_get,
+		.param2 = (void*)evt_enabled_set
+	},
+	{
+		"ERRLimit",
+		NULL,
+		scpi_u32_rw_handler,
+		" N sends notification each time the number of command errors reaches the multiple of N, 0 disables it",
+		.param = &evt_err_limit
+	},
+	SCPI_NODE_END
+};
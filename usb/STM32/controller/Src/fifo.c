@@ -0,0 +1,246 @@
+#include "fifo.h"
+#include "main.h"
+#include "io_util.h"
+#include "events.h"
+
+#define hSPI hspi1
+#define SPI_BITS 16
+#define TX_BURST (256/SPI_BITS)
+#define TX_CHUNK (32/SPI_BITS)
+
+// The circular buffer length in streaming mode. Each half is refilled while the other one
+// is transmitted so it should take longer than the worst case interrupt latency.
+#define STREAM_LEN 1024
+
+extern DMA_HandleTypeDef hdma_spi1_tx;
+
+static uint16_t stream_buff[STREAM_LEN];
+
+// The stream is driven by the SPI DMA completion and FX2 flags EXTI interrupts. They have
+// the same priority so the state is only updated by one of them at a time. The main loop
+// and command handlers update it with interrupts disabled.
+static struct fifo_source const* volatile fifo_src;
+static struct fifo_source const* tx_src; /* the source of the transfer in progress */
+static unsigned      tx_len;
+static volatile bool fifo_on       = false;
+static volatile bool fifo_stream   = false; /* use circular DMA on start */
+static volatile bool start_request = false;
+static volatile bool is_idle       = true;
+static volatile bool is_streaming  = false; /* circular DMA is running, the flow is controlled by pausing it */
+
+volatile bool fifo_paused = false;
+uint32_t      fifo_words;
+
+static void set_idle(bool flag)
+{
+	is_idle = flag;
+}
+
+// Pause stream till FX2 is ready to accept more data
+static void set_paused(void)
+{
+	if (!fifo_paused) {
+		fifo_paused = true;
+		evt_post(evt_fifo_paused, 0);
+	}
+}
+
+static void set_running(void)
+{
+	set_idle(false);
+	if (fifo_paused) {
+		fifo_paused = false;
+		evt_post(evt_fifo_resumed, 0);
+	}
+}
+
+static void stream_start(void)
+{
+	fifo_src->fill(stream_buff, STREAM_LEN);
+	HAL_SPI_Transmit_DMA(&hSPI, (uint8_t*)stream_buff, STREAM_LEN);
+}
+
+// The half of the buffer is sent, account it and fill with the next data. The half
+// completing while the stream is being stopped is accounted but not refilled.
+static void stream_half_sent(uint16_t* half)
+{
+	fifo_words += STREAM_LEN / 2;
+	if (is_streaming)
+		fifo_src->fill(half, STREAM_LEN / 2);
+}
+
+static inline bool stream_dma(void)
+{
+	return hdma_spi1_tx.Init.Mode == DMA_CIRCULAR;
+}
+
+// Stop / resume DMA requests leaving the circular transfer set up.
+// The HAL_SPI_DMAPause/Resume() are not used since they control the Rx requests as well.
+static inline void stream_pause(void)
+{
+	CLEAR_BIT(hSPI.Instance->CR2, SPI_CR2_TXDMAEN);
+}
+
+static inline void stream_resume(void)
+{
+	SET_BIT(hSPI.Instance->CR2, SPI_CR2_TXDMAEN);
+}
+
+// Start sending from the beginning in the mode selected
+static void transmit_begin(void)
+{
+	uint32_t const mode = fifo_stream ? DMA_CIRCULAR : DMA_NORMAL;
+	start_request = false;
+	is_streaming  = fifo_stream;
+	if (hdma_spi1_tx.Init.Mode != mode) {
+		hdma_spi1_tx.Init.Mode = mode;
+		HAL_DMA_Init(&hdma_spi1_tx);
+	}
+	if (fifo_src->start)
+		fifo_src->start();
+	if (is_streaming)
+		stream_start();
+}
+
+// Start the next transmission if FX2 has room for it. Should be called while idle or paused.
+// If it has not, the stream is resumed by the FX2 flags interrupts. The edge coming
+// after the flags are checked is not missed since its interrupt stays pending.
+static void transmit_resume(void)
+{
+	unsigned len;
+	uint16_t const* data;
+	bool const stream = start_request ? fifo_stream : is_streaming;
+	if (!fifo_on)
+		return;
+	if (READ_PIN(FX_nHS)) {
+		// not in HS mode
+		set_paused();
+		return;
+	}
+	if (READ_PIN(FX_nAFULL))
+		// has room for the full burst
+		len = TX_BURST;
+	else if (READ_PIN(FX_nFULL) && !stream)
+		// almost full
+		len = TX_CHUNK;
+	else {
+		// full, the stream waits for the room for the full burst since it can't be stopped immediately
+		set_paused();
+		return;
+	}
+	if (start_request)
+		transmit_begin();
+	if (is_streaming) {
+		set_running();
+		stream_resume();
+		return;
+	}
+	len = fifo_src->get(&data, len);
+	if (!len)
+		// Resumed by fifo_kick()
+		return;
+	set_running();
+	tx_src = fifo_src;
+	tx_len = len;
+	HAL_SPI_Transmit_DMA(&hSPI, (uint8_t*)data, len);
+}
+
+// Pause running stream if FX2 is almost full. The words already loaded to SPI are still sent.
+static void stream_chk_room(void)
+{
+	if (READ_PIN(FX_nHS) || !READ_PIN(FX_nAFULL)) {
+		stream_pause();
+		set_paused();
+	}
+}
+
+static void stream_stop(void)
+{
+	bool streaming;
+	uint32_t const primask = __get_PRIMASK();
+	__disable_irq();
+	fifo_on      = false;
+	streaming    = is_streaming;
+	is_streaming = false;
+	__set_PRIMASK(primask);
+	if (streaming) {
+		// Circular transfer never completes, account the words of the half sent partially
+		HAL_SPI_DMAStop(&hSPI);
+		fifo_words += (STREAM_LEN - __HAL_DMA_GET_COUNTER(&hdma_spi1_tx)) % (STREAM_LEN / 2);
+		set_idle(true);
+	}
+}
+
+void fifo_start(struct fifo_source const* src, bool stream)
+{
+	uint32_t primask;
+	stream_stop();
+	primask = __get_PRIMASK();
+	__disable_irq();
+	fifo_src    = src;
+	fifo_stream = stream && src->fill;
+	fifo_on     = start_request = true;
+	// Otherwise it will be restarted on the current transmission completion
+	if (is_idle)
+		transmit_resume();
+	__set_PRIMASK(primask);
+}
+
+void fifo_stop(struct fifo_source const* src)
+{
+	if (src != fifo_src)
+		return;
+	start_request = false;
+	stream_stop();
+}
+
+void fifo_kick(void)
+{
+	if (is_idle && !fifo_paused)
+		transmit_resume();
+}
+
+bool fifo_active(struct fifo_source const* src)
+{
+	return fifo_on && src == fifo_src;
+}
+
+const char* fifo_state(struct fifo_source const* src)
+{
+	if (src != fifo_src)
+		return "STOPPED";
+	if (!fifo_on)
+		return is_idle ? "STOPPED" : "STOPPING";
+	else
+		return fifo_paused ? "PAUSED" : "RUNNING";
+}
+
+void HAL_SPI_TxHalfCpltCallback(SPI_HandleTypeDef *hspi)
+{
+	if (hspi == &hSPI && stream_dma())
+		stream_half_sent(stream_buff);
+}
+
+void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef *hspi)
+{
+	if (hspi != &hSPI)
+		return;
+	if (stream_dma()) {
+		stream_half_sent(stream_buff + STREAM_LEN / 2);
+		return;
+	}
+	if (tx_src->put)
+		tx_src->put(tx_len);
+	fifo_words += tx_len;
+	set_idle(true);
+	transmit_resume();
+}
+
+void HAL_GPIO_EXTI_Callback(uint16_t pin)
+{
+	if (is_idle || fifo_paused)
+		// FX2 has room for more data or HS link is established
+		transmit_resume();
+	else if (is_streaming)
+		stream_chk_room();
+}
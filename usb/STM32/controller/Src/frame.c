@@ -0,0 +1,171 @@
+#include "frame.h"
+#include "cli.h"
+#include "cli_parse.h"
+#include "scpi.h"
+#include "version.h"
+#include <string.h>
+
+/* The max number of value nodes resolved for typed access */
+#define FRAME_HANDLES 16
+
+#define FRAME_INFO_BUILD 36
+
+static uint8_t frame_last_sn;
+static uint8_t frame_status;
+
+static struct scpi_node const* frame_handles[FRAME_HANDLES];
+static unsigned                frame_handles_used;
+
+BUILD_BUG_ON(FRAME_INFO_BUILD + STRZ_LEN(__DATE__ " " __TIME__) > FRAME_DATA_SZ);
+
+// CRC16-CCITT, the polynomial 0x1021, initial value 0xffff
+static uint16_t frame_crc(uint8_t const* data, unsigned sz)
+{
+	static const uint16_t tbl[16] = {
+		0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+		0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef
+	};
+	uint16_t crc = 0xffff;
+	while (sz--) {
+		uint8_t const b = *data++;
+		crc = (crc << 4) ^ tbl[(crc >> 12) ^ (b >> 4)];
+		crc = (crc << 4) ^ tbl[(crc >> 12) ^ (b & 0xf)];
+	}
+	return crc;
+}
+
+static inline uint32_t get_le32(uint8_t const* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void put_le32(uint32_t v, uint8_t* p)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+static err_t frame_info_reply(uint8_t const* data)
+{
+	static const char build[] = __DATE__ " " __TIME__;
+	uint8_t* const p = (uint8_t*)cli_tx_alloc(FRAME_DATA_SZ);
+	if (!p)
+		return err_internal;
+	// The request payload is echoed except the info fields
+	memcpy(p, data, FRAME_DATA_SZ);
+	p[0] = VERSION_MAJ;
+	p[1] = VERSION_MIN;
+	p[2] = frame_last_sn;
+	memcpy(p + FRAME_INFO_BUILD, build, STRZ_LEN(build));
+	return err_ok;
+}
+
+static err_t frame_resolve_node(uint8_t const* data)
+{
+	uint8_t h;
+	struct scpi_node const* n;
+	uint32_t v;
+	if (data[0] > FRAME_DATA_SZ - 1)
+		return err_param;
+	if (!(n = cli_find((const char*)data + 1, data[0])) || scpi_value_get(n, &v))
+		return err_param;
+	for (h = 0; h < frame_handles_used; ++h)
+		if (frame_handles[h] == n)
+			break;
+	if (h >= frame_handles_used) {
+		if (frame_handles_used >= FRAME_HANDLES)
+			return err_state;
+		frame_handles[frame_handles_used++] = n;
+	}
+	return cli_put((char const*)&h, 1);
+}
+
+static err_t frame_value_get(uint8_t const* data)
+{
+	uint8_t v_buf[4];
+	uint32_t v;
+	err_t err;
+	if (data[0] >= frame_handles_used)
+		return err_param;
+	if ((err = scpi_value_get(frame_handles[data[0]], &v)))
+		return err;
+	put_le32(v, v_buf);
+	return cli_put((char const*)v_buf, sizeof(v_buf));
+}
+
+static err_t frame_value_set(uint8_t const* data)
+{
+	if (data[0] >= frame_handles_used)
+		return err_param;
+	return scpi_value_set(frame_handles[data[0]], get_le32(data + 1));
+}
+
+err_t frame_handle(uint8_t const* req, uint8_t* hdr, struct scpi_node const** top)
+{
+	uint8_t const* const data = req + FRAME_HDR_SZ;
+	uint16_t const crc = req[FRAME_LEN-2] | (req[FRAME_LEN-1] << 8);
+
+	*top = NULL;
+	hdr[FRAME_CMD]    = req[FRAME_CMD];
+	hdr[FRAME_SN]     = req[FRAME_SN];
+	hdr[FRAME_FLAGS]  = req[FRAME_FLAGS] & FRAME_SEQ;
+	hdr[FRAME_STATUS] = 0;
+
+	if (crc != frame_crc(req, FRAME_LEN - FRAME_CRC_SZ)) {
+		// Nothing in the frame can be trusted but the host may wait for the reply
+		frame_status |= FRAME_ST_PROTO;
+		hdr[FRAME_CMD] |= FRAME_RESP;
+		return err_proto;
+	}
+	if (req[FRAME_FLAGS] & FRAME_SEQ) {
+		if (req[FRAME_SN] != (uint8_t)(frame_last_sn + 1))
+			frame_status |= FRAME_ST_SEQ;
+		frame_last_sn = req[FRAME_SN];
+	}
+	switch (req[FRAME_CMD] & FRAME_CMD_MASK) {
+	case frame_info:
+		return frame_info_reply(data);
+	case frame_reset:
+		frame_last_sn = 0;
+		frame_status = 0;
+		frame_handles_used = 0;
+		return err_ok;
+	case frame_scpi: {
+		char* len;
+		if (data[0] > FRAME_DATA_SZ - 1)
+			return err_param;
+		// The length of the reply is set by frame_seal()
+		if (!(len = cli_tx_alloc(1)))
+			return err_internal;
+		*len = 0;
+		return cli_parse((const char*)data + 1, data[0], top);
+	}
+	case frame_resolve:
+		return frame_resolve_node(data);
+	case frame_get:
+		return frame_value_get(data);
+	case frame_set:
+		return frame_value_set(data);
+	default:
+		return err_cmd;
+	}
+}
+
+void frame_abandoned(void)
+{
+	frame_status |= FRAME_ST_PROTO;
+}
+
+void frame_seal(uint8_t* f, unsigned len, err_t err)
+{
+	uint16_t crc;
+	if (!err && (f[FRAME_CMD] & FRAME_CMD_MASK) == frame_scpi)
+		f[FRAME_HDR_SZ] = len - 1;
+	f[FRAME_FLAGS]  = (f[FRAME_FLAGS] & FRAME_SEQ) | (err & FRAME_ERR_MASK);
+	f[FRAME_STATUS] = frame_status;
+	crc = frame_crc(f, FRAME_LEN - FRAME_CRC_SZ);
+	f[FRAME_LEN-2] = crc;
+	f[FRAME_LEN-1] = crc >> 8;
+}
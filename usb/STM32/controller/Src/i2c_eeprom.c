@@ -2,6 +2,7 @@
 #include "main.h"
 #include "scpi.h"
 #include "cli.h"
+#include "events.h"
 #include "errors.h"
 #include "debug.h"
 #include "str_util.h"
@@ -10,7 +11,6 @@
 #define EPM_ADDRESS    0xa2
 #define EPM_ADDR_END   0x8000 // 32k for AT24C256
 #define EPM_PAGE_SZ    64
-#define EPM_ADDR_TOUT  2
 #define EPM_DATA_TOUT  20
 #define EPM_WRITE_WAIT 12 // msec
 
@@ -18,34 +18,126 @@
 
 static uint8_t  i2c_epm_buff[EPM_PAGE_SZ+2];
 static uint32_t i2c_epm_last_write_ts;
+static uint16_t i2c_epm_dump_addr;
+static bool     i2c_epm_dump_failed;
 
-static bool i2c_epm_read(uint16_t addr, uint8_t* buff, uint8_t sz)
+/* The EEPROM operations are performed asynchronously so the command handlers
+ * don't stall the main loop. The operation is started by i2c_epm_read() or
+ * i2c_epm_write() and then completed by polling i2c_epm_poll(). The reset drops
+ * the polling command but not the interrupt driven transfer, so the data to be
+ * written is kept in the operation till the previous transfer is completed and
+ * i2c_epm_buff is only used by the transfer in progress. */
+enum i2c_epm_state {
+	epm_idle,
+	epm_wait,  /* waiting for the previous write cycle completion */
+	epm_busy,  /* transfer in progress */
+};
+
+static struct {
+	uint8_t  state;
+	bool     write;
+	uint16_t addr;
+	uint8_t  sz;
+	uint32_t ts; /* the operation or transfer start time */
+	uint8_t  data[EPM_PAGE_SZ]; /* the data to be written */
+} i2c_epm_op;
+
+static void i2c_epm_start(bool write, uint16_t addr, uint8_t sz)
+{
+	i2c_epm_op.state = epm_wait;
+	i2c_epm_op.write = write;
+	i2c_epm_op.addr  = addr;
+	i2c_epm_op.sz    = sz;
+	i2c_epm_op.ts    = HAL_GetTick();
+}
+
+// Start reading EEPROM to i2c_epm_buff
+static void i2c_epm_read(uint16_t addr, uint8_t sz)
+{
+	i2c_epm_start(false, addr, sz);
+}
+
+// Start writing data to EEPROM
+static void i2c_epm_write(uint16_t addr, uint8_t const* data, uint8_t sz)
+{
+	memcpy(i2c_epm_op.data, data, sz);
+	i2c_epm_start(true, addr, sz);
+}
+
+// The write cycle starts once the transfer is completed, including the one of the
+// command dropped by the reset, or stopped by abort with the page partially sent
+void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+	if (hi2c == &hEPM_I2C)
+		i2c_epm_last_write_ts = HAL_GetTick();
+}
+
+void HAL_I2C_AbortCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+	if (hi2c == &hEPM_I2C)
+		i2c_epm_last_write_ts = HAL_GetTick();
+}
+
+// Abort the transfer stuck or reinitialize the peripheral if it can't be aborted
+static void i2c_epm_recover(void)
 {
-	uint8_t address[2] = {addr >> 8, addr};
-	HAL_StatusTypeDef rc = HAL_I2C_Master_Transmit(&hEPM_I2C, EPM_ADDRESS, address, 2, EPM_ADDR_TOUT);
-	if (rc != HAL_OK)
-		return false;
-	rc = HAL_I2C_Master_Receive(&hEPM_I2C, EPM_ADDRESS, buff, sz, EPM_DATA_TOUT);
-	return rc == HAL_OK;
+	if (HAL_I2C_Master_Abort_IT(&hEPM_I2C, EPM_ADDRESS) == HAL_OK)
+		return;
+	HAL_I2C_DeInit(&hEPM_I2C);
+	HAL_I2C_Init(&hEPM_I2C);
 }
 
-static bool i2c_epm_write(uint16_t addr, uint8_t* buff, uint8_t sz)
+// Advance the operation in progress. Returns positive value if it is still
+// pending, zero on completion or negative error code.
+static int i2c_epm_poll(void)
 {
+	HAL_StatusTypeDef rc;
 	uint32_t const now = HAL_GetTick();
-	uint32_t const elapsed_since_last = now - i2c_epm_last_write_ts;
-	if (elapsed_since_last < EPM_WRITE_WAIT)
-		HAL_Delay(EPM_WRITE_WAIT - elapsed_since_last);
-	memmove(buff + 2, buff, sz);
-	buff[0] = addr >> 8;
-	buff[1] = addr;
-	HAL_StatusTypeDef rc = HAL_I2C_Master_Transmit(&hEPM_I2C, EPM_ADDRESS, buff, 2 + sz, EPM_DATA_TOUT);
-	i2c_epm_last_write_ts = HAL_GetTick();
-	return rc == HAL_OK;
+	switch (i2c_epm_op.state) {
+	case epm_wait:
+		// The EEPROM does not respond during the write cycle. The transfer of
+		// the aborted command may be not completed yet as well.
+		if (now - i2c_epm_last_write_ts < EPM_WRITE_WAIT || HAL_I2C_GetState(&hEPM_I2C) != HAL_I2C_STATE_READY) {
+			if (now - i2c_epm_op.ts <= EPM_WRITE_WAIT + EPM_DATA_TOUT)
+				return 1;
+			if (HAL_I2C_GetState(&hEPM_I2C) != HAL_I2C_STATE_READY)
+				i2c_epm_recover();
+			break;
+		}
+		if (i2c_epm_op.write) {
+			i2c_epm_buff[0] = i2c_epm_op.addr >> 8;
+			i2c_epm_buff[1] = i2c_epm_op.addr;
+			memcpy(i2c_epm_buff + 2, i2c_epm_op.data, i2c_epm_op.sz);
+			rc = HAL_I2C_Master_Transmit_IT(&hEPM_I2C, EPM_ADDRESS, i2c_epm_buff, 2 + i2c_epm_op.sz);
+		} else
+			rc = HAL_I2C_Mem_Read_IT(&hEPM_I2C, EPM_ADDRESS, i2c_epm_op.addr, I2C_MEMADD_SIZE_16BIT, i2c_epm_buff, i2c_epm_op.sz);
+		if (rc != HAL_OK)
+			break;
+		i2c_epm_op.state = epm_busy;
+		i2c_epm_op.ts = now;
+		return 1;
+	case epm_busy:
+		if (HAL_I2C_GetState(&hEPM_I2C) != HAL_I2C_STATE_READY) {
+			if (now - i2c_epm_op.ts <= EPM_DATA_TOUT)
+				return 1;
+			i2c_epm_recover();
+			break;
+		}
+		if (hEPM_I2C.ErrorCode != HAL_I2C_ERROR_NONE)
+			break;
+		i2c_epm_op.state = epm_idle;
+		return 0;
+	default:
+		return 0;
+	}
+	i2c_epm_op.state = epm_idle;
+	return -err_internal;
 }
 
 static int i2c_eeprom_wr_handler(const char* str, unsigned sz, struct scpi_node const* n)
 {
 	uint32_t addr;
+	uint8_t data[EPM_PAGE_SZ];
 	unsigned sz_ = sz;
 	unsigned rc = scan_u(str, sz_, &addr);
 	if (!rc || addr >= EPM_ADDR_END)
@@ -63,33 +155,135 @@ static int i2c_eeprom_wr_handler(const char* str, unsigned sz, struct scpi_node
 		if (cnt && !((addr + cnt) & (EPM_PAGE_SZ-1)))
 			return -err_param;
 		BUG_ON(cnt >= EPM_PAGE_SZ);
-		i2c_epm_buff[cnt] = val;
+		data[cnt] = val;
 		str += rc;
 		sz_ -= rc;
 	}
 	if (!cnt)
 		return -err_param;
-	if (!i2c_epm_write(addr, i2c_epm_buff, cnt))
-		return -err_internal;
+	i2c_epm_write(addr, data, cnt);
+	cli_stream(i2c_epm_poll);
 	return sz - sz_;
 }
 
-static int i2c_eeprom_rd_handler(const char* str, unsigned sz, struct scpi_node const* n)
+static int i2c_eeprom_wrb_handler(const char* str, unsigned sz, struct scpi_node const* n)
 {
 	uint32_t addr;
+	uint8_t const* data;
+	unsigned len;
 	unsigned rc = scan_u(str, sz, &addr);
-	if (!rc || (addr >= EPM_ADDR_END) || (addr & (EPM_PAGE_SZ-1)))
+	if (!rc || addr >= EPM_ADDR_END)
+		return -err_param;
+	int const blk_rc = scpi_scan_block(str + rc, sz - rc, &data, &len);
+	if (blk_rc < 0)
+		return blk_rc;
+	if (!len || (addr & (EPM_PAGE_SZ-1)) + len > EPM_PAGE_SZ)
 		return -err_param;
+	i2c_epm_write(addr, data, len);
+	cli_stream(i2c_epm_poll);
+	return rc + blk_rc;
+}
+
+// Parse page read request ADDR? and start reading the page into i2c_epm_buff
+static err_t i2c_eeprom_rd_page(const char* str, unsigned sz)
+{
+	uint32_t addr;
+	unsigned rc = scan_u(str, sz, &addr);
+	if (!rc || (addr >= EPM_ADDR_END) || (addr & (EPM_PAGE_SZ-1)))
+		return err_param;
 	if (rc + 1 != sz || str[rc] != '?')
-		return -err_cmd;
-	if (!i2c_epm_read(addr, i2c_epm_buff, EPM_PAGE_SZ))
-		return -err_internal;
+		return err_cmd;
+	i2c_epm_read(addr, EPM_PAGE_SZ);
+	return err_ok;
+}
+
+// Complete page read and reply with its hex dump
+static int i2c_eeprom_rd_poll(void)
+{
+	char hex[3*EPM_PAGE_SZ];
+	int const rc = i2c_epm_poll();
+	if (rc)
+		return rc;
 	for (uint8_t i = 0; i < EPM_PAGE_SZ; ++i) {
-		err_t err = cli_printf("%02X ", i2c_epm_buff[i]);
-		if (err)
+		byte_to_hex(i2c_epm_buff[i], hex + 3*i);
+		hex[3*i + 2] = ' ';
+	}
+	return -cli_put(hex, sizeof(hex));
+}
+
+static int i2c_eeprom_rd_handler(const char* str, unsigned sz, struct scpi_node const* n)
+{
+	err_t const err = i2c_eeprom_rd_page(str, sz);
+	if (err)
+		return -err;
+	cli_stream(i2c_eeprom_rd_poll);
+	return sz;
+}
+
+// Complete page read and reply with the block
+static int i2c_eeprom_rdb_poll(void)
+{
+	int const rc = i2c_epm_poll();
+	if (rc)
+		return rc;
+	return -scpi_put_block(i2c_epm_buff, EPM_PAGE_SZ);
+}
+
+static int i2c_eeprom_rdb_handler(const char* str, unsigned sz, struct scpi_node const* n)
+{
+	err_t const err = i2c_eeprom_rd_page(str, sz);
+	if (err)
+		return -err;
+	cli_stream(i2c_eeprom_rdb_poll);
+	return sz;
+}
+
+// Put the next page of the EEPROM content to the response once it is read. The block
+// header is put with the first page so failing to read it gets the error reply. Once the
+// header is sent the block length can't be changed, so the failure is reported by the
+// evt_epm_failed event and the rest of the block is padded by 0xff.
+static int i2c_eeprom_dump_next(void)
+{
+	int rc = 0;
+	err_t err;
+	char* ptr;
+	if (i2c_epm_op.state == epm_idle) {
+		if (cli_tx_room() < EPM_PAGE_SZ)
+			return 1;
+		if (!i2c_epm_dump_failed)
+			i2c_epm_read(i2c_epm_dump_addr, EPM_PAGE_SZ);
+	}
+	if (!i2c_epm_dump_failed && (rc = i2c_epm_poll()) > 0)
+		return rc;
+	if (!i2c_epm_dump_addr) {
+		if (rc)
+			return rc;
+		if ((err = scpi_put_block_hdr(EPM_ADDR_END)))
 			return -err;
+	} else if (rc) {
+		i2c_epm_dump_failed = true;
+		evt_post(evt_epm_failed, i2c_epm_dump_addr);
 	}
-	return sz;	
+	// The room is checked before the page read is started
+	if (!(ptr = cli_tx_alloc(EPM_PAGE_SZ)))
+		return -err_internal;
+	if (i2c_epm_dump_failed)
+		memset(ptr, 0xff, EPM_PAGE_SZ);
+	else
+		memcpy(ptr, i2c_epm_buff, EPM_PAGE_SZ);
+	i2c_epm_dump_addr += EPM_PAGE_SZ;
+	return i2c_epm_dump_addr < EPM_ADDR_END;
+}
+
+static int i2c_eeprom_dump_handler(const char* str, unsigned sz, struct scpi_node const* n)
+{
+	if (sz != 1 || *str != '?')
+		return -err_cmd;
+	i2c_epm_dump_addr = 0;
+	i2c_epm_dump_failed = false;
+	i2c_epm_read(0, EPM_PAGE_SZ);
+	cli_stream(i2c_eeprom_dump_next);
+	return sz;
 }
 
 const struct scpi_node i2c_eeprom_nodes[] = {
@@ -105,5 +299,23 @@ const struct scpi_node i2c_eeprom_nodes[] = {
 		i2c_eeprom_rd_handler,
 		" ADDR? returns 64-byte page starting at the ADDR",
 	},
+	{
+		"WRBlock",
+		NULL,
+		i2c_eeprom_wrb_handler,
+		" ADDR #<n><len><bytes> writes binary block of up to 64 bytes starting at the ADDR",
+	},
+	{
+		"RDBlock",
+		NULL,
+		i2c_eeprom_rdb_handler,
+		" ADDR? returns 64-byte page starting at the ADDR as binary block #264<bytes>",
+	},
+	{
+		"DUMP",
+		NULL,
+		i2c_eeprom_dump_handler,
+		"? returns the whole EEPROM content as binary block #532768<bytes>, the pages failed to read are filled by 0xff",
+	},
 	SCPI_NODE_END
 };
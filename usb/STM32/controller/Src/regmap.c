@@ -0,0 +1,93 @@
+#include "regmap.h"
+#include "scpi.h"
+#include "scpi_index.h"
+#include "debug.h"
+#include <string.h>
+
+BUILD_BUG_ON(SCPI_VALUE_NODES > REGMAP_MAX);
+
+static struct scpi_tree const* regmap_tree;
+static struct scpi_node const* regmap[REGMAP_MAX];
+static unsigned                regmap_cnt;
+
+static void regmap_scan(struct scpi_node const* dir)
+{
+	struct scpi_node const* n;
+	for (n = dir; n->name; ++n) {
+		if (n->dir)
+			regmap_scan(n->dir);
+		else if (scpi_value_access(n)) {
+			BUG_ON(regmap_cnt >= REGMAP_MAX);
+			if (regmap_cnt < REGMAP_MAX)
+				regmap[regmap_cnt++] = n;
+		}
+	}
+}
+
+void regmap_init(struct scpi_tree const* tree)
+{
+	regmap_tree = tree;
+	regmap_cnt = 0;
+	regmap_scan(tree->star_nodes);
+	regmap_scan(tree->colon_nodes);
+}
+
+unsigned regmap_count(void)
+{
+	return regmap_cnt;
+}
+
+unsigned regmap_access(unsigned i)
+{
+	return i < regmap_cnt ? scpi_value_access(regmap[i]) : 0;
+}
+
+uint32_t regmap_get(unsigned i)
+{
+	uint32_t v = 0;
+	if (i < regmap_cnt && scpi_value_get(regmap[i], &v))
+		v = 0;
+	return v;
+}
+
+err_t regmap_set(unsigned i, uint32_t v)
+{
+	if (i >= regmap_cnt)
+		return err_param;
+	return scpi_value_set(regmap[i], v);
+}
+
+// Find the path to the node. The path is built in reverse order while unwinding.
+static unsigned regmap_find(struct scpi_node const* dir, struct scpi_node const* node, char* buf, unsigned sz, unsigned len)
+{
+	struct scpi_node const* n;
+	for (n = dir; n->name; ++n) {
+		unsigned const l = strlen(n->name);
+		unsigned end = 0;
+		if (len + 1 + l > sz)
+			continue;
+		if (n == node)
+			end = len + 1 + l;
+		else if (n->dir)
+			end = regmap_find(n->dir, node, buf, sz, len + 1 + l);
+		if (end) {
+			buf[len] = ':';
+			memcpy(buf + len + 1, n->name, l);
+			return end;
+		}
+	}
+	return 0;
+}
+
+unsigned regmap_path(unsigned i, char* buf, unsigned sz)
+{
+	unsigned len;
+	if (i >= regmap_cnt)
+		return 0;
+	if ((len = regmap_find(regmap_tree->colon_nodes, regmap[i], buf, sz, 0)))
+		return len;
+	// The star nodes path starts with asterisk instead of colon
+	if ((len = regmap_find(regmap_tree->star_nodes, regmap[i], buf, sz, 0)))
+		buf[0] = '*';
+	return len;
+}
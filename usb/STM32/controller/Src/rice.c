@@ -0,0 +1,137 @@
+#include "rice.h"
+#include <string.h>
+#include <stdbool.h>
+
+#if defined(__ICCARM__)
+#include <intrinsics.h>
+#define clz32(x) __CLZ(x)
+#else
+#define clz32(x) __builtin_clz(x)
+#endif
+
+static inline uint16_t zigzag(uint16_t d)
+{
+	return (uint16_t)(d << 1) ^ (uint16_t)-(d >> 15);
+}
+
+static inline uint16_t unzigzag(uint16_t u)
+{
+	return (u >> 1) ^ (uint16_t)-(u & 1);
+}
+
+struct bit_writer {
+	uint16_t* out;
+	unsigned  len;
+	unsigned  max;
+	uint32_t  acc;  /* the pending bits are the low ones */
+	unsigned  bits; /* less than 16 between calls */
+};
+
+// Put n <= 16 bits
+static inline bool put_bits(struct bit_writer* w, uint32_t v, unsigned n)
+{
+	w->acc = (w->acc << n) | v;
+	w->bits += n;
+	if (w->bits >= 16) {
+		if (w->len >= w->max)
+			return false;
+		w->bits -= 16;
+		w->out[w->len++] = w->acc >> w->bits;
+	}
+	return true;
+}
+
+unsigned rice_encode(uint16_t* prev, uint16_t const* in, unsigned n, uint16_t* out, unsigned max)
+{
+	struct bit_writer w = {.out = out, .max = max};
+	uint32_t sum = 0;
+	unsigned i, k;
+	bool ok;
+
+	for (i = 0; i < n; ++i)
+		sum += zigzag(in[i] - prev[i]);
+	for (k = 0; k < RICE_K_MAX && (n << k) < sum; ++k)
+		;
+	ok = put_bits(&w, k, RICE_K_BITS);
+	for (i = 0; ok && i < n; ++i) {
+		uint16_t const u = zigzag(in[i] - prev[i]);
+		unsigned const q = u >> k;
+		if (q < RICE_ESC) {
+			ok = put_bits(&w, (1 << (q + 1)) - 2, q + 1);
+			if (ok && k)
+				ok = put_bits(&w, u & ((1 << k) - 1), k);
+		} else
+			ok = put_bits(&w, (1 << RICE_ESC) - 1, RICE_ESC) && put_bits(&w, u, 16);
+	}
+	if (ok && w.bits)
+		ok = put_bits(&w, 0, 16 - w.bits);
+	memcpy(prev, in, n * sizeof(*prev));
+	return ok ? w.len : 0;
+}
+
+struct bit_reader {
+	uint16_t const* in;
+	unsigned        len;
+	unsigned        pos;
+	uint32_t        acc;  /* the bits are left aligned, the rest are zeros */
+	unsigned        bits;
+};
+
+static inline void refill(struct bit_reader* r)
+{
+	while (r->bits <= 16 && r->pos < r->len) {
+		r->acc |= (uint32_t)r->in[r->pos++] << (16 - r->bits);
+		r->bits += 16;
+	}
+}
+
+static inline void skip_bits(struct bit_reader* r, unsigned n)
+{
+	r->acc <<= n;
+	r->bits -= n;
+}
+
+// Get 0 < n <= 16 bits, the caller checks there are enough
+static inline uint32_t get_bits(struct bit_reader* r, unsigned n)
+{
+	uint32_t const v = r->acc >> (32 - n);
+	skip_bits(r, n);
+	return v;
+}
+
+// The unary quotient is counted at once by CLZ instead of bit by bit
+unsigned rice_decode(uint16_t* prev, uint16_t const* in, unsigned len, uint16_t* out, unsigned n)
+{
+	struct bit_reader r = {.in = in, .len = len};
+	unsigned i, k, used;
+
+	refill(&r);
+	if (r.bits < RICE_K_BITS)
+		return 0;
+	k = get_bits(&r, RICE_K_BITS);
+	for (i = 0; i < n; ++i) {
+		uint32_t u;
+		refill(&r);
+		if ((~r.acc >> (32 - RICE_ESC)) == 0) {
+			// escape
+			if (r.bits < RICE_ESC + 16)
+				return 0;
+			skip_bits(&r, RICE_ESC);
+			u = get_bits(&r, 16);
+		} else {
+			unsigned const q = clz32(~r.acc);
+			if (r.bits < q + 1 + k)
+				return 0;
+			skip_bits(&r, q + 1);
+			u = q << k;
+			if (k)
+				u |= get_bits(&r, k);
+		}
+		out[i] = prev[i] + unzigzag(u);
+	}
+	used = (r.pos * 16 - r.bits + 15) / 16;
+	if (used != len)
+		return 0;
+	memcpy(prev, out, n * sizeof(*prev));
+	return used;
+}
@@ -7,6 +7,7 @@
 #include "cli.h"
 #include "str_util.h"
 #include <stddef.h>
+#include <string.h>
 
 static inline int scpi_parse_node_value(const char* str, unsigned sz, struct scpi_node const* node)
 {
@@ -26,14 +27,24 @@ static inline int scpi_parse_node_value(const char* str, unsigned sz, struct scp
 	return rc;
 }
 
+// Put the concatenation of two strings to the response
+static err_t scpi_put_str2(const char* s1, const char* s2)
+{
+	err_t const err = cli_put_str(s1);
+	return err ? err : cli_put_str(s2);
+}
+
 static inline err_t scpi_help_value(struct scpi_node const* node)
 {
+	err_t err;
 	if (node->dir)
-		return cli_printf("%s is not a value", node->name);
-	if (!node->help)
-		return cli_printf("value %s has no help", node->name);
-	else
-		return cli_printf("%s%s", node->name, node->help);
+		return scpi_put_str2(node->name, " is not a value");
+	if (!node->help) {
+		if ((err = cli_put_str("value ")))
+			return err;
+		return scpi_put_str2(node->name, " has no help");
+	} else
+		return scpi_put_str2(node->name, node->help);
 }
 
 static err_t scpi_list_dir(struct scpi_node const* node, struct scpi_tree const* tree)
@@ -42,7 +53,10 @@ static err_t scpi_list_dir(struct scpi_node const* node, struct scpi_tree const*
 	struct scpi_node const *n = NULL;
 	unsigned const not_enabled = ~tree->enabled;
 
-	if (node->help && (err = cli_printf("%s%s\n", node->name, node->help)))
+	if (node->help && (
+		(err = scpi_put_str2(node->name, node->help)) ||
+		(err = cli_put("\n", 1))
+	))
 		return err;
 
 	for (n = node->dir; n->name; ++n) {
@@ -50,21 +64,122 @@ static err_t scpi_list_dir(struct scpi_node const* node, struct scpi_tree const*
 			continue;
 		if (n->disabled & not_enabled)
 			continue;
-		if ((err = cli_printf("%s", n->name))
-			|| (n->dir && (err = cli_printf(":")))
-			|| (err = cli_printf(" "))
+		if ((err = cli_put_str(n->name))
+			|| (n->dir && (err = cli_put(":", 1)))
+			|| (err = cli_put(" ", 1))
 		)
 			return err;
 	}
 	return err_ok;
 }
 
-static int scpi_parse_node(const char* str, unsigned sz, struct scpi_node const* node, bool help_mode, struct scpi_tree const* tree)
+static inline char scpi_upper(char c)
+{
+	return 'a' <= c && c <= 'z' ? c - 'a' + 'A' : c;
+}
+
+static inline bool scpi_is_alpha(char c)
+{
+	return ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z');
+}
+
+// Lookup subnode using the generated trie. The trie yields the dir entries whose
+// short or long name form matches the input. The first enabled one is chosen so
+// the result is the same as the linear lookup by scpi_match() would give.
+static unsigned scpi_index_lookup(const char* str, unsigned sz, struct scpi_node const* node, unsigned not_enabled, struct scpi_node const** found)
+{
+	struct scpi_trie const* const trie = node->index->trie;
+	struct scpi_node const* best = NULL;
+	unsigned i, depth = 0, matched = 0;
+
+	for (i = trie[0].child; i && depth < sz; i = trie[i].child) {
+		char const c = scpi_upper(str[depth]);
+		while (i && trie[i].ch != c)
+			i = trie[i].next;
+		if (!i)
+			break;
+		++depth;
+		// The name must not be followed by letters
+		if (trie[i].accept && (depth == sz || !scpi_is_alpha(str[depth]))) {
+			uint32_t accept = trie[i].accept;
+			struct scpi_node const* n = node->dir;
+			for (; accept && (!best || n < best); ++n, accept >>= 1) {
+				if ((accept & 1) && !(n->disabled & not_enabled)) {
+					best = n;
+					matched = depth;
+					break;
+				}
+			}
+		}
+	}
+	*found = best;
+	return matched;
+}
+
+static bool scpi_index_valid(struct scpi_node const* dir, struct scpi_index const* index)
+{
+	struct scpi_node const* n;
+	const char* names = index->names;
+	unsigned cnt = 0;
+
+	for (n = dir; n->name; ++n, ++cnt) {
+		unsigned const len = strlen(n->name);
+		if (strncmp(names, n->name, len))
+			return false;
+		names += len;
+		if (*names == ' ')
+			++names;
+		else if (*names)
+			return false;
+	}
+	return cnt == index->count && cnt <= 32 && !*names;
+}
+
+static bool scpi_index_check(struct scpi_node const* dir, struct scpi_index const* index)
+{
+	struct scpi_node const* n;
+
+	if (index && !scpi_index_valid(dir, index))
+		return false;
+	for (n = dir; n->name; ++n) {
+		if (n->dir && !scpi_index_check(n->dir, n->index))
+			return false;
+	}
+	return true;
+}
+
+bool scpi_index_init(struct scpi_tree* tree)
+{
+	tree->indexed =
+		scpi_index_check(tree->star_nodes, tree->star_index) &&
+		scpi_index_check(tree->colon_nodes, tree->colon_index);
+	return tree->indexed;
+}
+
+// Lookup subnode of the given node. Returns the number of characters matched or 0 if not found.
+static unsigned scpi_lookup(const char* str, unsigned sz, struct scpi_node const* node, struct scpi_tree const* tree, struct scpi_node const** found)
+{
+	unsigned matched = 0;
+	struct scpi_node const *n;
+	unsigned const not_enabled = ~tree->enabled;
+	if (tree->indexed && node->index)
+		return scpi_index_lookup(str, sz, node, not_enabled, found);
+	for (n = node->dir; n->name; ++n) {
+		if (n->disabled & not_enabled)
+			continue;
+		if ((matched = scpi_match(str, sz, n->name)))
+			break;
+	}
+	*found = n;
+	return matched;
+}
+
+static int scpi_parse_node(const char* str, unsigned sz, struct scpi_node const* node, bool help_mode, struct scpi_tree const* tree, struct scpi_node const** top)
 {
 	unsigned const sz_in = sz;
 	if (!node->dir) {
 		if (help_mode)
-			return cli_printf("%s is a value", node->name);
+			return scpi_put_str2(node->name, " is a value");
 		return -err_cmd;
 	}
 
@@ -78,25 +193,19 @@ static int scpi_parse_node(const char* str, unsigned sz, struct scpi_node const*
 	while (sz && *str != ':' && *str != '*')
 	{
 		int rc = 0;
-		unsigned matched_subnode = 0;
 		struct scpi_node const *n = NULL;
-		unsigned const not_enabled = ~tree->enabled;
-		// Lookup subnode
-		for (n = node->dir; n->name; ++n) {
-			if (n->disabled & not_enabled)
-				continue;
-			if ((matched_subnode = scpi_match(str, sz, n->name)))
-				break;
-		}
+		unsigned const matched_subnode = scpi_lookup(str, sz, node, tree, &n);
 		if (!matched_subnode)
 			return -err_cmd;			
+		if (top && !*top)
+			*top = n;
 		// Parse subnode
 		str += matched_subnode;
 		sz  -= matched_subnode;
 		if (sz && *str == ':') {
 			++str;
 			--sz;
-			rc = scpi_parse_node(str, sz, n, help_mode, tree);
+			rc = scpi_parse_node(str, sz, n, help_mode, tree, NULL);
 		} else if (help_mode) {
 			if (!sz) {
 				err_t const err = scpi_help_value(n);
@@ -131,13 +240,13 @@ static int scpi_parse_node(const char* str, unsigned sz, struct scpi_node const*
 
 static inline err_t scpi_default_help(void)
 {
-	return cli_printf("use\n?* or ?: to list top level tags,\n?<path>: to list tags rooting at given path,\n?<path>  to get help about particular parameter");
+	return cli_put_str("use\n?* or ?: to list top level tags,\n?<path>: to list tags rooting at given path,\n?<path>  to get help about particular parameter");
 }
 
-err_t scpi_parse(const char* str, unsigned sz, struct scpi_tree const* tree)
+err_t scpi_parse(const char* str, unsigned sz, struct scpi_tree const* tree, struct scpi_node const** top)
 {
-	struct scpi_node star_root  = {NULL, tree->star_nodes, NULL};
-	struct scpi_node colon_root = {NULL, tree->colon_nodes, NULL};
+	struct scpi_node star_root  = {NULL, tree->star_nodes, NULL, .index = tree->star_index};
+	struct scpi_node colon_root = {NULL, tree->colon_nodes, NULL, .index = tree->colon_index};
 	struct scpi_node const* root = &colon_root;
 	bool help_mode = false;
 
@@ -166,7 +275,7 @@ err_t scpi_parse(const char* str, unsigned sz, struct scpi_tree const* tree)
 			--sz;
 			break;
 		}
-		int rc = scpi_parse_node(str, sz, root, help_mode, tree);
+		int rc = scpi_parse_node(str, sz, root, help_mode, tree, top);
 		if (rc < 0)
 			return (err_t)(-rc);
 		if (rc > sz)
@@ -178,6 +287,83 @@ err_t scpi_parse(const char* str, unsigned sz, struct scpi_tree const* tree)
         return err_ok;
 }
 
+struct scpi_node const* scpi_find(const char* str, unsigned sz, struct scpi_tree const* tree)
+{
+	struct scpi_node const star_root  = {NULL, tree->star_nodes, NULL, .index = tree->star_index};
+	struct scpi_node const colon_root = {NULL, tree->colon_nodes, NULL, .index = tree->colon_index};
+	struct scpi_node const* node = &colon_root;
+
+	if (sz && (*str == '*' || *str == ':')) {
+		if (*str == '*')
+			node = &star_root;
+		++str;
+		--sz;
+	}
+	for (;;) {
+		struct scpi_node const* n = NULL;
+		unsigned matched;
+		if (!node->dir || !(matched = scpi_lookup(str, sz, node, tree, &n)))
+			return NULL;
+		str += matched;
+		sz  -= matched;
+		if (!sz)
+			return n;
+		if (*str != ':')
+			return NULL;
+		++str;
+		--sz;
+		node = n;
+	}
+}
+
+int scpi_scan_block(const char* str, unsigned sz, uint8_t const** data, unsigned* len)
+{
+	unsigned const skip = skip_spaces(str, sz);
+	unsigned digits, i, l = 0;
+	str += skip;
+	sz  -= skip;
+
+	if (sz < 2 || str[0] != SCPI_BLOCK_TAG)
+		return -err_param;
+	if (str[1] < '1' || str[1] > '9')
+		return -err_param;
+	digits = str[1] - '0';
+	if (sz < 2 + digits)
+		return -err_param;
+	for (i = 0; i < digits; ++i) {
+		char const c = str[2 + i];
+		if (c < '0' || c > '9')
+			return -err_param;
+		l = l * 10 + c - '0';
+	}
+	if (l > sz - 2 - digits)
+		return -err_param;
+	*data = (uint8_t const*)str + 2 + digits;
+	*len = l;
+	return skip + 2 + digits + l;
+}
+
+err_t scpi_put_block_hdr(unsigned len)
+{
+	char hdr[2 + SCPI_BLOCK_MAX_DIGITS];
+	unsigned digits = 1, i, v;
+	for (v = len; v >= 10; v /= 10)
+		++digits;
+	hdr[0] = SCPI_BLOCK_TAG;
+	hdr[1] = '0' + digits;
+	for (i = digits, v = len; i; --i, v /= 10)
+		hdr[1 + i] = '0' + v % 10;
+	return cli_put(hdr, 2 + digits);
+}
+
+err_t scpi_put_block(void const* data, unsigned len)
+{
+	err_t const err = scpi_put_block_hdr(len);
+	if (err)
+		return err;
+	return cli_put((char const*)data, len);
+}
+
 //
 // Generic value handlers
 //
@@ -198,7 +384,7 @@ int scpi_u16_r_handler(const char* str, unsigned sz, struct scpi_node const* n)
 	if (sz != 1 || *str != '?')
 		return -err_cmd;
 
-	err_t const err = cli_printf("%u", *(uint16_t const*)n->param);
+	err_t const err = cli_put_u(*(uint16_t const*)n->param, 0);
 	if (err)
 		return -err;
 	return sz;
@@ -230,7 +416,7 @@ int scpi_u32_r_handler(const char* str, unsigned sz, struct scpi_node const* n)
 	if (sz != 1 || *str != '?')
 		return -err_cmd;
 
-	err_t const err = cli_printf("%u", *(uint32_t const*)n->param);
+	err_t const err = cli_put_u(*(uint32_t const*)n->param, 0);
 	if (err)
 		return -err;
 	return sz;
@@ -262,7 +448,7 @@ int scpi_bool_r_handler(const char* str, unsigned sz, struct scpi_node const* n)
 	if (sz != 1 || *str != '?')
 		return -err_cmd;
 
-	err_t const err = cli_printf("%d", *(bool const*)n->param ? 1 : 0);
+	err_t const err = cli_put_bool(*(bool const*)n->param);
 	if (err)
 		return -err;
 	return sz;
@@ -310,7 +496,7 @@ int scpi_bool_r_handler2(const char* str, unsigned sz, struct scpi_node const* n
 	if (sz != 1 || *str != '?')
 		return -err_cmd;
 
-	err_t const err = cli_printf("%d", ((bool_get_fn)n->param)() ? 1 : 0);
+	err_t const err = cli_put_bool(((bool_get_fn)n->param)());
 	if (err)
 		return -err;
 	return sz;
@@ -341,3 +527,57 @@ int scpi_bool_w_handler2(const char* str, unsigned sz, struct scpi_node const* n
 
 	return -err_cmd;
 }
+
+//
+// Typed access to the values of the nodes served by generic handlers
+//
+
+unsigned scpi_value_access(struct scpi_node const* n)
+{
+	scpi_handler_t const h = n->handler;
+	if (h == scpi_u16_rw_handler || h == scpi_u32_rw_handler || h == scpi_bool_rw_handler || h == scpi_bool_rw_handler2)
+		return SCPI_VAL_R | SCPI_VAL_W;
+	if (h == scpi_u16_r_handler || h == scpi_u32_r_handler || h == scpi_bool_r_handler || h == scpi_bool_r_handler2)
+		return SCPI_VAL_R;
+	if (h == scpi_u16_w_handler || h == scpi_u32_w_handler || h == scpi_bool_w_handler || h == scpi_bool_w_handler2)
+		return SCPI_VAL_W;
+	return 0;
+}
+
+err_t scpi_value_get(struct scpi_node const* n, uint32_t* v)
+{
+	scpi_handler_t const h = n->handler;
+	if (h == scpi_u16_rw_handler || h == scpi_u16_r_handler)
+		*v = *(uint16_t const*)n->param;
+	else if (h == scpi_u32_rw_handler || h == scpi_u32_r_handler)
+		*v = *(uint32_t const*)n->param;
+	else if (h == scpi_bool_rw_handler || h == scpi_bool_r_handler)
+		*v = *(bool const*)n->param;
+	else if (h == scpi_bool_rw_handler2 || h == scpi_bool_r_handler2)
+		*v = ((bool_get_fn)n->param)();
+	else
+		return err_cmd;
+	return err_ok;
+}
+
+err_t scpi_value_set(struct scpi_node const* n, uint32_t v)
+{
+	scpi_handler_t const h = n->handler;
+	if (h == scpi_u16_rw_handler || h == scpi_u16_w_handler) {
+		if (v > (uint16_t)~0)
+			return err_param;
+		*(uint16_t*)n->param = v;
+	} else if (h == scpi_u32_rw_handler || h == scpi_u32_w_handler)
+		*(uint32_t*)n->param = v;
+	else if (h == scpi_bool_rw_handler || h == scpi_bool_w_handler) {
+		if (v > 1)
+			return err_param;
+		*(bool*)n->param = v;
+	} else if (h == scpi_bool_rw_handler2 || h == scpi_bool_w_handler2) {
+		if (v > 1)
+			return err_param;
+		((bool_set_fn)n->param2)(v);
+	} else
+		return err_cmd;
+	return err_ok;
+}
@@ -0,0 +1,411 @@
+/*
+ * SCPI node lookup indexes
+ * Generated by tools/scpi_index.py - do not edit
+ */
+
+#include "scpi_index.h"
+
+static const struct scpi_trie acq_compress_nodes_trie[] = {
+	{'\0', 0, 1, 0x0},
+	{'E', 7, 2, 0x0},
+	{'N', 0, 3, 0x0},
+	{'A', 0, 4, 0x0},
+	{'B', 0, 5, 0x1},
+	{'L', 0, 6, 0x0},
+	{'E', 0, 0, 0x1},
+	{'B', 0, 8, 0x0},
+	{'E', 0, 9, 0x0},
+	{'N', 0, 10, 0x0},
+	{'C', 0, 11, 0x2},
+	{'H', 0, 12, 0x0},
+	{'M', 0, 13, 0x0},
+	{'A', 0, 14, 0x0},
+	{'R', 0, 15, 0x0},
+	{'K', 0, 0, 0x2},
+};
+
+const struct scpi_index acq_compress_nodes_index = {
+	2,
+	"ENABle BENChmark",
+	acq_compress_nodes_trie
+};
+
+static const struct scpi_trie acq_nodes_trie[] = {
+	{'\0', 0, 1, 0x0},
+	{'A', 7, 2, 0x0},
+	{'C', 21, 3, 0x0},
+	{'T', 0, 4, 0x1},
+	{'I', 0, 5, 0x0},
+	{'V', 0, 6, 0x0},
+	{'E', 0, 0, 0x1},
+	{'R', 11, 8, 0x0},
+	{'A', 19, 9, 0x0},
+	{'T', 0, 10, 0x0},
+	{'E', 0, 0, 0x2},
+	{'C', 34, 12, 0x0},
+	{'H', 27, 13, 0x0},
+	{'A', 0, 14, 0x0},
+	{'N', 0, 15, 0x4},
+	{'N', 0, 16, 0x0},
+	{'E', 0, 17, 0x0},
+	{'L', 0, 18, 0x0},
+	{'S', 0, 0, 0x4},
+	{'O', 0, 20, 0x0},
+	{'I', 0, 0, 0x8},
+	{'V', 0, 22, 0x0},
+	{'E', 0, 23, 0x0},
+	{'R', 0, 24, 0x10},
+	{'A', 0, 25, 0x0},
+	{'G', 0, 26, 0x0},
+	{'E', 0, 0, 0x10},
+	{'O', 0, 28, 0x0},
+	{'M', 0, 29, 0x0},
+	{'P', 0, 30, 0x20},
+	{'R', 0, 31, 0x0},
+	{'E', 0, 32, 0x0},
+	{'S', 0, 33, 0x0},
+	{'S', 0, 0, 0x20},
+	{'F', 40, 35, 0x0},
+	{'R', 0, 36, 0x0},
+	{'A', 0, 37, 0x0},
+	{'M', 0, 38, 0x40},
+	{'E', 0, 39, 0x0},
+	{'S', 0, 0, 0x40},
+	{'L', 44, 41, 0x0},
+	{'O', 0, 42, 0x0},
+	{'S', 0, 43, 0x0},
+	{'T', 0, 0, 0x80},
+	{'O', 0, 45, 0x0},
+	{'V', 0, 46, 0x0},
+	{'E', 0, 47, 0x0},
+	{'R', 0, 48, 0x100},
+	{'R', 0, 49, 0x0},
+	{'U', 0, 50, 0x0},
+	{'N', 0, 51, 0x0},
+	{'S', 0, 0, 0x100},
+};
+
+const struct scpi_index acq_nodes_index = {
+	9,
+	"ACTive RATE CHANnels ROI AVERage COMPress FRAMes LOST OVERruns",
+	acq_nodes_trie
+};
+
+static const struct scpi_trie colon_nodes_trie[] = {
+	{'\0', 0, 1, 0x0},
+	{'S', 7, 2, 0x0},
+	{'Y', 0, 3, 0x0},
+	{'S', 0, 4, 0x0},
+	{'T', 0, 5, 0x1},
+	{'E', 0, 6, 0x0},
+	{'M', 0, 0, 0x1},
+	{'A', 14, 8, 0x0},
+	{'C', 0, 9, 0x0},
+	{'Q', 0, 10, 0x2},
+	{'U', 0, 11, 0x0},
+	{'I', 0, 12, 0x0},
+	{'R', 0, 13, 0x0},
+	{'E', 0, 0, 0x2},
+	{'T', 0, 15, 0x0},
+	{'E', 0, 16, 0x0},
+	{'S', 0, 17, 0x0},
+	{'T', 0, 0, 0x4},
+};
+
+const struct scpi_index colon_nodes_index = {
+	3,
+	"SYSTem ACQuire TEST",
+	colon_nodes_trie
+};
+
+static const struct scpi_trie diag_nodes_trie[] = {
+	{'\0', 0, 1, 0x0},
+	{'T', 6, 2, 0x0},
+	{'R', 0, 3, 0x0},
+	{'A', 0, 4, 0x0},
+	{'C', 0, 5, 0x1},
+	{'E', 0, 0, 0x1},
+	{'F', 10, 7, 0x0},
+	{'I', 0, 8, 0x0},
+	{'L', 0, 9, 0x0},
+	{'L', 0, 0, 0x2},
+	{'S', 14, 11, 0x0},
+	{'E', 0, 12, 0x0},
+	{'N', 0, 13, 0x0},
+	{'T', 0, 0, 0x4},
+	{'L', 0, 15, 0x0},
+	{'O', 0, 16, 0x0},
+	{'S', 0, 17, 0x0},
+	{'T', 0, 0, 0x8},
+};
+
+const struct scpi_index diag_nodes_index = {
+	4,
+	"TRACe FILL SENT LOST",
+	diag_nodes_trie
+};
+
+static const struct scpi_trie evt_nodes_trie[] = {
+	{'\0', 0, 1, 0x0},
+	{'E', 0, 2, 0x0},
+	{'N', 7, 3, 0x0},
+	{'A', 0, 4, 0x0},
+	{'B', 0, 5, 0x1},
+	{'L', 0, 6, 0x0},
+	{'E', 0, 0, 0x1},
+	{'R', 0, 8, 0x0},
+	{'R', 0, 9, 0x0},
+	{'L', 0, 10, 0x2},
+	{'I', 0, 11, 0x0},
+	{'M', 0, 12, 0x0},
+	{'I', 0, 13, 0x0},
+	{'T', 0, 0, 0x2},
+};
+
+const struct scpi_index evt_nodes_index = {
+	2,
+	"ENABle ERRLimit",
+	evt_nodes_trie
+};
+
+static const struct scpi_trie fx2_nodes_trie[] = {
+	{'\0', 0, 1, 0x0},
+	{'R', 6, 2, 0x0},
+	{'E', 0, 3, 0x0},
+	{'S', 0, 4, 0x1},
+	{'E', 0, 5, 0x0},
+	{'T', 0, 0, 0x1},
+	{'H', 8, 7, 0x0},
+	{'S', 0, 0, 0x2},
+	{'F', 12, 9, 0x0},
+	{'U', 0, 10, 0x0},
+	{'L', 0, 11, 0x0},
+	{'L', 0, 0, 0x4},
+	{'A', 17, 13, 0x0},
+	{'F', 0, 14, 0x0},
+	{'U', 0, 15, 0x0},
+	{'L', 0, 16, 0x0},
+	{'L', 0, 0, 0x8},
+	{'E', 0, 18, 0x0},
+	{'E', 0, 19, 0x0},
+	{'P', 0, 20, 0x0},
+	{'R', 0, 21, 0x10},
+	{'O', 0, 22, 0x0},
+	{'M', 0, 0, 0x10},
+};
+
+const struct scpi_index fx2_nodes_index = {
+	5,
+	"RESet HS FULL AFULL EEPRom",
+	fx2_nodes_trie
+};
+
+static const struct scpi_trie i2c_eeprom_nodes_trie[] = {
+	{'\0', 0, 1, 0x0},
+	{'W', 3, 2, 0x0},
+	{'R', 0, 5, 0x1},
+	{'R', 15, 4, 0x0},
+	{'D', 0, 10, 0x2},
+	{'B', 0, 6, 0x4},
+	{'L', 0, 7, 0x0},
+	{'O', 0, 8, 0x0},
+	{'C', 0, 9, 0x0},
+	{'K', 0, 0, 0x4},
+	{'B', 0, 11, 0x8},
+	{'L', 0, 12, 0x0},
+	{'O', 0, 13, 0x0},
+	{'C', 0, 14, 0x0},
+	{'K', 0, 0, 0x8},
+	{'D', 0, 16, 0x0},
+	{'U', 0, 17, 0x0},
+	{'M', 0, 18, 0x0},
+	{'P', 0, 0, 0x10},
+};
+
+const struct scpi_index i2c_eeprom_nodes_index = {
+	5,
+	"WR RD WRBlock RDBlock DUMP",
+	i2c_eeprom_nodes_trie
+};
+
+static const struct scpi_trie reset_nodes_trie[] = {
+	{'\0', 0, 1, 0x0},
+	{'L', 0, 2, 0x0},
+	{'O', 0, 3, 0x0},
+	{'A', 0, 4, 0x0},
+	{'D', 0, 5, 0x1},
+	{'E', 0, 6, 0x0},
+	{'R', 0, 0, 0x1},
+};
+
+const struct scpi_index reset_nodes_index = {
+	1,
+	"LOADer",
+	reset_nodes_trie
+};
+
+static const struct scpi_trie star_nodes_trie[] = {
+	{'\0', 0, 1, 0x0},
+	{'I', 0, 2, 0x0},
+	{'D', 0, 3, 0x0},
+	{'N', 0, 0, 0x1},
+};
+
+const struct scpi_index star_nodes_index = {
+	1,
+	"IDN",
+	star_nodes_trie
+};
+
+static const struct scpi_trie stat_nodes_trie[] = {
+	{'\0', 0, 1, 0x0},
+	{'C', 9, 2, 0x0},
+	{'O', 29, 3, 0x0},
+	{'M', 0, 4, 0x0},
+	{'M', 0, 5, 0x1},
+	{'A', 0, 6, 0x0},
+	{'N', 0, 7, 0x0},
+	{'D', 0, 8, 0x0},
+	{'S', 0, 0, 0x1},
+	{'E', 15, 10, 0x0},
+	{'R', 0, 11, 0x0},
+	{'R', 0, 12, 0x2},
+	{'O', 0, 13, 0x0},
+	{'R', 0, 14, 0x0},
+	{'S', 0, 0, 0x2},
+	{'H', 24, 16, 0x0},
+	{'I', 0, 17, 0x0},
+	{'S', 0, 18, 0x0},
+	{'T', 0, 19, 0x4},
+	{'O', 0, 20, 0x0},
+	{'G', 0, 21, 0x0},
+	{'R', 0, 22, 0x0},
+	{'A', 0, 23, 0x0},
+	{'M', 0, 0, 0x4},
+	{'R', 0, 25, 0x0},
+	{'E', 0, 26, 0x0},
+	{'S', 0, 27, 0x8},
+	{'E', 0, 28, 0x0},
+	{'T', 0, 0, 0x8},
+	{'L', 0, 30, 0x0},
+	{'O', 0, 31, 0x0},
+	{'C', 0, 32, 0x10},
+	{'K', 0, 0, 0x10},
+};
+
+const struct scpi_index stat_nodes_index = {
+	5,
+	"COMMands ERRors HISTogram RESet CLOCk",
+	stat_nodes_trie
+};
+
+static const struct scpi_trie system_nodes_trie[] = {
+	{'\0', 0, 1, 0x0},
+	{'V', 8, 2, 0x0},
+	{'E', 0, 3, 0x0},
+	{'R', 0, 4, 0x0},
+	{'S', 0, 5, 0x1},
+	{'I', 0, 6, 0x0},
+	{'O', 0, 7, 0x0},
+	{'N', 0, 0, 0x1},
+	{'R', 13, 9, 0x0},
+	{'E', 0, 10, 0x0},
+	{'S', 0, 11, 0x2},
+	{'E', 0, 12, 0x0},
+	{'T', 0, 0, 0x2},
+	{'C', 19, 14, 0x0},
+	{'O', 0, 15, 0x0},
+	{'N', 0, 16, 0x0},
+	{'F', 0, 17, 0x4},
+	{'I', 0, 18, 0x0},
+	{'G', 0, 0, 0x4},
+	{'F', 22, 20, 0x0},
+	{'X', 0, 21, 0x0},
+	{'2', 0, 0, 0x8},
+	{'E', 28, 23, 0x0},
+	{'V', 0, 24, 0x0},
+	{'E', 0, 25, 0x0},
+	{'N', 0, 26, 0x10},
+	{'T', 0, 27, 0x0},
+	{'S', 0, 0, 0x10},
+	{'S', 38, 29, 0x0},
+	{'T', 0, 30, 0x0},
+	{'A', 0, 31, 0x0},
+	{'T', 0, 32, 0x20},
+	{'I', 0, 33, 0x0},
+	{'S', 0, 34, 0x0},
+	{'T', 0, 35, 0x0},
+	{'I', 0, 36, 0x0},
+	{'C', 0, 37, 0x0},
+	{'S', 0, 0, 0x20},
+	{'D', 0, 39, 0x0},
+	{'I', 0, 40, 0x0},
+	{'A', 0, 41, 0x0},
+	{'G', 0, 42, 0x40},
+	{'N', 0, 43, 0x0},
+	{'O', 0, 44, 0x0},
+	{'S', 0, 45, 0x0},
+	{'T', 0, 46, 0x0},
+	{'I', 0, 47, 0x0},
+	{'C', 0, 0, 0x40},
+};
+
+const struct scpi_index system_nodes_index = {
+	7,
+	"VERSion RESet CONFig FX2 EVENts STATistics DIAGnostic",
+	system_nodes_trie
+};
+
+static const struct scpi_trie test_fifo_nodes_trie[] = {
+	{'\0', 0, 1, 0x0},
+	{'S', 6, 2, 0x0},
+	{'T', 0, 3, 0x0},
+	{'A', 18, 4, 0x0},
+	{'T', 0, 5, 0x1},
+	{'E', 0, 0, 0x1},
+	{'A', 12, 7, 0x0},
+	{'C', 0, 8, 0x0},
+	{'T', 0, 9, 0x2},
+	{'I', 0, 10, 0x0},
+	{'V', 0, 11, 0x0},
+	{'E', 0, 0, 0x2},
+	{'P', 22, 13, 0x0},
+	{'A', 0, 14, 0x0},
+	{'U', 0, 15, 0x0},
+	{'S', 0, 16, 0x4},
+	{'E', 0, 17, 0x0},
+	{'D', 0, 0, 0x4},
+	{'R', 0, 19, 0x8},
+	{'E', 0, 20, 0x0},
+	{'A', 0, 21, 0x0},
+	{'M', 0, 0, 0x8},
+	{'W', 0, 23, 0x0},
+	{'O', 0, 24, 0x0},
+	{'R', 0, 25, 0x0},
+	{'D', 0, 26, 0x10},
+	{'S', 0, 0, 0x10},
+};
+
+const struct scpi_index test_fifo_nodes_index = {
+	5,
+	"STATe ACTive PAUSed STReam WORDs",
+	test_fifo_nodes_trie
+};
+
+static const struct scpi_trie test_nodes_trie[] = {
+	{'\0', 0, 1, 0x0},
+	{'F', 5, 2, 0x0},
+	{'I', 0, 3, 0x0},
+	{'F', 0, 4, 0x0},
+	{'O', 0, 0, 0x1},
+	{'E', 0, 6, 0x0},
+	{'C', 0, 7, 0x0},
+	{'H', 0, 8, 0x0},
+	{'O', 0, 0, 0x2},
+};
+
+const struct scpi_index test_nodes_index = {
+	2,
+	"FIFO ECHO",
+	test_nodes_trie
+};
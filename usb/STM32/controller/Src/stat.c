@@ -0,0 +1,143 @@
+#include "stat.h"
+#include "scpi.h"
+#include "cli.h"
+
+#include <string.h>
+
+// The number of top level nodes tracked separately, the rest share the last slot
+#define STAT_SLOTS 8
+
+struct stat_slot {
+	struct scpi_node const* node;
+	uint32_t                count;
+	uint32_t                max;
+	uint32_t                hist[STAT_BUCKETS];
+};
+
+static struct stat_slot stat_slots[STAT_SLOTS];
+static unsigned         stat_used;
+static bool             stat_overflow; /* the last slot is shared by several nodes */
+
+void stat_init(void)
+{
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+static struct stat_slot* stat_slot(struct scpi_node const* top)
+{
+	unsigned i;
+	for (i = 0; i < stat_used; ++i)
+		if (stat_slots[i].node == top)
+			return &stat_slots[i];
+	if (stat_used >= STAT_SLOTS) {
+		stat_overflow = true;
+		return &stat_slots[STAT_SLOTS - 1];
+	}
+	stat_slots[stat_used].node = top;
+	return &stat_slots[stat_used++];
+}
+
+void stat_record(struct scpi_node const* top, uint32_t cycles)
+{
+	struct stat_slot* const s = stat_slot(top);
+	unsigned const b = 32 - __CLZ(cycles);
+	++s->count;
+	if (cycles > s->max)
+		s->max = cycles;
+	++s->hist[b < STAT_BUCKETS ? b : STAT_BUCKETS - 1];
+}
+
+// Put NAME COUNT MAX H0,H1,.. omitting trailing empty buckets
+static err_t stat_put_slot(struct stat_slot const* s)
+{
+	err_t err;
+	unsigned i, n = STAT_BUCKETS;
+	char const* name = s->node ? s->node->name : "NONE";
+	if (stat_overflow && s == &stat_slots[STAT_SLOTS - 1])
+		name = "OTHER";
+	while (n > 1 && !s->hist[n - 1])
+		--n;
+	if ((err = cli_put_str(name)) ||
+		(err = cli_put(" ", 1)) ||
+		(err = cli_put_u(s->count, 0)) ||
+		(err = cli_put(" ", 1)) ||
+		(err = cli_put_u(s->max, 0)) ||
+		(err = cli_put(" ", 1))
+	)
+		return err;
+	for (i = 0; i < n; ++i) {
+		if ((i && (err = cli_put(",", 1))) || (err = cli_put_u(s->hist[i], 0)))
+			return err;
+	}
+	return err_ok;
+}
+
+static int stat_hist_handler(const char* str, unsigned sz, struct scpi_node const* n)
+{
+	unsigned i;
+	err_t err;
+	if (sz != 1 || *str != '?')
+		return -err_cmd;
+	for (i = 0; i < stat_used; ++i) {
+		if ((i && (err = cli_put("\n", 1))) || (err = stat_put_slot(&stat_slots[i])))
+			return -err;
+	}
+	return sz;
+}
+
+static int stat_reset_handler(const char* str, unsigned sz, struct scpi_node const* n)
+{
+	memset(stat_slots, 0, sizeof(stat_slots));
+	stat_used = 0;
+	stat_overflow = false;
+	return 0;
+}
+
+static int stat_clock_handler(const char* str, unsigned sz, struct scpi_node const* n)
+{
+	if (sz != 1 || *str != '?')
+		return -err_cmd;
+	err_t const err = cli_put_u(SystemCoreClock, 0);
+	if (err)
+		return -err;
+	return sz;
+}
+
+const struct scpi_node stat_nodes[] = {
+	{
+		"COMMands",
+		NULL,
+		scpi_u32_r_handler,
+		"? returns the number of commands processed successfully",
+		.param = &cli_cmd_total
+	},
+	{
+		"ERRors",
+		NULL,
+		scpi_u32_r_handler,
+		"? returns the number of commands failed",
+		.param = &cli_cmd_errors
+	},
+	{
+		"HISTogram",
+		NULL,
+		stat_hist_handler,
+		"? returns the line NAME COUNT MAX H0,H1,.. per top level node, where MAX is the max latency"
+		" in cycles, Hi is the number of commands completed in [2^(i-1), 2^i) cycles",
+	},
+	{
+		"RESet",
+		NULL,
+		stat_reset_handler,
+		" clears the statistics"
+	},
+	{
+		"CLOCk",
+		NULL,
+		stat_clock_handler,
+		"? returns the cycle counter frequency in Hz"
+	},
+	SCPI_NODE_END
+};
@@ -4,6 +4,7 @@
 #include "io_util.h"
 #include "version.h"
 #include "test.h"
+#include "events.h"
 
 #include <string.h>
 #include <intrinsics.h>
@@ -14,6 +15,22 @@ void Reboot_Loader(void);
 
 __no_init unsigned sys_reset_magic;
 
+extern TIM_HandleTypeDef htim2;
+
+uint16_t sys_cfg;
+
+static uint16_t sys_cfg_read(void)
+{
+	return
+		READ_PIN(CFG_CHAIN0)        |
+		READ_PIN(CFG_CHAIN1)   << 1 |
+		READ_PIN(CFG_CHAIN2)   << 2 |
+		(READ_PIN(CFG_WIDE) ? SYS_CFG_WIDE : 0) |
+		READ_PIN(CFG_MOD0)     << SYS_CFG_MOD_SHIFT |
+		READ_PIN(CFG_MOD1)     << (SYS_CFG_MOD_SHIFT + 1) |
+		READ_PIN(CFG_MOD2)     << (SYS_CFG_MOD_SHIFT + 2);
+}
+
 const __root struct version_tag sys_fw_version_tag @ FW_TAG_ADDR = VERSION_TAG_INI;
 
 /* Early stage initialization routine */
@@ -27,14 +44,28 @@ void sys_first_init(void)
 
 void sys_init(void)
 {
+	HAL_TIM_Base_Start(&htim2);
+	sys_cfg = sys_cfg_read();
 	test_init();
 	WRITE_PIN(ADS_RST, 0);
 	WRITE_PIN(FX_nRST, 1);
 }
 
+static bool sys_hs_link;
+
+// Notify host on FX2 high speed link status change
+static void sys_chk_hs_link(void)
+{
+	bool const hs = !READ_PIN(FX_nHS);
+	if (hs == sys_hs_link)
+		return;
+	sys_hs_link = hs;
+	evt_post(hs ? evt_hs_restored : evt_hs_lost, 0);
+}
+
 void sys_run(void)
 {
-	test_run();
+	sys_chk_hs_link();
 }
 
 void _sys_schedule_bootloader(void)
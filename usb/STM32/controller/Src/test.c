@@ -1,115 +1,98 @@
 #include "test.h"
 #include "main.h"
 #include "str_util.h"
-#include "io_util.h"
 #include "scpi.h"
 #include "cli.h"
+#include "fifo.h"
+#include "acq_core.h"
+#include "system.h"
 
 #include <stdbool.h>
+#include <string.h>
 
 #define hSPI hspi1
-#define SPI_BITS 16
-#define TX_BURST (256/SPI_BITS)
-#define TX_CHUNK (32/SPI_BITS)
 
-#define START_TAG0 0x8dbe
-#define START_TAG1 0x3ad6
+// The test frame length in words including header
+#define TEST_FRAME_LEN   256
+#define TEST_PAYLOAD_LEN (TEST_FRAME_LEN - ACQ_HDR_LEN)
 
+static uint16_t test_frame[TEST_FRAME_LEN];
+static unsigned test_pos; /* the next word of the test_frame to send */
+static uint32_t test_seq;
+static unsigned test_flags;
 static uint16_t next_sn;
-static uint16_t tx_buff[TX_BURST];
+static bool     stream_mode = false; /* use circular DMA on the next start */
 
-static bool test_active   = false;
-static bool start_request = false;
-static bool is_idle       = true;
+// The test data source: the frames with payload of the incrementing sequence numbers
 
-static void set_idle(bool flag)
+static void test_src_start(void)
 {
-	is_idle = flag;
-}
-
-static void test_start(void)
-{
-	test_active = start_request = true;
 	next_sn = 0;
+	test_seq = 0;
+	test_flags = ACQ_FL_TEST | ACQ_FL_START;
+	test_pos = TEST_FRAME_LEN;
 }
 
-static void test_stop(void)
+static void test_frame_next(void)
 {
-	test_active = false;
+	unsigned i;
+	for (i = ACQ_HDR_LEN; i < TEST_FRAME_LEN; ++i)
+		test_frame[i] = next_sn++;
+	acq_hdr_build(test_frame, test_seq++, sys_us(), test_flags, NULL, TEST_PAYLOAD_LEN);
+	test_flags = ACQ_FL_TEST;
+	test_pos = 0;
 }
 
-void test_init(void)
+static unsigned test_src_get(uint16_t const** data, unsigned max)
 {
-	// The SPI clock may remain at low level even though its configured as having high idle level.
-	// Sending dummy word fixes this problem. Note that both FX2 and SPI ADC should be reset at
-	// this point. They should be released from reset right after this call in sys_init() routine.
-	uint16_t dummy = 0;
-	HAL_SPI_Transmit(&hSPI, (uint8_t*)&dummy, 1, HAL_MAX_DELAY);
+	if (test_pos >= TEST_FRAME_LEN)
+		test_frame_next();
+	if (max > TEST_FRAME_LEN - test_pos)
+		max = TEST_FRAME_LEN - test_pos;
+	*data = test_frame + test_pos;
+	test_pos += max;
+	return max;
 }
 
-static void transmit_start(void)
+static void test_src_fill(uint16_t* buff, unsigned len)
 {
-	tx_buff[0] = START_TAG0;
-	tx_buff[1] = START_TAG1;
-	HAL_SPI_Transmit_DMA(&hSPI, (uint8_t*)tx_buff, 2);
+	uint16_t const* data;
+	while (len) {
+		unsigned const n = test_src_get(&data, len);
+		memcpy(buff, data, n * sizeof(*buff));
+		buff += n;
+		len  -= n;
+	}
 }
 
-static void transmit_next(uint8_t len)
+static const struct fifo_source test_src = {
+	.start = test_src_start,
+	.get   = test_src_get,
+	.fill  = test_src_fill,
+};
+
+static void test_start(void)
 {
-	for (uint8_t i = 0; i < len; ++i)
-		tx_buff[i] = next_sn++;
-	HAL_SPI_Transmit_DMA(&hSPI, (uint8_t*)tx_buff, len);
+	fifo_start(&test_src, stream_mode);
 }
 
-static inline void transmit_completed(void)
+static void test_stop(void)
 {
-	if (!test_active) {
-		// stop pending
-		set_idle(true);
-	} else if (start_request) {
-		// restart pending
-		set_idle(true);
-	} else if (READ_PIN(FX_nHS)) {
-		// not in HS mode
-		set_idle(true);
-	} else if (READ_PIN(FX_nAFULL)) {
-		// has room for the full burst
-		transmit_next(TX_BURST);
-	} else if (READ_PIN(FX_nFULL)) {
-		// almost full
-		transmit_next(TX_CHUNK);
-	} else // full
-		set_idle(true);
+	fifo_stop(&test_src);
 }
 
-void test_run(void)
+void test_init(void)
 {
-	if (!is_idle) {
-		if (hSPI.State == HAL_SPI_STATE_READY)
-			transmit_completed();
-		return;
-	}
-	if (!test_active)
-		return;
-	if (READ_PIN(FX_nHS))
-		return;
-	if (!READ_PIN(FX_nAFULL))
-		return;
-
-	set_idle(false);
-	if (start_request) {
-		start_request = false;
-		transmit_start();
-	} else
-		transmit_next(TX_BURST);
+	// The SPI clock may remain at low level even though its configured as having high idle level.
+	// Sending dummy word fixes this problem. Note that both FX2 and SPI ADC should be reset at
+	// this point. They should be released from reset right after this call in sys_init() routine.
+	uint16_t dummy = 0;
+	HAL_SPI_Transmit(&hSPI, (uint8_t*)&dummy, 1, HAL_MAX_DELAY);
 }
 
 static const char* test_state(void)
 {
-	if (!test_active)
-		return is_idle ? "STOPPED" : "STOPPING";
-	else
-		return is_idle ? "PAUSED" : "RUNNING";
+	return fifo_state(&test_src);
 }
 
 static int test_state_handler(const char* str, unsigned sz, struct scpi_node const* n)
@@ -118,7 +101,7 @@ static int test_state_handler(const char* str, unsigned sz, struct scpi_node con
 		return -err_cmd;
 
 	if (*str == '?') {
-		err_t const err = cli_printf("%s", test_state());
+		err_t const err = cli_put_str(test_state());
 		if (err)
 			return -err;
 		return sz;
@@ -140,6 +123,19 @@ static int test_state_handler(const char* str, unsigned sz, struct scpi_node con
 	return -err_cmd;
 }
 
+static bool test_active_get(void)
+{
+	return fifo_active(&test_src);
+}
+
+static void test_active_set(bool v)
+{
+	if (v)
+		test_start();
+	else
+		test_stop();
+}
+
 const struct scpi_node test_fifo_nodes[] = {
 	{
 		"STATe",
@@ -147,5 +143,34 @@ const struct scpi_node test_fifo_nodes[] = {
 		test_state_handler,
 		" (RUN|STOP) starts|stops FX2 FIFO test. STATe? returns its current state."
 	},
+	{
+		"ACTive",
+		NULL,
+		scpi_bool_rw_handler2,
+		"(0|1) stops|starts FX2 FIFO test. ACTive? returns 1 if it is started.",
+		.param  = (void*)test_active_get,
+		.param2 = (void*)test_active_set
+	},
+	{
+		"PAUSed",
+		NULL,
+		scpi_bool_r_handler,
+		"? returns 1 if the test is paused waiting for FX2 to accept data",
+		.param = (void*)&fifo_paused
+	},
+	{
+		"STReam",
+		NULL,
+		scpi_bool_rw_handler,
+		"(0|1) selects sending in bursts|continuous stream by circular DMA on the next test start. STReam? returns the current setting.",
+		.param = &stream_mode
+	},
+	{
+		"WORDs",
+		NULL,
+		scpi_u32_r_handler,
+		"? returns the number of data words sent to FX2 so far",
+		.param = &fifo_words
+	},
 	SCPI_NODE_END
 };
@@ -28,6 +28,7 @@
 #include "usbd_cdc_if.h"
 
 /* USER CODE BEGIN Includes */
+#include "usb_vendor.h"
 
 /* USER CODE END Includes */
 
@@ -65,7 +66,7 @@ USBD_HandleTypeDef hUsbDeviceFS;
 void MX_USB_DEVICE_Init(void)
 {
   /* USER CODE BEGIN USB_DEVICE_Init_PreTreatment */
-  
+  usb_vendor_init();
   /* USER CODE END USB_DEVICE_Init_PreTreatment */
   
   /* Init Device Library, add supported class and start the library. */
@@ -87,7 +88,7 @@ void MX_USB_DEVICE_Init(void)
   }
 
   /* USER CODE BEGIN USB_DEVICE_Init_PostTreatment */
-  
+  usb_vendor_fifo_init(&hUsbDeviceFS);
   /* USER CODE END USB_DEVICE_Init_PostTreatment */
 }
 
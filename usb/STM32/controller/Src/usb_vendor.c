@@ -0,0 +1,239 @@
+#include "usb_vendor.h"
+#include "usbd_cdc.h"
+#include "usbd_ctlreq.h"
+#include "usbd_ioreq.h"
+#include "regmap.h"
+#include "scpi.h"
+#include "diag.h"
+
+#include <string.h>
+
+/* The max length of VND_REG_INFO reply */
+#define VND_INFO_MAX 64
+
+/* The diagnostic stream interface following the CDC ones */
+#define VND_DIAG_ITF 2
+#define VND_NUM_ITF  3
+
+#define VND_IAD_LEN  8
+#define VND_DIAG_LEN (USB_LEN_IF_DESC + USB_LEN_EP_DESC)
+#define VND_CFG_LEN  (USB_CDC_CONFIG_DESC_SIZ + VND_IAD_LEN + VND_DIAG_LEN)
+
+enum vnd_wr_state {
+	vnd_wr_idle,
+	vnd_wr_data,  /* waiting for data stage */
+	vnd_wr_ready, /* data received, waiting for usb_vendor_run() */
+};
+
+/* The original CDC class, the USBD_CDC one is extended in place */
+static USBD_ClassTypeDef cdc_class;
+
+/* Interface association grouping the CDC interfaces so the host binds them to the single function */
+static const uint8_t vnd_iad_desc[VND_IAD_LEN] = {
+	VND_IAD_LEN,
+	0x0B,   /* bDescriptorType: Interface Association */
+	0x00,   /* bFirstInterface */
+	0x02,   /* bInterfaceCount */
+	0x02,   /* bFunctionClass: Communication Interface Class */
+	0x02,   /* bFunctionSubClass: Abstract Control Model */
+	0x01,   /* bFunctionProtocol: Common AT commands */
+	0x00,   /* iFunction */
+};
+
+static const uint8_t vnd_diag_desc[VND_DIAG_LEN] = {
+	USB_LEN_IF_DESC,
+	USB_DESC_TYPE_INTERFACE,
+	VND_DIAG_ITF, /* bInterfaceNumber */
+	0x00,   /* bAlternateSetting */
+	0x01,   /* bNumEndpoints */
+	0xFF,   /* bInterfaceClass: Vendor specific */
+	0x00,   /* bInterfaceSubClass */
+	0x00,   /* bInterfaceProtocol */
+	0x00,   /* iInterface */
+
+	USB_LEN_EP_DESC,
+	USB_DESC_TYPE_ENDPOINT,
+	DIAG_EP,
+	USBD_EP_TYPE_BULK,
+	LOBYTE(DIAG_EP_SIZE),
+	HIBYTE(DIAG_EP_SIZE),
+	0x00,   /* bInterval: ignored for Bulk transfer */
+};
+
+__ALIGN_BEGIN static uint8_t vnd_cfg_desc[VND_CFG_LEN] __ALIGN_END;
+
+static uint8_t vnd_rd_buff[VND_REG_MAX * 4];
+static uint8_t vnd_wr_buff[VND_REG_MAX * 4];
+static unsigned vnd_wr_reg;
+static unsigned vnd_wr_cnt;
+static volatile uint8_t vnd_wr_st;
+
+static inline uint32_t get_le32(uint8_t const* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void put_le32(uint32_t v, uint8_t* p)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+// Check the registers range is valid and accessible
+static bool vnd_chk_range(unsigned reg, unsigned cnt, unsigned access)
+{
+	unsigned i;
+	if (!cnt || cnt > VND_REG_MAX || reg + cnt > regmap_count())
+		return false;
+	for (i = reg; i < reg + cnt; ++i)
+		if (access && !(regmap_access(i) & access))
+			return false;
+	return true;
+}
+
+static uint8_t vnd_setup(USBD_HandleTypeDef* pdev, USBD_SetupReqTypedef* req)
+{
+	bool const dir_in = (req->bmRequest & 0x80U) != 0;
+	unsigned const reg = req->wValue;
+	unsigned const cnt = req->wLength / 4;
+
+	switch (req->bRequest) {
+	case VND_REG_INFO: {
+		unsigned len;
+		if (!dir_in || reg >= regmap_count())
+			break;
+		vnd_rd_buff[0] = regmap_access(reg);
+		len = 1 + regmap_path(reg, (char*)vnd_rd_buff + 1, VND_INFO_MAX - 1);
+		USBD_CtlSendData(pdev, vnd_rd_buff, len < req->wLength ? len : req->wLength);
+		return USBD_OK;
+	}
+	case VND_REG_READ: {
+		unsigned i;
+		// Write only registers are read as zero
+		if (!dir_in || req->wLength % 4 || !vnd_chk_range(reg, cnt, 0))
+			break;
+		for (i = 0; i < cnt; ++i)
+			put_le32(regmap_get(reg + i), vnd_rd_buff + 4 * i);
+		USBD_CtlSendData(pdev, vnd_rd_buff, req->wLength);
+		return USBD_OK;
+	}
+	case VND_REG_WRITE:
+		if (dir_in || req->wLength % 4 || !vnd_chk_range(reg, cnt, SCPI_VAL_W))
+			break;
+		if (vnd_wr_st != vnd_wr_idle)
+			// The previous write is not applied yet
+			break;
+		vnd_wr_reg = reg;
+		vnd_wr_cnt = cnt;
+		vnd_wr_st  = vnd_wr_data;
+		USBD_CtlPrepareRx(pdev, vnd_wr_buff, req->wLength);
+		return USBD_OK;
+	}
+	USBD_CtlError(pdev, req);
+	return USBD_FAIL;
+}
+
+static uint8_t usb_vendor_setup(USBD_HandleTypeDef* pdev, USBD_SetupReqTypedef* req)
+{
+	if ((req->bmRequest & USB_REQ_TYPE_MASK) == USB_REQ_TYPE_VENDOR)
+		return vnd_setup(pdev, req);
+	return cdc_class.Setup(pdev, req);
+}
+
+static uint8_t usb_vendor_ep0_rx_ready(USBD_HandleTypeDef* pdev)
+{
+	if (vnd_wr_st == vnd_wr_data) {
+		vnd_wr_st = vnd_wr_ready;
+		return USBD_OK;
+	}
+	return cdc_class.EP0_RxReady(pdev);
+}
+
+static uint8_t usb_vendor_class_init(USBD_HandleTypeDef* pdev, uint8_t cfgidx)
+{
+	uint8_t const ret = cdc_class.Init(pdev, cfgidx);
+	if (ret == USBD_OK)
+		diag_open(pdev);
+	return ret;
+}
+
+static uint8_t usb_vendor_class_deinit(USBD_HandleTypeDef* pdev, uint8_t cfgidx)
+{
+	diag_close(pdev);
+	return cdc_class.DeInit(pdev, cfgidx);
+}
+
+static uint8_t usb_vendor_data_in(USBD_HandleTypeDef* pdev, uint8_t epnum)
+{
+	if (epnum == (DIAG_EP & 0xFU)) {
+		diag_data_in(pdev);
+		return USBD_OK;
+	}
+	return cdc_class.DataIn(pdev, epnum);
+}
+
+static uint8_t* usb_vendor_cfg_desc(uint16_t* length)
+{
+	*length = sizeof(vnd_cfg_desc);
+	return vnd_cfg_desc;
+}
+
+// Build the composite configuration: CDC interfaces grouped by IAD followed by the diagnostic one
+static void vnd_build_cfg_desc(void)
+{
+	uint16_t len;
+	uint8_t const* const cdc = cdc_class.GetFSConfigDescriptor(&len);
+	uint8_t* p = vnd_cfg_desc;
+	memcpy(p, cdc, USB_LEN_CFG_DESC);
+	p += USB_LEN_CFG_DESC;
+	memcpy(p, vnd_iad_desc, VND_IAD_LEN);
+	p += VND_IAD_LEN;
+	memcpy(p, cdc + USB_LEN_CFG_DESC, len - USB_LEN_CFG_DESC);
+	p += len - USB_LEN_CFG_DESC;
+	memcpy(p, vnd_diag_desc, VND_DIAG_LEN);
+	vnd_cfg_desc[2] = LOBYTE(VND_CFG_LEN);
+	vnd_cfg_desc[3] = HIBYTE(VND_CFG_LEN);
+	vnd_cfg_desc[4] = VND_NUM_ITF;
+}
+
+void usb_vendor_init(void)
+{
+	// Extend CDC class by vendor requests handling and the diagnostic stream endpoint
+	cdc_class = USBD_CDC;
+	vnd_build_cfg_desc();
+	USBD_CDC.Init        = usb_vendor_class_init;
+	USBD_CDC.DeInit      = usb_vendor_class_deinit;
+	USBD_CDC.Setup       = usb_vendor_setup;
+	USBD_CDC.EP0_RxReady = usb_vendor_ep0_rx_ready;
+	USBD_CDC.DataIn      = usb_vendor_data_in;
+	USBD_CDC.GetFSConfigDescriptor = usb_vendor_cfg_desc;
+}
+
+void usb_vendor_fifo_init(USBD_HandleTypeDef* pdev)
+{
+	PCD_HandleTypeDef* const hpcd = pdev->pData;
+	/* The 320 words of FIFO RAM are shared by the RX FIFO and TX FIFO per IN endpoint:
+	   RX 96 (setup packets + 2 OUT packets with status), EP0 16 (single packet), CDC data 64 (4 packets),
+	   CDC notification 16 (minimum), diagnostic stream 128 (8 packets) so the core is rarely waiting for
+	   the FIFO refill on the TX FIFO empty interrupt */
+	HAL_PCD_DevDisconnect(hpcd);
+	HAL_PCDEx_SetRxFiFo(hpcd, 0x60);
+	HAL_PCDEx_SetTxFiFo(hpcd, 0, 0x10);
+	HAL_PCDEx_SetTxFiFo(hpcd, 1, 0x40);
+	HAL_PCDEx_SetTxFiFo(hpcd, 2, 0x10);
+	HAL_PCDEx_SetTxFiFo(hpcd, 3, 0x80);
+	HAL_PCD_DevConnect(hpcd);
+}
+
+void usb_vendor_run(void)
+{
+	unsigned i;
+	if (vnd_wr_st != vnd_wr_ready)
+		return;
+	// Invalid values are ignored the same way as the registers not writable
+	for (i = 0; i < vnd_wr_cnt; ++i)
+		regmap_set(vnd_wr_reg + i, get_le32(vnd_wr_buff + 4 * i));
+	vnd_wr_st = vnd_wr_idle;
+}
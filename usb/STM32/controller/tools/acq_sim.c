@@ -0,0 +1,295 @@
+/*
+ * Copyright (C) 2023 TeraSense
+ * You may use, distribute and modify this code under the terms of the MIT license
+ *
+ * Acquisition framing check
+ *
+ * Runs the portable acquisition core from Src/acq_core.c against the simulated ADC
+ * and the bursty FIFO consumer occasionally stalling like FX2 does when the host is
+ * not reading. The consumed stream is decoded and checked: every frame must be intact
+ * with the valid CRC, the frame counter gaps must match the lost frame counter exactly
+ * and every gap must be flagged by ACQ_FL_LOST.
+ *
+ * The averaging is checked as well: the accumulation kernel against the scalar reference
+ * on random and extreme samples and the averaged frames against the reference averages.
+ * The compressed stream is checked the same way decoding the payload by Src/rice.c,
+ * every frame must be decodable without the ones dropped.
+ *
+ * Build: cc -O2 -I../Inc acq_sim.c ../Src/acq_core.c ../Src/rice.c -o acq_sim
+ */
+
+#include "acq_core.h"
+#include "rice.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RING_LEN   4096
+#define CONVERSIONS 1000000
+#define BURST      (256/16)
+// The configuration straps value passed through to the header
+#define SIM_CFG    0x35
+
+static uint16_t ring_buff[RING_LEN];
+static uint32_t rnd_state = 1;
+
+static uint32_t rnd(void)
+{
+	rnd_state = rnd_state * 1103515245 + 12345;
+	return rnd_state >> 8;
+}
+
+// The sample value the simulated ADC returns for the channel of the given conversion,
+// the ramp with some noise
+static uint16_t sample(uint32_t conv, unsigned ch)
+{
+	uint32_t const h = (conv * 8 + ch) * 2654435761u;
+	return (uint16_t)(conv * 8 + ch + (h >> 27));
+}
+
+// Read len bytes like the controller does for the region of interest, the rest is garbage
+static void adc_read(uint32_t conv, uint8_t* raw, unsigned len)
+{
+	unsigned ch;
+	memset(raw, 0xee, ACQ_RAW_LEN);
+	for (ch = 0; ch < len / 2; ++ch) {
+		uint16_t const v = sample(conv, ch);
+		raw[2 * ch]     = v >> 8;
+		raw[2 * ch + 1] = v;
+	}
+}
+
+struct decoder {
+	uint16_t mask;
+	unsigned nchan;
+	bool     compress;
+	uint16_t prev[ACQ_CHANNELS];
+	uint16_t frame[ACQ_FRAME_MAX];
+	unsigned pos;
+	unsigned flen;   /* the current frame length known from its header */
+	uint32_t frames;
+	uint32_t gaps;
+	uint32_t conv;   /* the conversion number the next frame is expected from */
+	uint32_t flagged;
+	int      errors;
+};
+
+// Get the frame samples to out. Returns false if the payload is invalid.
+static bool decode_payload(struct decoder* d, unsigned flags, uint16_t* out)
+{
+	uint16_t const* h = d->frame;
+	unsigned const len = h[acq_hdr_len];
+	if (!(flags & ACQ_FL_RICE)) {
+		if (len != d->nchan)
+			return false;
+		memcpy(out, h + ACQ_HDR_LEN, len * sizeof(*out));
+		memcpy(d->prev, out, len * sizeof(*out));
+		return true;
+	}
+	if (!d->compress || len >= d->nchan)
+		return false;
+	if (flags & ACQ_FL_KEY)
+		memset(d->prev, 0, sizeof(d->prev));
+	return rice_decode(d->prev, h + ACQ_HDR_LEN, len, out, d->nchan) == len;
+}
+
+static void decode_frame(struct decoder* d)
+{
+	unsigned ch, i = 0;
+	uint16_t const* h = d->frame;
+	uint16_t samples[ACQ_CHANNELS];
+	uint32_t const seq = h[acq_hdr_seq_lo] | (uint32_t)h[acq_hdr_seq_hi] << 16;
+	uint32_t const ts  = h[acq_hdr_ts_lo] | (uint32_t)h[acq_hdr_ts_hi] << 16;
+	unsigned const flags = h[acq_hdr_ver_flags] & 0xff;
+	if (
+		h[acq_hdr_magic] != ACQ_MAGIC ||
+		h[acq_hdr_ver_flags] >> 8 != ACQ_VERSION ||
+		h[acq_hdr_crc] != acq_crc16(acq_crc16(0xffff, h, acq_hdr_crc), h + ACQ_HDR_LEN, h[acq_hdr_len]) ||
+		h[acq_hdr_cfg] != SIM_CFG || h[acq_hdr_roi] != d->mask || h[acq_hdr_avg] != 1 ||
+		seq < d->conv || ts != seq * 20 ||
+		!(flags & ACQ_FL_START) != !!seq ||
+		!(flags & ACQ_FL_LOST) != (seq == d->conv) ||
+		// The frame following the dropped ones must not depend on them
+		(flags & ACQ_FL_RICE && seq != d->conv && !(flags & ACQ_FL_KEY)) ||
+		!decode_payload(d, flags, samples)
+	) {
+		++d->errors;
+		return;
+	}
+	if (flags & ACQ_FL_LOST)
+		++d->flagged;
+	d->gaps += seq - d->conv;
+	d->conv = seq;
+	for (ch = 0; ch < ACQ_CHANNELS; ++ch)
+		if (d->mask & (1 << ch))
+			if (samples[i++] != sample(d->conv, ch))
+				++d->errors;
+	++d->conv;
+	++d->frames;
+}
+
+static void decode(struct decoder* d, uint16_t const* data, unsigned len)
+{
+	for (; len; --len, ++data) {
+		d->frame[d->pos++] = *data;
+		if (d->pos == ACQ_HDR_LEN) {
+			d->flen = ACQ_HDR_LEN + d->frame[acq_hdr_len];
+			if (d->flen > ACQ_FRAME_MAX) {
+				printf("bad frame length\n");
+				exit(EXIT_FAILURE);
+			}
+		}
+		if (d->pos == d->flen) {
+			decode_frame(d);
+			d->pos = 0;
+		}
+	}
+}
+
+static int run(uint16_t mask, bool compress)
+{
+	struct acq_ring ring;
+	struct acq_framer framer;
+	struct decoder dec = {.mask = mask, .nchan = acq_frame_len(mask) - ACQ_HDR_LEN, .compress = compress, .flen = ACQ_FRAME_MAX};
+	uint32_t words = 0;
+	uint8_t raw[ACQ_RAW_LEN];
+	uint16_t const* data;
+	uint32_t conv, stall = 0;
+	unsigned len;
+
+	acq_ring_init(&ring, ring_buff, RING_LEN);
+	acq_framer_init(&framer, SIM_CFG, mask, 1, compress);
+	for (conv = 0; conv < CONVERSIONS; ++conv) {
+		adc_read(conv, raw, acq_raw_len(mask));
+		// 50kHz conversion rate
+		acq_frame_queue(&framer, &ring, raw, conv * 20);
+		// The consumer takes 1.5 bursts per conversion on average but stalls from time to time
+		if (stall) {
+			--stall;
+			continue;
+		}
+		if (!(rnd() % 5000))
+			stall = rnd() % 2000;
+		for (len = rnd() % (3 * BURST); len; ) {
+			unsigned const n = acq_ring_peek(&ring, &data, len);
+			if (!n)
+				break;
+			decode(&dec, data, n);
+			acq_ring_consume(&ring, n);
+			words += n;
+			len -= n;
+		}
+	}
+	while ((len = acq_ring_peek(&ring, &data, RING_LEN))) {
+		decode(&dec, data, len);
+		acq_ring_consume(&ring, len);
+		words += len;
+	}
+	// The frames dropped after the last one received are not seen as the gap
+	dec.gaps += CONVERSIONS - dec.conv;
+	printf("mask %02x%s: %u frames, %u lost, %u gaps (%u flagged), %.2f words/frame, %d errors\n",
+		mask, compress ? " compressed" : "", (unsigned)dec.frames, (unsigned)ring.lost, (unsigned)dec.gaps,
+		(unsigned)dec.flagged, (double)words / dec.frames, dec.errors);
+	if (dec.errors || dec.pos || dec.gaps != ring.lost || dec.frames + ring.lost != CONVERSIONS) {
+		printf("FAILED\n");
+		return 1;
+	}
+	return 0;
+}
+
+// The scalar reference of acq_accum()
+static void accum_ref(int32_t* acc, uint8_t const* raw)
+{
+	unsigned ch;
+	for (ch = 0; ch < ACQ_CHANNELS; ++ch)
+		acc[ch] += (int16_t)(raw[2 * ch] << 8 | raw[2 * ch + 1]);
+}
+
+static int check_accum(void)
+{
+	int32_t acc[ACQ_CHANNELS] = {0}, ref[ACQ_CHANNELS] = {0};
+	uint8_t raw[ACQ_RAW_LEN];
+	unsigned i, j;
+	for (i = 0; i < 100000; ++i) {
+		for (j = 0; j < ACQ_RAW_LEN; ++j)
+			// Extreme values first
+			raw[j] = i < 2 ? (j & 1 ? (i ? 0xff : 0) : (i ? 0x7f : 0x80)) : (uint8_t)rnd();
+		acq_accum(acc, raw);
+		accum_ref(ref, raw);
+		if (memcmp(acc, ref, sizeof(acc))) {
+			printf("accumulation FAILED at %u\n", i);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// Average random samples over avg readouts and compare the frames with the reference averages
+static int check_avg(uint16_t mask, uint16_t avg)
+{
+	static uint8_t raws[ACQ_AVG_MAX][ACQ_RAW_LEN];
+	struct acq_ring ring;
+	struct acq_framer framer;
+	uint16_t const* f;
+	unsigned i, j, ch, frames = 0, len;
+	int errors = 0;
+
+	acq_ring_init(&ring, ring_buff, RING_LEN);
+	acq_framer_init(&framer, SIM_CFG, mask, avg, false);
+	for (i = 0; i < 4; ++i) {
+		int32_t ref[ACQ_CHANNELS] = {0};
+		for (j = 0; j < avg; ++j) {
+			unsigned k;
+			for (k = 0; k < ACQ_RAW_LEN; ++k)
+				// Full scale samples to check the accumulator range
+				raws[j][k] = i == 1 ? (k & 1 ? 0xff : 0x7f) : i == 2 ? (k & 1 ? 0 : 0x80) : (uint8_t)rnd();
+			accum_ref(ref, raws[j]);
+			if (acq_frame_queue(&framer, &ring, raws[j], j * 20) != (j == avg - 1u))
+				++errors;
+		}
+		len = acq_ring_peek(&ring, &f, RING_LEN);
+		if (len != acq_frame_len(mask) || f[acq_hdr_ts_lo] != 0 || f[acq_hdr_avg] != avg) {
+			++errors;
+			break;
+		}
+		for (ch = 0, j = ACQ_HDR_LEN; ch < ACQ_CHANNELS; ++ch) {
+			double const ref_avg = (double)ref[ch] / avg;
+			if (!(mask & (1 << ch)))
+				continue;
+			// Rounded half away from zero
+			if ((int16_t)f[j++] != (int)(ref_avg < 0 ? ref_avg - .5 : ref_avg + .5))
+				++errors;
+		}
+		acq_ring_consume(&ring, len);
+		++frames;
+	}
+	printf("average %5u mask %02x: %u frames, %d errors\n", avg, mask, frames, errors);
+	if (errors) {
+		printf("FAILED\n");
+		return 1;
+	}
+	return 0;
+}
+
+int main(void)
+{
+	static const uint16_t masks[] = {ACQ_CHAN_ALL, 0x01, 0x80, 0x5a, 0x0f};
+	// "12345678" sent high byte first
+	static const uint16_t crc_check[] = {0x3132, 0x3334, 0x3536, 0x3738};
+	unsigned i;
+	int rc = 0;
+	if (acq_crc16(0xffff, crc_check, 4) != 0xa12b) {
+		printf("CRC FAILED\n");
+		return EXIT_FAILURE;
+	}
+	for (i = 0; i < sizeof(masks) / sizeof(masks[0]); ++i)
+		rc |= run(masks[i], false);
+	for (i = 0; i < sizeof(masks) / sizeof(masks[0]); ++i)
+		rc |= run(masks[i], true);
+	rc |= check_accum();
+	rc |= check_avg(ACQ_CHAN_ALL, 2);
+	rc |= check_avg(0x5a, 7);
+	rc |= check_avg(ACQ_CHAN_ALL, 1000);
+	rc |= check_avg(0x81, ACQ_AVG_MAX);
+	return rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2023 TeraSense
+ * You may use, distribute and modify this code under the terms of the MIT license
+ *
+ * Response formatting benchmark
+ *
+ * Compares the time per formatted value taken by the formatters from Inc/str_util.h
+ * used by the CLI with the snprintf path they replaced. It runs on the host so the
+ * absolute numbers differ from the target but the ratio is indicative.
+ *
+ * Build: cc -O2 -I../Inc fmt_bench.c -o fmt_bench
+ */
+
+#include "str_util.h"
+#include <stdio.h>
+#include <time.h>
+
+#define ITERATIONS 2000000
+
+static uint32_t values[256];
+static char out[64];
+static volatile unsigned sink;
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static unsigned dec_printf(uint32_t v)
+{
+	return snprintf(out, sizeof(out), "%u", (unsigned)v);
+}
+
+static unsigned dec_fmt(uint32_t v)
+{
+	return u32_to_dec(v, 0, out);
+}
+
+static unsigned err_printf(uint32_t v)
+{
+	return snprintf(out, sizeof(out), "#%04d\r", (int)(v & 7));
+}
+
+static unsigned err_fmt(uint32_t v)
+{
+	out[0] = '#';
+	unsigned n = 1 + u32_to_dec(v & 7, 4, out + 1);
+	out[n] = '\r';
+	return n + 1;
+}
+
+static unsigned hex_printf(uint32_t v)
+{
+	return snprintf(out, sizeof(out), "%02X ", (unsigned)(v & 0xff));
+}
+
+static unsigned hex_fmt(uint32_t v)
+{
+	byte_to_hex(v, out);
+	out[2] = ' ';
+	return 3;
+}
+
+static double run(unsigned (*fmt)(uint32_t))
+{
+	unsigned i, total = 0;
+	double const start = now_ns();
+	for (i = 0; i < ITERATIONS; ++i)
+		total += fmt(values[i & 0xff]);
+	sink = total;
+	return (now_ns() - start) / ITERATIONS;
+}
+
+static void compare(const char* name, unsigned (*ref)(uint32_t), unsigned (*fmt)(uint32_t))
+{
+	unsigned i;
+	char expected[sizeof(out)];
+	for (i = 0; i < 256; ++i) {
+		unsigned const n = ref(values[i]);
+		memcpy(expected, out, n);
+		if (fmt(values[i]) != n || memcmp(expected, out, n)) {
+			printf("%s: mismatch on %u\n", name, (unsigned)values[i]);
+			return;
+		}
+	}
+	double const t_ref = run(ref), t_fmt = run(fmt);
+	printf("%-8s snprintf %6.1f ns, formatter %6.1f ns, x%.1f\n", name, t_ref, t_fmt, t_ref / t_fmt);
+}
+
+int main(void)
+{
+	unsigned i;
+	uint32_t v = 1;
+	for (i = 0; i < 256; ++i) {
+		// Mix values of all magnitudes
+		v = v * 1103515245 + 12345;
+		values[i] = v >> (i % 32);
+	}
+	values[0] = 0;
+	values[1] = 0xffffffff;
+	compare("u32", dec_printf, dec_fmt);
+	compare("error", err_printf, err_fmt);
+	compare("hex u8", hex_printf, hex_fmt);
+	return 0;
+}
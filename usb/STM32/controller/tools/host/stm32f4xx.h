@@ -0,0 +1,5 @@
+// Host stand-in for the device header, see stm32f4xx_hal.h
+
+#pragma once
+
+#include "stm32f4xx_hal.h"
@@ -0,0 +1,46 @@
+/*
+ * Host stand-in for the HAL header
+ *
+ * Provides the few peripheral definitions the command parser sources refer to
+ * so they can be compiled by the host benchmarks (see scpi_bench.c). The
+ * registers are plain variables defined by the benchmark.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+typedef struct { volatile uint32_t IDR, BSRR; } GPIO_TypeDef;
+typedef struct { volatile uint32_t CNT; } TIM_TypeDef;
+typedef struct { volatile uint32_t CYCCNT; } DWT_Type;
+
+typedef struct { int unused; } TIM_HandleTypeDef, SPI_HandleTypeDef, I2C_HandleTypeDef, PCD_HandleTypeDef;
+
+extern GPIO_TypeDef host_gpio;
+extern TIM_TypeDef  host_tim;
+extern DWT_Type     host_dwt;
+
+#define GPIOA (&host_gpio)
+#define GPIOB (&host_gpio)
+#define GPIOC (&host_gpio)
+#define GPIOD (&host_gpio)
+#define GPIOE (&host_gpio)
+#define TIM2  (&host_tim)
+#define DWT   (&host_dwt)
+
+#define GPIO_PIN_0  0x0001
+#define GPIO_PIN_1  0x0002
+#define GPIO_PIN_2  0x0004
+#define GPIO_PIN_3  0x0008
+#define GPIO_PIN_4  0x0010
+#define GPIO_PIN_5  0x0020
+#define GPIO_PIN_6  0x0040
+#define GPIO_PIN_7  0x0080
+#define GPIO_PIN_8  0x0100
+#define GPIO_PIN_9  0x0200
+#define GPIO_PIN_10 0x0400
+#define GPIO_PIN_11 0x0800
+#define GPIO_PIN_12 0x1000
+#define GPIO_PIN_13 0x2000
+#define GPIO_PIN_14 0x4000
+#define GPIO_PIN_15 0x8000
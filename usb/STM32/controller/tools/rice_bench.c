@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2023 TeraSense
+ * You may use, distribute and modify this code under the terms of the MIT license
+ *
+ * Delta + Rice codec check and benchmark
+ *
+ * Codes the frames of the test corpus by Src/rice.c the same way the controller does
+ * (falling back to the raw samples if the coded payload is not shorter, key frame every
+ * ACQ_KEY_INTERVAL frames), decodes them back and checks the samples are intact.
+ * Reports the compression ratio of the payload and the coding speed in MB of samples
+ * per second on the single core. The speed on the target is reported by :ACQuire:COMPress:BENChmark?
+ *
+ * The corpus is generated: the noisy signals of different amplitude and the worst cases.
+ * The recorded samples may be added as the file of 16 bit big endian samples of 8 channels
+ * (the frame payload with all channels selected) given as the argument.
+ *
+ * Build: cc -O2 -I../Inc rice_bench.c ../Src/rice.c -lm -o rice_bench
+ */
+
+#include "rice.h"
+#include "acq_core.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#define FRAMES     200000
+#define REPEAT     5
+
+static uint16_t samples[FRAMES][ACQ_CHANNELS];
+static uint16_t coded[FRAMES][ACQ_CHANNELS];
+static uint8_t  coded_len[FRAMES]; /* 0 for the raw frame */
+static uint16_t decoded[FRAMES][ACQ_CHANNELS];
+static uint32_t rnd_state = 1;
+
+static uint32_t rnd(void)
+{
+	rnd_state = rnd_state * 1103515245 + 12345;
+	return rnd_state >> 8;
+}
+
+// The approximately normal noise
+static double noise(double sigma)
+{
+	double s = 0;
+	unsigned i;
+	for (i = 0; i < 12; ++i)
+		s += (rnd() & 0xffff) / 65536.;
+	return (s - 6) * sigma;
+}
+
+static uint16_t clip(double v)
+{
+	return v > 32767 ? 32767 : v < -32768 ? -32768 : (int16_t)lrint(v);
+}
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+enum corpus {
+	corpus_dark,    /* the detector noise only */
+	corpus_signal,  /* the slow signal with noise */
+	corpus_pulses,  /* the sharp pulses on the noise */
+	corpus_noise,   /* the full scale white noise, the worst case */
+	corpus_const,   /* the best case */
+	corpus_file,
+};
+
+static const char* const corpus_names[] = {"dark", "signal", "pulses", "noise", "const", "file"};
+
+static unsigned corpus_gen(enum corpus c)
+{
+	unsigned i, ch;
+	for (i = 0; i < FRAMES; ++i)
+		for (ch = 0; ch < ACQ_CHANNELS; ++ch) {
+			double v = 0;
+			switch (c) {
+			case corpus_dark:
+				v = 100 * ch + noise(4);
+				break;
+			case corpus_signal:
+				v = 12000 * sin(i * 0.001 + ch) + noise(20);
+				break;
+			case corpus_pulses:
+				v = (i % 500 < 5 ? 20000 : 0) + noise(8);
+				break;
+			case corpus_noise:
+				v = (int16_t)rnd();
+				break;
+			default:
+				v = -1234;
+			}
+			samples[i][ch] = clip(v);
+		}
+	return FRAMES;
+}
+
+static unsigned corpus_load(const char* name)
+{
+	uint8_t buf[ACQ_RAW_LEN];
+	unsigned i, ch;
+	FILE* f = fopen(name, "rb");
+	if (!f) {
+		perror(name);
+		exit(EXIT_FAILURE);
+	}
+	for (i = 0; i < FRAMES && fread(buf, sizeof(buf), 1, f) == 1; ++i)
+		for (ch = 0; ch < ACQ_CHANNELS; ++ch)
+			samples[i][ch] = buf[2 * ch] << 8 | buf[2 * ch + 1];
+	fclose(f);
+	return i;
+}
+
+static unsigned encode(unsigned frames)
+{
+	uint16_t prev[ACQ_CHANNELS];
+	unsigned i, words = 0;
+	for (i = 0; i < frames; ++i) {
+		if (!(i % ACQ_KEY_INTERVAL))
+			memset(prev, 0, sizeof(prev));
+		coded_len[i] = rice_encode(prev, samples[i], ACQ_CHANNELS, coded[i], ACQ_CHANNELS - 1);
+		words += coded_len[i] ? coded_len[i] : ACQ_CHANNELS;
+	}
+	return words;
+}
+
+static int decode(unsigned frames)
+{
+	uint16_t prev[ACQ_CHANNELS];
+	unsigned i;
+	for (i = 0; i < frames; ++i) {
+		if (!coded_len[i]) {
+			memcpy(decoded[i], samples[i], sizeof(decoded[i]));
+			memcpy(prev, samples[i], sizeof(prev));
+			continue;
+		}
+		if (!(i % ACQ_KEY_INTERVAL))
+			memset(prev, 0, sizeof(prev));
+		if (rice_decode(prev, coded[i], coded_len[i], decoded[i], ACQ_CHANNELS) != coded_len[i])
+			return -1;
+	}
+	return 0;
+}
+
+static int bench(enum corpus c, const char* file)
+{
+	unsigned const frames = c == corpus_file ? corpus_load(file) : corpus_gen(c);
+	double const mb = (double)frames * ACQ_RAW_LEN * REPEAT / 1e6;
+	double t, enc_ns, dec_ns;
+	unsigned i, words = 0;
+	int rc = 0;
+
+	t = now_ns();
+	for (i = 0; i < REPEAT; ++i)
+		words = encode(frames);
+	enc_ns = now_ns() - t;
+	t = now_ns();
+	for (i = 0; i < REPEAT; ++i)
+		rc |= decode(frames);
+	dec_ns = now_ns() - t;
+	if (rc || memcmp(samples, decoded, frames * sizeof(samples[0]))) {
+		printf("%-8s FAILED\n", corpus_names[c]);
+		return 1;
+	}
+	printf("%-8s %7u frames, ratio %5.2f, encode %7.1f MB/s, decode %7.1f MB/s\n", corpus_names[c], frames,
+		(double)frames * ACQ_CHANNELS / words, mb / (enc_ns / 1e9), mb / (dec_ns / 1e9));
+	return 0;
+}
+
+// The invalid data must be rejected rather than overrun the buffers
+static int check_invalid(void)
+{
+	uint16_t prev[ACQ_CHANNELS] = {0}, in[ACQ_CHANNELS], out[ACQ_CHANNELS];
+	unsigned i, j, valid = 0;
+	for (i = 0; i < 100000; ++i) {
+		unsigned const len = 1 + rnd() % (ACQ_CHANNELS - 1);
+		for (j = 0; j < len; ++j)
+			in[j] = rnd();
+		if (rice_decode(prev, in, len, out, ACQ_CHANNELS))
+			++valid;
+	}
+	printf("random data: %u of %u accepted\n", valid, i);
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	enum corpus c;
+	int rc = 0;
+	for (c = corpus_dark; c < corpus_file; ++c)
+		rc |= bench(c, NULL);
+	if (argc > 1)
+		rc |= bench(corpus_file, argv[1]);
+	rc |= check_invalid();
+	return rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
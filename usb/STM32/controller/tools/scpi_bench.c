@@ -0,0 +1,257 @@
+/*
+ * SCPI node lookup benchmark
+ *
+ * Runs the command parser of the controller on the host with the generated lookup
+ * indexes (Src/scpi_index.c) and with the linear scpi_match() lookup they replaced.
+ * The probe corpus is built from the parse tree: the short, long, lower case and
+ * broken forms of every node path, as commands and queries. The error and the reply
+ * of both lookups are compared on every probe, then the time per command is measured.
+ *
+ * Src/cli_parse.c is included to get at its parse tree. The nodes served by the
+ * modules needing the peripherals are replaced by the stubs below with the same
+ * names, the indexes are checked against them so the stale stubs are reported.
+ *
+ * Build: cc -O2 -Ihost -I../Inc -I../Middlewares/ST/STM32_USB_Device_Library/Core/Inc
+ *        scpi_bench.c ../Src/scpi.c ../Src/scpi_index.c -o scpi_bench
+ */
+
+#include "scpi.h"
+#include "../Src/cli_parse.c"
+#include <stdio.h>
+#include <time.h>
+
+#define ITERATIONS 200000
+#define ROUNDS     7
+#define MAX_PROBES 4096
+#define PROBE_SZ   64
+#define OUT_SZ     0x1100
+
+GPIO_TypeDef host_gpio;
+TIM_TypeDef  host_tim;
+DWT_Type     host_dwt;
+uint16_t     sys_cfg;
+
+/*
+ * The stubs of the nodes served by the other modules
+ */
+
+static int stub_handler(const char* str, unsigned sz, struct scpi_node const* n)
+{
+	return sz;
+}
+
+#define STUB(name) {name, NULL, stub_handler}
+
+const struct scpi_node evt_nodes[] = {
+	STUB("ENABle"), STUB("ERRLimit"), SCPI_NODE_END
+};
+
+const struct scpi_node stat_nodes[] = {
+	STUB("COMMands"), STUB("ERRors"), STUB("HISTogram"), STUB("RESet"), STUB("CLOCk"), SCPI_NODE_END
+};
+
+const struct scpi_node diag_nodes[] = {
+	STUB("TRACe"), STUB("FILL"), STUB("SENT"), STUB("LOST"), SCPI_NODE_END
+};
+
+const struct scpi_node i2c_eeprom_nodes[] = {
+	STUB("WR"), STUB("RD"), STUB("WRBlock"), STUB("RDBlock"), STUB("DUMP"), SCPI_NODE_END
+};
+
+const struct scpi_node test_fifo_nodes[] = {
+	STUB("STATe"), STUB("ACTive"), STUB("PAUSed"), STUB("STReam"), STUB("WORDs"), SCPI_NODE_END
+};
+
+static const struct scpi_node acq_compress_nodes[] = {
+	STUB("ENABle"), STUB("BENChmark"), SCPI_NODE_END
+};
+
+const struct scpi_node acq_nodes[] = {
+	STUB("ACTive"), STUB("RATE"), STUB("CHANnels"), STUB("ROI"), STUB("AVERage"),
+	{"COMPress", acq_compress_nodes, .index = &acq_compress_nodes_index},
+	STUB("FRAMes"), STUB("LOST"), STUB("OVERruns"), SCPI_NODE_END
+};
+
+void regmap_init(struct scpi_tree const* tree) {}
+void _sys_schedule_bootloader(void) {}
+void _sys_reset(void) {}
+
+/*
+ * The reply buffer
+ */
+
+static char     out[OUT_SZ];
+static unsigned out_sz;
+
+err_t cli_put(char const* buff, unsigned sz)
+{
+	if (out_sz + sz > OUT_SZ)
+		return err_internal;
+	memcpy(out + out_sz, buff, sz);
+	out_sz += sz;
+	return err_ok;
+}
+
+unsigned cli_tx_room(void)
+{
+	return OUT_SZ - out_sz;
+}
+
+char* cli_tx_alloc(unsigned sz)
+{
+	char* const ptr = out + out_sz;
+	if (out_sz + sz > OUT_SZ)
+		return NULL;
+	out_sz += sz;
+	return ptr;
+}
+
+void cli_stream(cli_producer_t producer) {}
+
+err_t cli_put_str(char const* str)
+{
+	return cli_put(str, strlen(str));
+}
+
+err_t cli_put_u(uint32_t v, unsigned width)
+{
+	char buf[U32_DEC_MAX];
+	return cli_put(buf, u32_to_dec(v, width, buf));
+}
+
+err_t cli_put_hex(uint32_t v, unsigned width)
+{
+	char* const ptr = cli_tx_alloc(width);
+	if (!ptr)
+		return err_internal;
+	u32_to_hex_w(v, width, ptr);
+	return err_ok;
+}
+
+err_t cli_put_bool(bool v)
+{
+	return cli_put(v ? "1" : "0", 1);
+}
+
+/*
+ * The probe corpus
+ */
+
+static char     probes[MAX_PROBES][PROBE_SZ];
+static unsigned probe_cnt;
+
+static void probe_add(const char* path, const char* tail)
+{
+	if (probe_cnt < MAX_PROBES && strlen(path) + strlen(tail) < PROBE_SZ)
+		sprintf(probes[probe_cnt++], "%s%s", path, tail);
+}
+
+static void probe_node(char* path, unsigned len, const char* name)
+{
+	static const char* const tails[] = {"", "?", " 1", "X", "X?"};
+	char forms[4][PROBE_SZ];
+	unsigned i, f;
+	// Long and short forms, lower case, the long form truncated
+	strcpy(forms[0], name);
+	for (i = 0; name[i] && isupper((unsigned char)name[i]); ++i)
+		forms[1][i] = name[i];
+	forms[1][i] = 0;
+	for (i = 0; name[i]; ++i)
+		forms[2][i] = tolower((unsigned char)name[i]);
+	forms[2][i] = 0;
+	strcpy(forms[3], name);
+	forms[3][strlen(name) - 1] = 0;
+	for (f = 0; f < 4; ++f) {
+		if (f == 1 && !strcmp(forms[1], forms[0]))
+			continue;
+		if (f == 3 && strlen(forms[3]) <= strlen(forms[1]))
+			continue;
+		strcpy(path + len, forms[f]);
+		for (i = 0; i < sizeof(tails) / sizeof(*tails); ++i)
+			probe_add(path, tails[i]);
+	}
+	strcpy(path + len, name);
+}
+
+static void probe_dir(char* path, unsigned len, struct scpi_node const* dir, char sep)
+{
+	struct scpi_node const* n;
+	for (n = dir; n->name; ++n) {
+		path[len] = sep;
+		probe_node(path, len + 1, n->name);
+		if (n->dir)
+			probe_dir(path, len + 1 + strlen(n->name), n->dir, ':');
+	}
+}
+
+/*
+ * The lookup comparison and timing
+ */
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static err_t probe_run(unsigned i)
+{
+	struct scpi_node const* top;
+	out_sz = 0;
+	return cli_parse(probes[i], strlen(probes[i]), &top);
+}
+
+// Returns the best time per command of the ROUNDS runs over the corpus
+static double run(bool indexed)
+{
+	unsigned r, i;
+	double best = 0;
+	parse_tree.indexed = indexed;
+	for (r = 0; r < ROUNDS; ++r) {
+		double const start = now_ns();
+		double t;
+		for (i = 0; i < ITERATIONS; ++i)
+			probe_run(i % probe_cnt);
+		t = (now_ns() - start) / ITERATIONS;
+		if (!r || t < best)
+			best = t;
+	}
+	return best;
+}
+
+int main(void)
+{
+	char path[PROBE_SZ + 1];
+	unsigned i, accepted = 0, mismatches = 0;
+
+	if (!scpi_index_init(&parse_tree)) {
+		printf("the indexes do not match the parse tree, regenerate them or update the stubs\n");
+		return 1;
+	}
+	probe_dir(path, 0, parse_tree.star_nodes, '*');
+	probe_dir(path, 0, parse_tree.colon_nodes, ':');
+
+	for (i = 0; i < probe_cnt; ++i) {
+		char expected[OUT_SZ];
+		unsigned expected_sz;
+		err_t linear, indexed;
+		parse_tree.indexed = false;
+		linear = probe_run(i);
+		memcpy(expected, out, expected_sz = out_sz);
+		parse_tree.indexed = true;
+		indexed = probe_run(i);
+		if (linear != indexed || expected_sz != out_sz || memcmp(expected, out, out_sz)) {
+			printf("mismatch on %s: linear error %d, indexed error %d\n", probes[i], linear, indexed);
+			++mismatches;
+		}
+		accepted += !linear;
+	}
+	printf("%u probes (%u accepted), %u mismatches\n", probe_cnt, accepted, mismatches);
+	if (mismatches)
+		return 1;
+
+	double const t_linear = run(false), t_indexed = run(true);
+	printf("linear %6.1f ns/command, indexed %6.1f ns/command, x%.2f\n", t_linear, t_indexed, t_linear / t_indexed);
+	return 0;
+}
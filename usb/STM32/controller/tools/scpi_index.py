@@ -0,0 +1,266 @@
+#!/usr/bin/python3
+
+"""
+Copyright (C) 2023 TeraSense
+You may use, distribute and modify this code under the terms of the MIT license
+
+SCPI lookup index generator
+
+Scans the controller sources for the static struct scpi_node arrays and builds
+the trie over the short and long forms of the node names for each of them. The
+result is written to Src/scpi_index.c and Inc/scpi_index.h. The trie lookup is
+checked against the model of scpi_match() from Inc/scpi.h to accept and reject
+exactly the same input. The header also gets the number of nodes served by the
+generic value handlers so the register map size is checked at build time.
+
+Usage: scpi_index.py [project_dir]
+"""
+
+import os
+import re
+import sys
+import glob
+import itertools
+
+MAX_ENTRIES = 32
+MAX_TRIE    = 255
+
+array_re = re.compile(r'(?:static\s+)?const\s+struct\s+scpi_node\s+(\w+)\s*\[\]\s*=\s*\{')
+string_re = re.compile(r'"((?:[^"\\]|\\.)*)"')
+value_re = re.compile(r'\bscpi_(?:u16|u32|bool)_(?:rw|r|w)_handler2?\b')
+
+class error(RuntimeError):
+	pass
+
+def strip_comments(src):
+	"""Remove comments preserving string literals"""
+	return re.sub(r'//[^\n]*|/\*.*?\*/|("(?:[^"\\]|\\.)*")',
+			lambda m: m.group(1) or ' ', src, flags=re.S)
+
+def parse_entries(src, pos):
+	"""Return the list of entry names of the array starting at given position and the number of value nodes"""
+	names, values, depth, start = [], 0, 1, None
+	while depth:
+		if pos >= len(src):
+			raise error('unterminated array')
+		c = src[pos]
+		if c == '"':
+			m = string_re.match(src, pos)
+			pos = m.end()
+			continue
+		if c == '{':
+			depth += 1
+			if depth == 2:
+				start = pos
+		elif c == '}':
+			depth -= 1
+			if depth == 1:
+				m = string_re.search(src, start, pos)
+				if not m:
+					raise error('entry without name')
+				names.append(m.group(1))
+				if value_re.search(src, start, pos):
+					values += 1
+		elif depth == 1 and src.startswith('SCPI_NODE_END', pos):
+			break
+		pos += 1
+	return names, values
+
+def scan_arrays(src_dir):
+	"""Return the dict of entry names by array name and the total number of value nodes"""
+	arrays, values = {}, 0
+	for path in sorted(glob.glob(os.path.join(src_dir, '*.c'))):
+		with open(path) as f:
+			src = strip_comments(f.read())
+		for m in array_re.finditer(src):
+			name = m.group(1)
+			if name in arrays:
+				raise error('duplicate array %s' % name)
+			try:
+				arrays[name], n = parse_entries(src, m.end())
+			except error as e:
+				raise error('%s: %s: %s' % (os.path.basename(path), name, e))
+			values += n
+	return arrays, values
+
+def scpi_match(s, name):
+	"""The model of scpi_match() from Inc/scpi.h"""
+	matched, i = 0, 0
+	if not s:
+		return 0
+	for j, c in enumerate(name):
+		if i >= len(s) or s[i].upper() != c.upper():
+			if not matched:
+				return 0
+			if c.isupper() or c.isdigit():
+				return 0
+			if i < len(s) and s[i].isalpha():
+				return 0
+			if not name[j-1].isupper():
+				return 0
+			return matched
+		matched += 1
+		i += 1
+	if i < len(s) and s[i].isalpha():
+		return 0
+	return matched
+
+def name_forms(name):
+	"""Return the short and long forms of the name accepted by scpi_match()"""
+	short = ''
+	for c in name:
+		if not (c.isupper() or c.isdigit()):
+			break
+		short += c
+	forms = {name.upper()}
+	if short and short != name and short[-1].isupper():
+		forms.add(short)
+	return forms
+
+def build_trie(names):
+	"""Build the trie as the list of [ch, next, child, accept] nodes, the node 0 is the root"""
+	if len(names) > MAX_ENTRIES:
+		raise error('too many entries')
+	trie = [['\0', 0, 0, 0]]
+	for idx, name in enumerate(names):
+		for form in sorted(name_forms(name)):
+			node = 0
+			for c in form:
+				i, last = trie[node][2], 0
+				while i and trie[i][0] != c:
+					last, i = i, trie[i][1]
+				if not i:
+					i = len(trie)
+					trie.append([c, 0, 0, 0])
+					if last:
+						trie[last][1] = i
+					else:
+						trie[node][2] = i
+				node = i
+			trie[node][3] |= 1 << idx
+	if len(trie) > MAX_TRIE:
+		raise error('the trie is too large')
+	return trie
+
+def trie_lookup(trie, s, names):
+	"""The model of scpi_index_lookup() from Src/scpi.c"""
+	best, matched, i, depth = None, 0, trie[0][2], 0
+	while i and depth < len(s):
+		c = s[depth].upper() if 'a' <= s[depth] <= 'z' else s[depth]
+		while i and trie[i][0] != c:
+			i = trie[i][1]
+		if not i:
+			break
+		depth += 1
+		if trie[i][3] and (depth == len(s) or not s[depth].isalpha()):
+			for idx in range(len(names)):
+				if best is not None and idx >= best:
+					break
+				if trie[i][3] & (1 << idx):
+					best, matched = idx, depth
+					break
+		i = trie[i][2]
+	return best, matched
+
+def linear_lookup(s, names):
+	for idx, name in enumerate(names):
+		matched = scpi_match(s, name)
+		if matched:
+			return idx, matched
+	return None, 0
+
+def probes(names):
+	"""Generate the input strings to check the lookup against"""
+	tails = ['', ':', ' ', '?', ';', '1', '0', 'x', 'X', 'e', ' 1']
+	heads = set()
+	for name in names:
+		for n in range(len(name) + 1):
+			heads.add(name[:n])
+			heads.add(name[:n].lower())
+			heads.add(name[:n].upper())
+			heads.add(name[:n] + name[n:n+1].swapcase())
+	for head, tail in itertools.product(sorted(heads), tails):
+		yield head + tail
+
+def verify(array, trie, names):
+	for s in probes(names):
+		expected = linear_lookup(s, names)
+		if trie_lookup(trie, s, names) != expected:
+			raise error('%s: lookup mismatch on %r' % (array, s))
+
+def c_char(c):
+	return "'%s'" % c if c != '\0' else "'\\0'"
+
+def gen_source(arrays, tries):
+	out = ['/*',
+		' * SCPI node lookup indexes',
+		' * Generated by tools/scpi_index.py - do not edit',
+		' */',
+		'',
+		'#include "scpi_index.h"',
+		'']
+	for array in sorted(arrays):
+		names, trie = arrays[array], tries[array]
+		out.append('static const struct scpi_trie %s_trie[] = {' % array)
+		for ch, nxt, child, accept in trie:
+			out.append('\t{%s, %d, %d, 0x%x},' % (c_char(ch), nxt, child, accept))
+		out.append('};')
+		out.append('')
+		out.append('const struct scpi_index %s_index = {' % array)
+		out.append('\t%d,' % len(names))
+		out.append('\t"%s",' % ' '.join(names))
+		out.append('\t%s_trie' % array)
+		out.append('};')
+		out.append('')
+	return '\n'.join(out)
+
+def gen_header(arrays, values):
+	out = ['/*',
+		' * SCPI node lookup indexes',
+		' * Generated by tools/scpi_index.py - do not edit',
+		' */',
+		'',
+		'#pragma once',
+		'',
+		'#include "scpi.h"',
+		'',
+		'// The number of nodes served by the generic value handlers',
+		'#define SCPI_VALUE_NODES %d' % values,
+		'']
+	for array in sorted(arrays):
+		out.append('extern const struct scpi_index %s_index;' % array)
+	out.append('')
+	return '\n'.join(out)
+
+def update(path, content):
+	"""Write file only if its content changed so the build does not see it modified otherwise"""
+	try:
+		with open(path) as f:
+			if f.read() == content:
+				return False
+	except IOError:
+		pass
+	with open(path, 'w', newline='\n') as f:
+		f.write(content)
+	return True
+
+def main(proj_dir):
+	arrays, values = scan_arrays(os.path.join(proj_dir, 'Src'))
+	if not arrays:
+		raise error('no scpi_node arrays found')
+	tries = {}
+	for array, names in arrays.items():
+		trie = build_trie(names)
+		verify(array, trie, names)
+		tries[array] = trie
+	update(os.path.join(proj_dir, 'Src', 'scpi_index.c'), gen_source(arrays, tries))
+	update(os.path.join(proj_dir, 'Inc', 'scpi_index.h'), gen_header(arrays, values))
+	return 0
+
+if __name__ == '__main__':
+	proj_dir = sys.argv[1] if len(sys.argv) > 1 else os.path.join(os.path.dirname(os.path.abspath(__file__)), '..')
+	try:
+		sys.exit(main(proj_dir))
+	except error as e:
+		print ('scpi_index:', e, file=sys.stderr)
+		sys.exit(1)
@@ -5,7 +5,7 @@ The code is inspired by serial.tools.list_ports module
 
 import ctypes
 import serial
-import _winreg as reg
+import winreg as reg
 from serial.win32 import ULONG_PTR
 from ctypes.wintypes import HANDLE
 from ctypes.wintypes import BOOL
@@ -202,11 +202,12 @@ def dev_find_port(port):
 
     return None
 
-def dev_touch((hdi, devinfo), action=DICS_PROPCHANGE):
+def dev_touch(dev, action=DICS_PROPCHANGE):
     """
     Trigger device state change.
     Should be run under administrator account otherwise the access denied exception will be raised.
     """
+    hdi, devinfo = dev
     header = SP_CLASSINSTALL_HEADER()
     header.cbSize = ctypes.sizeof(header)
     header.InstallFunction = DIF_PROPERTYCHANGE;
@@ -226,8 +227,9 @@ def dev_touch((hdi, devinfo), action=DICS_PROPCHANGE):
     if not SetupDiChangeState(hdi, ctypes.byref(devinfo)):
         raise ctypes.WinError()
 
-def dev_open_reg((hdi, devinfo), access=KEY_QUERY_VALUE):
+def dev_open_reg(dev, access=KEY_QUERY_VALUE):
     """Open device registry key and return its handle"""
+    hdi, devinfo = dev
     hkey = SetupDiOpenDevRegKey(
                 hdi,
                 ctypes.byref(devinfo),
@@ -259,8 +261,9 @@ def dev_set_latency(dev, lat=1):
     finally:
         dev_close_reg(hkey)
 
-def dev_close((hdi, devinfo)):
+def dev_close(dev):
     """Close device info handle"""
+    hdi, devinfo = dev
     SetupDiDestroyDeviceInfoList(hdi)
 
 def is_admin():
@@ -273,24 +276,24 @@ def is_admin():
 if __name__ == '__main__':
     import sys
     if not is_admin():
-        print 'Warning: not Administrator'
+        print('Warning: not Administrator')
     port = sys.argv[1]
     dev = dev_find_port(port)
     if dev is not None:
         if '--enable' in sys.argv[2:]:
             dev_touch(dev, DICS_ENABLE)
-            print 'enabled'
+            print('enabled')
         elif '--disable' in sys.argv[2:]:
             dev_touch(dev, DICS_DISABLE)
-            print 'disabled'
+            print('disabled')
         elif '--touch' in sys.argv[2:]:
             dev_touch(dev)
-            print 'touched'
+            print('touched')
         elif '--lat' in sys.argv[2:]:
             dev_set_latency(dev, int(sys.argv[-1]))
-            print 'latency set'
+            print('latency set')
         else:
-            print 'LatencyTimer =', dev_get_latency(dev)
+            print('LatencyTimer =', dev_get_latency(dev))
         dev_close(dev)
     else:
-        print port, 'not found'
+        print(port, 'not found')
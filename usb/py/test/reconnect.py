@@ -12,36 +12,38 @@ PORT = sys.argv[1]
 dev = None
 
 def open_port():
-	return serial.Serial(PORT, timeout=TIMEOUT, writeTimeout=TIMEOUT)
+	com = serial.Serial(PORT, timeout=TIMEOUT, writeTimeout=TIMEOUT)
+	ts_usb.bin_mode(com)
+	return com
 
 def send_req(com, req):
 	try:
 		com.write(ts_usb.cmd_serialize(req))
 	except:
-		print >> sys.stderr, '\nwrite failed'
+		print('\nwrite failed', file=sys.stderr)
 		return False
 	try:
 		resp = com.read(ts_usb.PKT_LEN)
 		if len(resp) != ts_usb.PKT_LEN:
-			print >> sys.stderr, '\nread', len(resp), 'bytes'
+			print('\nread', len(resp), 'bytes', file=sys.stderr)
 			return False
 		if not ts_usb.chk_cmd_response(resp, req):
-			print >> sys.stderr, '\nbad response'
+			print('\nbad response', file=sys.stderr)
 			return False
 		r = ts_usb.cmd_deserialize(resp)
 		if r.err != 0:
-			print >> sys.stderr, '\nerr', r.err
+			print('\nerr', r.err, file=sys.stderr)
 			return False
 		if (r.status & ts_usb.ERR_ANY) != 0:
-			print >> sys.stderr, '\nstatus', r.status
+			print('\nstatus', r.status, file=sys.stderr)
 			return False
 		return True
 	except:
-		print >> sys.stderr, '\nread failed'
+		print('\nread failed', file=sys.stderr)
 		return False
 
 def reset_port(com):
-	req = ts_usb.cmd_request(ts_usb.RESET, False, random.randint(0, 255), '', need_resp=True)
+	req = ts_usb.cmd_request(ts_usb.RESET, False, random.randint(0, 255), b'', need_resp=True)
 	return send_req(com, req)
 
 def reconnect_port(com):
@@ -64,7 +66,7 @@ def reconnect_port(com):
 			return com
 		except:
 			delay = min(MAX_DELAY, delay*2)
-			print >> sys.stderr, 'reopen failed'
+			print('reopen failed', file=sys.stderr)
 
 com = open_port()
 if os.name == 'nt':
@@ -76,11 +78,11 @@ while True:
 	if reset_port(com):
 		while True:
 			sn = (sn + 1) & 0xff
-			req = ts_usb.cmd_request(ts_usb.INFO, True, sn, '', need_resp=True)
+			req = ts_usb.cmd_request(ts_usb.INFO, True, sn, b'', need_resp=True)
 			if not send_req(com, req):
 				break
-			print >> sys.stderr, '*',
+			print('*', end='', file=sys.stderr, flush=True)
 	else:
-		print >> sys.stderr, 'reset failed'
+		print('reset failed', file=sys.stderr)
 	com = reconnect_port(com)
 
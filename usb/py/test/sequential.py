@@ -8,9 +8,10 @@ TIMEOUT = 1
 com = serial.Serial(sys.argv[1], timeout=TIMEOUT, writeTimeout=TIMEOUT)
 resp_fraction = .01
 mutex = threading.Lock()
+ts_usb.bin_mode(com)
 
 def read_last_sn(com):
-	com.write(ts_usb.cmd_serialize(ts_usb.cmd_request(ts_usb.INFO, False, 0, '', need_resp=True)))
+	com.write(ts_usb.cmd_serialize(ts_usb.cmd_request(ts_usb.INFO, False, 0, b'', need_resp=True)))
 	resp = ts_usb.cmd_deserialize(com.read(ts_usb.PKT_LEN))
 	assert (resp.status & ts_usb.ERR_ANY) == 0
 	return ts_usb.parse_info(resp.data).last_sn
@@ -20,20 +21,20 @@ def read_responses(com):
 	while True:
 		resp = com.read(ts_usb.PKT_LEN)
 		if not resp:
-			print >> sys.stderr, '\nread timeout'
+			print('\nread timeout', file=sys.stderr)
 			break
 		assert ts_usb.is_cmd_response(resp)
 		r = ts_usb.cmd_deserialize(resp)
-		assert ord(r.data[3]) == last_read_sn
+		assert r.data[3] == last_read_sn
 		assert r.seq == True
 		assert r.err == 0
 		assert (r.status & ts_usb.ERR_ANY) == 0
 		last_read_sn = r.sn
 		with mutex:
-			print >> sys.stderr, '*',
+			print('*', end='', file=sys.stderr, flush=True)
 
 sn = read_last_sn(com)
-print 'last sn', sn
+print('last sn', sn)
 
 t = threading.Thread(target=read_responses, args=(com,))
 t.start()
@@ -44,12 +45,12 @@ while True:
 	sn = (sn + 1) & 0xff
 	with_resp = (random.random() < resp_fraction)
 	# Link responses via reserved data field
-	data = '' if not with_resp else '\0\0\0' + chr(last_resp_sn)
+	data = b'' if not with_resp else b'\0\0\0' + bytes((last_resp_sn,))
 	cmd = ts_usb.cmd_request(ts_usb.INFO, True, sn, data, need_resp=with_resp)
 	req = ts_usb.cmd_serialize(cmd)
 	com.write(req)
 	if with_resp:
 		last_resp_sn = sn
 	with mutex:
-		print >> sys.stderr, '.',
+		print('.', end='', file=sys.stderr, flush=True)
 
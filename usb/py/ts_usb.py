@@ -1,9 +1,16 @@
 from collections import namedtuple
 import struct
+import time
+
+# The controller takes the frames after the binary mode escape line till the reset token
+BIN_MODE    = b'\x1bB\r'
+RESET_TOKEN = b'-\r'
 
 # Packet related constants
 PKT_LEN    = 64
-CMD_BUF_SZ = 60
+HDR_LEN    = 4
+CRC_LEN    = 2
+CMD_BUF_SZ = PKT_LEN - HDR_LEN - CRC_LEN
 CMD_RESP   = 0x80 
 CMD_MASK   = 0x7f
 SEQ_MODE   = 0x80
@@ -12,10 +19,12 @@ ERR_MASK   = 0x7f
 # Commands
 INFO      = 0
 RESET     = 1
-EEPROM_RD = 0x10
-EEPROM_WR = 0x11
+SCPI      = 2
+RESOLVE   = 3
+GET       = 4
+SET       = 5
 
-# Error codes
+# Status bits
 ERR_PROTO = 1
 ERR_SEQ   = 2
 ERR_ANY = ERR_PROTO | ERR_SEQ
@@ -23,29 +32,46 @@ ERR_ANY = ERR_PROTO | ERR_SEQ
 # The command packet representation
 Cmd = namedtuple('Cmd', ('cmd', 'resp', 'seq', 'sn', 'err', 'status', 'data'))
 
+def bin_mode(com):
+	"""Switch the controller to the binary mode, the text command replies and events pending are discarded"""
+	com.write(RESET_TOKEN + BIN_MODE)
+	time.sleep(.1)
+	com.reset_input_buffer()
+
+def crc16(data, crc=0xffff):
+	"""CRC16-CCITT"""
+	for b in data:
+		crc ^= b << 8
+		for _ in range(8):
+			crc = ((crc << 1) ^ 0x1021 if crc & 0x8000 else crc << 1) & 0xffff
+	return crc
+
 def cmd_request(cmd, seq, sn, data, need_resp):
 	"""Create request command"""
+	if isinstance(data, str):
+		data = data.encode('latin-1')
 	return Cmd(cmd, need_resp, seq, sn, 0, 0, data)	
 
 def cmd_serialize(cmd):
-	"""Convert command to the packet string"""
+	"""Convert command to the packet bytes"""
 	command = cmd.cmd
 	if cmd.resp:
 		command |= CMD_RESP
 	s_err = 0 if not cmd.seq else SEQ_MODE
 	h = struct.pack('BBBB', command, cmd.sn, s_err, 0)
 	assert len(cmd.data) <= CMD_BUF_SZ
-	return h + cmd.data + '\0' * (CMD_BUF_SZ - len(cmd.data))
+	pkt = h + cmd.data + b'\0' * (CMD_BUF_SZ - len(cmd.data))
+	return pkt + struct.pack('<H', crc16(pkt))
 
 def is_cmd_response(resp):
-	"""Check if the string is command response"""
-	return (ord(resp[0]) & CMD_RESP) != 0
+	"""Check if the bytes are command response"""
+	return (resp[0] & CMD_RESP) != 0
 
 def chk_cmd_response(resp, req):
-	"""Check if the string is the response to the particular request"""
+	"""Check if the bytes are the response to the particular request"""
 	if len(resp) != PKT_LEN:
 		return False
-	cmd, sn = ord(resp[0]), ord(resp[1])
+	cmd, sn = resp[0], resp[1]
 	if (cmd & CMD_RESP) == 0:
 		return False
 	if (cmd & CMD_MASK) != req.cmd:
@@ -55,11 +81,12 @@ def chk_cmd_response(resp, req):
 	return True
 
 def cmd_deserialize(resp):
-	"""Create command response tuple from response string"""
+	"""Create command response tuple from response bytes"""
 	assert len(resp) == PKT_LEN
-	command, sn, s_err, status = struct.unpack('BBBB', resp[:4])
+	command, sn, s_err, status = struct.unpack('BBBB', resp[:HDR_LEN])
 	assert (command & CMD_RESP) != 0
-	return Cmd(command & CMD_MASK, True, (s_err & SEQ_MODE) != 0, sn, s_err & ERR_MASK, status, resp[4:])
+	assert struct.unpack('<H', resp[-CRC_LEN:])[0] == crc16(resp[:-CRC_LEN])
+	return Cmd(command & CMD_MASK, True, (s_err & SEQ_MODE) != 0, sn, s_err & ERR_MASK, status, resp[HDR_LEN:-CRC_LEN])
 
 # The controller info data tuple
 Info = namedtuple('Info', ('vmaj', 'vmin', 'last_sn', 'build'))
@@ -67,5 +94,33 @@ Info = namedtuple('Info', ('vmaj', 'vmin', 'last_sn', 'build'))
 def parse_info(data):
 	assert len(data) == CMD_BUF_SZ
 	vmaj, vmin, last_sn = struct.unpack('BBB', data[:3])
-	return Info(vmaj, vmin, last_sn, data[36:56])
+	return Info(vmaj, vmin, last_sn, data[36:56].decode())
+
+#
+# The commands served by the controller SCPI handlers
+#
+
+def scpi_request(sn, text, need_resp=True):
+	"""Create the request executing SCPI command"""
+	if isinstance(text, str):
+		text = text.encode()
+	return cmd_request(SCPI, False, sn, bytes((len(text),)) + text, need_resp)
+
+def scpi_reply(r):
+	"""Return the SCPI reply text given the response tuple"""
+	return r.data[1:1+r.data[0]].decode()
+
+def resolve_request(sn, path):
+	"""Create the request returning handle of the value node given its path"""
+	if isinstance(path, str):
+		path = path.encode()
+	return cmd_request(RESOLVE, False, sn, bytes((len(path),)) + path, True)
+
+def get_request(sn, handle):
+	return cmd_request(GET, False, sn, bytes((handle,)), True)
+
+def set_request(sn, handle, value, need_resp=False, seq=False):
+	return cmd_request(SET, seq, sn, struct.pack('<BI', handle, value), need_resp)
 
+def parse_value(data):
+	return struct.unpack('<I', data[:4])[0]